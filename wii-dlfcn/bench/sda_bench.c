@@ -0,0 +1,26 @@
+//Small data microbenchmark module, loaded by bench_sda in tester_main.c, which counts the instructions of sda_step
+//Built twice, with small data reached through r13 and without, where each access takes a lis pair:
+//  powerpc-eabi-gcc -O2 -mcpu=750 -meabi -mhard-float -G 8 -c sda_bench.c -o sda_on.o
+//  powerpc-eabi-gcc -O2 -mcpu=750 -meabi -mhard-float -G 0 -c sda_bench.c -o sda_off.o
+
+int bench_a, bench_b, bench_c, bench_d;
+
+//Kept out of line so every call reaches the globals again instead of holding them in registers
+//Exported, the tester counts the instructions each build relocated it to
+__attribute__((noinline)) void sda_step(int i)
+{
+	bench_a += i;
+	bench_b ^= bench_a;
+	bench_c += bench_b >> 3;
+	bench_d -= bench_c;
+}
+
+int sda_bench(int passes)
+{
+	bench_a = bench_b = bench_c = bench_d = 0;
+
+	for (int i = 0; i < passes; ++i)
+		sda_step(i);
+
+	return bench_a ^ bench_b ^ bench_c ^ bench_d;
+}
@@ -1,17 +1,292 @@
 #ifndef WII_DLFCN_H_
 #define WII_DLFCN_H_
 
+#include <stddef.h>
+
+#include "dlfcn_io.h"
+
 #define RTLD_LAZY 0
 #define RTLD_NOW 1
 
+/// @brief One symbol to bind with dlbind, tables end with an entry with a NULL name
+typedef struct {
+	const char *name;
+	/// @brief Receives the symbol's address, NULL if not found
+	void **slot;
+} dlbind_entry_t;
+
+/// @brief Builds a dlbind_entry_t filling field of the struct at target with symbol name
+#define DLBIND_ENTRY(name, target, field) { (name), (void**)&(target)->field }
+
+/// @brief Load statistics of a module
+typedef struct {
+	/// @brief Bytes read from the file, including headers and tables
+	size_t bytes_read;
+	/// @brief File bytes of sections that were never read (debug info, comments, skipped optional sections)
+	size_t bytes_skipped;
+	/// @brief Memory held by the module's sections and stubs
+	size_t bytes_resident;
+	/// @brief Bytes of mergeable strings and constants already loaded by other modules, not held twice
+	size_t bytes_shared;
+	/// @brief Memory of sections no root reaches, left out of the image
+	size_t bytes_collected;
+	/// @brief Read calls issued on the file
+	size_t reads;
+	/// @brief Seeks issued on the file, reads continuing where the last one ended need none
+	size_t seeks;
+	/// @brief 32 byte cache lines spanned by the sections of hot functions (dllayoutprofile), 0 without any
+	size_t hot_lines;
+} dlstats_t;
+
+/// @brief State of the memory pool module images are allocated from
+typedef struct {
+	/// @brief Bytes managed by the pool
+	size_t size;
+	/// @brief Bytes held by loaded modules, block headers included
+	size_t used;
+	/// @brief Bytes available in free blocks
+	size_t free;
+	/// @brief Largest single allocation the pool can still satisfy
+	size_t largest_free;
+	/// @brief Number of free blocks
+	size_t free_blocks;
+	/// @brief Share of free memory outside the largest free block, in thousandths
+	unsigned fragmentation;
+	/// @brief Module images that did not fit and were allocated from the heap instead
+	size_t heap_fallbacks;
+	/// @brief Bytes of strings and constants held once for all modules (SHF_MERGE sections)
+	size_t merge_pooled;
+	/// @brief Bytes the constant pool currently saves over one copy per module
+	size_t merge_saved;
+} dlpoolstats_t;
+
+/// @brief State of the module cache, see dlcachebudget
+typedef struct {
+	/// @brief Bytes cached modules may hold, 0 while the cache is disabled
+	size_t budget;
+	/// @brief Bytes held by resident cached modules
+	size_t used;
+	/// @brief Cached modules, resident or evicted
+	size_t modules;
+	/// @brief Cached modules currently resident
+	size_t resident;
+	/// @brief Uses of a cached module that found it resident
+	size_t hits;
+	/// @brief Loads of a cached module, first ones and reloads after an eviction
+	size_t misses;
+	/// @brief Modules evicted to make room
+	size_t evictions;
+} dlcachestats_t;
+
+/// @brief Capacities of the real-time load mode, see dlinit_rt
+typedef struct {
+	/// @brief Modules loaded at once, at most 64 (DL_MAX_MODULES)
+	int modules;
+	/// @brief Per module, entries of the section table
+	size_t sections;
+	/// @brief Per module, entries of the symbol table
+	size_t symbols;
+	/// @brief Per module, relocation entries of every section together
+	size_t relocations;
+	/// @brief Per module, bytes of the symbol and section name string tables together
+	size_t strings;
+	/// @brief Per module, bytes of the loaded sections, each counted with its alignment (at least 32), and the largest alignment once more
+	size_t image;
+} dlrtlimits_t;
+
+/// @brief Archive of modules read through one open file, see dlpackopen
+typedef struct dl_pack dl_pack_t;
+
+/// @brief State of a module loaded a step at a time, see dlopen_begin
+typedef struct dl_load dl_load_t;
+
+/// @brief Results of dlopen_step
+#define DL_STEP_DONE 0
+#define DL_STEP_MORE 1
+#define DL_STEP_ERROR 2
+
+/// @brief Called by dlcompact for every module it moved
+/// @param delta Distance the module's sections and symbols moved by, in bytes
+typedef void (*dl_moved_cb_t)(void *handle, ptrdiff_t delta, void *user);
+
+/// @brief Decides whether an optional section (.eh_frame, .gcc_except_table...) is loaded
+/// @return Non-zero to load the section
+typedef int (*dl_section_policy_t)(const char *name, size_t size);
+
 /// @brief Initializes dlfcn by loading the executable's own symbol table
 /// @param own_path The path to the running executable
-/// @return 0 on error, 1 on success
+/// @return 0 on success, 1 on error
 int dlinit(char *own_path);
 
+/// @brief Initializes dlfcn from the host symbol table linked in at build time (STATIC_SYMTAB=1)
+/// @note Performs no I/O and no allocation of symbol data
+/// @return 0 on success, 1 on error
+int dlinit_static(void);
+
+/// @brief Bytes of memory dlinit_rt needs for limits
+size_t dlrtsize(const dlrtlimits_t *limits);
+/// @brief Switches to the real-time load mode, where loading a module never touches the heap
+/// @details mem is split into one fixed region per module, holding its tables, records and image.
+/// dlopen_io rejects a module exceeding any limit from its headers alone, before reading its tables,
+/// with dlerror naming the limit. Loading then cannot run out of memory.
+/// Worst case, dlopen_io takes time linear in sections, symbols and relocations, plus sorting
+/// at most sections + 2 file reads, plus reading the tables and image. Host symbols are found in
+/// constant time with dlinit_static, through a hash table kept at most half full with dlinit.
+/// Real-time modules keep their own copy of mergeable constants and section groups, are not
+/// counted by dlcountcalls and are never moved by dlcompact. dlopen, dlopen_roots, dlopen_pack,
+/// dlopen_begin, dlopen_many and dlcachebudget fail, they open files or keep state on the heap.
+/// @note Call after dlinit or dlinit_static, before loading any module
+/// @param mem At least dlrtsize(limits) bytes, 8 byte aligned, owned by the loader from here on
+/// @return 0 on success, 1 on error
+int dlinit_rt(void *mem, size_t size, const dlrtlimits_t *limits);
+
+/// @brief Loads a module, resolving its undefined symbols against the host and the loaded modules
+/// @param mode RTLD_LAZY or RTLD_NOW, both bind every symbol before dlopen returns, as RTLD_NOW does
+/// @return The module handle, NULL on error (see dlerror)
 void *dlopen(const char *file, int mode);
+/// @brief Same as dlopen, reading the module through an I/O backend
+/// @details Mapped backends are parsed in place, without copying headers or tables
+/// In real-time mode (dlinit_rt), the only allocations are those the backend itself makes.
+/// @param io Opened backend, owned by the loader from here on, even on failure
+/// @param mode Same as dlopen
+void *dlopen_io(dl_io_t *io, int mode);
+/// @brief Same as dlopen, loading only the sections reachable from the given symbols
+/// @details Sections are followed through their relocations, starting from the ones defining
+/// the roots. dlopen and dlopen_io use every global of the module as roots. Best with modules
+/// built with -ffunction-sections -fdata-sections, symbols outside the reached sections are
+/// not found by dlsym.
+/// @param roots Names of the symbols to keep, terminated by NULL, or NULL for every global
+void *dlopen_roots(const char *file, int mode, const char **roots);
+
+/// @brief Opens a module pack built by tools/dlpack, reading its index once
+/// @details Modules are then opened by name without any directory lookup, each read seeking
+/// straight to the module inside the pack
+/// @return The pack, NULL on error
+dl_pack_t *dlpackopen(const char *file);
+/// @brief Releases the pack, its file stays open until the modules loaded from it are closed
+/// @return 0 on success, 1 on error
+int dlpackclose(dl_pack_t *pack);
+/// @brief Same as dlopen, for the module stored in the pack under name
+/// @details The first open of each module reads it once more to check the fingerprint dlpack
+/// stored, a module changed since it was packed is refused
+/// @note Packed modules never go to the cache
+void *dlopen_pack(dl_pack_t *pack, const char *name, int mode);
+
+/// @brief Starts loading a module a step at a time, for callers that cannot block for a whole dlopen
+/// @details Only opens the file, the work is done by dlopen_step. Same as dlopen otherwise,
+/// except the module never goes to the cache. dlcompact fails until dlopen_finish is called.
+/// @return Load state for dlopen_step and dlopen_finish, NULL on error
+dl_load_t *dlopen_begin(const char *file, int mode);
+/// @brief Advances the load through headers, tables, sections, symbols and relocations until budget_us is spent
+/// @details Tables and sections are read DL_STEP_BYTES, symbols gone over DL_STEP_SYMBOLS and relocations
+/// read or applied DL_STEP_RELOCATIONS at a time, one mergeable section is split at a time, and the other
+/// chunks only go over the section headers. A step overruns its budget by at most one such chunk, except
+/// that with dlcountcalls the module's functions are sorted in one chunk, and the first far small data
+/// access counts the module's small data relocations in one. A budget of 0 runs a single chunk.
+/// @return DL_STEP_MORE while work remains, DL_STEP_DONE once loaded, DL_STEP_ERROR on failure (see dlerror)
+int dlopen_step(dl_load_t *load, unsigned budget_us);
+/// @brief Ends a load, freeing its state, cancels the load if it is not done
+/// @return The module handle if it was loaded, NULL otherwise
+void *dlopen_finish(dl_load_t *load);
+
+/// @brief Loads a set of modules as one operation
+/// @details Modules in the batch may resolve symbols against each other, and host symbol
+/// lookups are shared across the batch. Either every module is loaded or none is.
+/// @param files Paths of the modules to load
+/// @param count Number of modules
+/// @param mode Same as dlopen
+/// @param handles_out Receives one handle per file, in order, on success
+/// @return 0 on success, 1 on error
+int dlopen_many(const char **files, int count, int mode, void **handles_out);
+/// @brief Checks a module could be loaded, without allocating or reading its sections
+/// @details Reads only the header, section table, symbol table and the relocations of the sections
+/// a load would keep, and checks every undefined symbol they use against the host
+/// @return 0 if the module can be loaded, 1 otherwise (see dlerror)
+int dlcheck(const char *file);
+
 int dlclose(void *handle);
 char *dlerror(void);
+
+/// @brief Sets the policy for optional sections, NULL (default) skips all of them
+/// @note Only sections with SHF_ALLOC are ever loaded
+void dlsectionpolicy(dl_section_policy_t policy);
+
+/// @brief Lays out later modules for instruction cache locality, from a profile of hot functions
+/// @details The profile lists one function name per line, anything after the name is ignored,
+/// so dlprofilewrite output can be used as is. Sections defining a listed function are placed
+/// first, together and cache line aligned, other code goes after the data. Best with modules
+/// built with -ffunction-sections. See dlstats hot_lines for the span of the hot code.
+/// @param file Profile to use, NULL to go back to the section order of the file
+/// @return 0 on success, 1 on error
+int dllayoutprofile(const char *file);
+/// @brief Counts calls to every function of later modules, for building a profile
+/// @details Calls between functions of the module and calls through dlsym pointers go through
+/// a counting stub, adding a few cycles each. Counted modules are never moved by dlcompact.
+void dlcountcalls(int enable);
+/// @brief Keeps the relocation records of later modules, so dlcompact can move them
+/// @details By default relocations are read from the file a chunk at a time as they are applied
+/// and dropped, so loading takes no memory per relocation. Retained records take about 20 bytes each.
+void dlretainrelocs(int enable);
+/// @brief Writes the functions of a counted module that were called, most called first, one "name count" per line
+/// @return 0 on success, 1 on error
+int dlprofilewrite(void *handle, const char *file);
+
+/// @brief Gives the module pool its memory, instead of DL_POOL_SIZE bytes taken from the heap on first load
+/// @note Call early (e.g. right after dlinit) so the pool is not carved out of an already fragmented heap
+/// @return 0 on success, 1 on error (modules loaded or region too small)
+int dlpoolinit(void *mem, size_t size);
+/// @brief Retrieves the state of the module pool
+void dlpoolstats(dlpoolstats_t *stats);
+
+/// @brief Slides loaded modules together in the pool, closing the holes unloads left
+/// @details Relocations of modules loaded with dlretainrelocs are re-applied against the new addresses,
+/// registered pointers are updated, and dlsym returns the new addresses from then on.
+/// Modules loaded without dlretainrelocs, that needed small data stubs, or whose image is on the heap, stay in place,
+/// and so do modules whose COMDAT groups one loaded without dlretainrelocs uses.
+/// @warning No thread may run module code or hold unregistered pointers into modules meanwhile
+/// @param moved Called for every moved module, may be NULL
+/// @return 0 on success, 1 on error
+int dlcompact(dl_moved_cb_t moved, void *user);
+/// @brief Registers a host-side pointer into module memory, for dlcompact to keep up to date
+/// @return 0 on success, 1 on error
+int dlregisterptr(void **slot);
+/// @return 0 on success, 1 if slot was not registered
+int dlunregisterptr(void **slot);
+
+/// @brief Enables the module cache, modules opened by dlopen then share a memory budget
+/// @details Opening a module that does not fit evicts the least recently used ones. Their
+/// handles stay valid, and functions found through dlsym are stubs that reload the module on
+/// their next call. Opening a cached path again returns the same module. Modules that are
+/// pinned, running on the calling thread, sharing COMDAT groups, or whose data addresses were
+/// looked up are never evicted, which may keep the cache over budget.
+/// dlopen_io, dlopen_roots and dlopen_many never cache.
+/// @warning Other threads running code of a cached module must pin it (dlpin)
+/// @param bytes Budget in bytes, 0 disables caching for later opens. Lowering it evicts right away
+/// @return 0 on success, 1 on error
+int dlcachebudget(size_t bytes);
+/// @brief Keeps a cached module resident until the matching dlunpin, reloading it if needed
+/// @note No effect on modules outside the cache
+/// @return 0 on success, 1 on error
+int dlpin(void *handle);
+/// @return 0 on success, 1 on error (invalid handle or module not pinned)
+int dlunpin(void *handle);
+/// @brief Retrieves the state of the module cache
+void dlcachestats(dlcachestats_t *stats);
+
+/// @brief Retrieves the load statistics of a module
+/// @return 0 on success, 1 on error
+int dlstats(void *handle, dlstats_t *stats);
 void *dlsym(void *handle, const char *name);
+/// @brief Looks up several symbols of a module at once
+/// @details The handle is validated once, and every name is looked up even after a miss
+/// @param names Names of the symbols
+/// @param count Number of names
+/// @param out Receives one address per name, NULL for the missing ones
+/// @return 0 if all symbols were found, 1 otherwise (dlerror lists the missing ones)
+int dlsym_many(void *handle, const char **names, int count, void **out);
+/// @brief Fills a table of function or data pointers from a module in one pass
+/// @param table Entries to bind, terminated by an entry with a NULL name
+/// @return 0 if all symbols were found, 1 otherwise (dlerror lists the missing ones)
+int dlbind(void *handle, const dlbind_entry_t *table);
 
 #endif
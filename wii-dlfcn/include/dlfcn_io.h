@@ -0,0 +1,36 @@
+#ifndef WII_DLFCN_IO_H_
+#define WII_DLFCN_IO_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief Operations of an I/O backend modules can be loaded through
+typedef struct {
+	/// @brief Reads size bytes at offset into buff
+	/// @return Non-zero on success
+	int (*read_at)(void *ctx, uint32_t offset, void *buff, size_t size);
+	/// @brief Returns the size of the file in bytes, negative on error
+	long (*size)(void *ctx);
+	/// @brief Optional (may be NULL), returns the whole file mapped in memory or NULL
+	/// @note Mapped bytes must stay valid until close and be writable and private to the loader
+	/// (MAP_PRIVATE for a file), tables are parsed in place and byte swapped there on little-endian hosts
+	void *(*map)(void *ctx);
+	/// @brief Releases the backend and its context
+	void (*close)(void *ctx);
+} dl_io_ops_t;
+
+/// @brief An open I/O backend
+typedef struct {
+	const dl_io_ops_t *ops;
+	void *ctx;
+} dl_io_t;
+
+/// @brief Opens a file through stdio (FAT on SD/USB on the Wii)
+/// @return 0 on success, 1 on error
+int dl_io_open_stdio(const char *path, dl_io_t *io);
+
+/// @brief Opens a file through POSIX mmap, only available on host builds
+/// @return 0 on success, 1 on error
+int dl_io_open_mmap(const char *path, dl_io_t *io);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef WII_DLFCN_STATIC_H_
+#define WII_DLFCN_STATIC_H_
+
+#include <stdint.h>
+
+/// @brief One exported host symbol
+typedef struct {
+	const char *name;
+	uint32_t address;
+} dl_static_sym_t;
+
+/// @brief Host symbol table generated at build time (see STATIC_SYMTAB in the Makefile)
+/// @note Symbols are sorted by name, lookups go through a minimal perfect hash:
+/// d = disp[sym_hash(name, 0) % count], slot = d < 0 ? -d - 1 : sym_hash(name, d) % count,
+/// symbol = syms[order[slot]]
+typedef struct {
+	uint32_t count;
+	const int32_t *disp;
+	const uint32_t *order;
+	const dl_static_sym_t *syms;
+} dl_static_symtab_t;
+
+/// @brief Defined by the generated table, when linked in
+extern const dl_static_symtab_t dl_static_symtab __attribute__((weak));
+
+#endif
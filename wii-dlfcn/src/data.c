@@ -3,122 +3,190 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include <sus/ivector.h>
-#include <sus/hashtable.h>
-#include <sus/hashes.h>
-
 #include "elf.h"
+#include "elfswap.h"
+#include "memops.h"
+#include "pool.h"
+#include "sda.h"
 
-elf_rel_t *elf_rel_create(const char *path, char **error)
+int elf_file_read(elf_file_t *elf, Elf32_Off offset, void *buff, size_t size)
 {
-	elf_rel_t *obj = malloc(sizeof(elf_rel_t));
-	if (!obj)
+	if (offset > elf->size || size > elf->size - offset)
+		return 0;
+
+	if (elf->map)
 	{
-		*error = "Failed to allocate space for ELF object.";
-		return NULL;
+		dl_copy(buff, elf->map + offset, size);
+	}
+	else
+	{
+		if (elf->pos != offset) ++elf->seeks;
+		++elf->reads;
+		if (!elf->io.ops->read_at(elf->io.ctx, offset, buff, size))
+			return 0;
 	}
-	memset(obj, 0, sizeof(elf_rel_t));
 
-	obj->elf.file = fopen(path, "rb");
-	if (!obj->elf.file)
+	elf->pos = offset + size;
+	elf->bytes_read += size;
+	return 1;
+}
+
+void *elf_file_fetch(elf_file_t *elf, Elf32_Off offset, size_t size)
+{
+	if (offset > elf->size || size > elf->size - offset)
+		return NULL;
+
+	if (elf->map)
+		return elf->map + offset;
+
+	void *buff = region_alloc(elf->region, size);
+	if (!buff) return NULL;
+
+	if (!elf_file_read(elf, offset, buff, size))
 	{
-		*error = "Could not open ELF file.";
-		free(obj);
+		region_free(elf->region, buff);
 		return NULL;
 	}
 
-	fseek(obj->elf.file, 0, SEEK_END);
-	long len = ftell(obj->elf.file);
+	return buff;
+}
+
+void elf_file_release(elf_file_t *elf, void *buff)
+{
+	const unsigned char *ptr = buff;
+	if (elf->map && ptr >= elf->map && ptr < elf->map + elf->size)
+		return;
+
+	region_free(elf->region, buff);
+}
+
+static int elf_file_open(elf_file_t *elf, dl_io_t *io, char **error)
+{
+	elf->io = *io;
+	elf->map = io->ops->map ? io->ops->map(io->ctx) : NULL;
+
+	long len = io->ops->size(io->ctx);
 	if (len < (long)sizeof(Elf32_Ehdr))
 	{
 		*error = "File too small to be an ELF.";
-		fclose(obj->elf.file); free(obj);
-		return NULL;
+		return 0;
 	}
+	elf->size = len;
+	elf->pos = len;
 
-	fseek(obj->elf.file, 0, SEEK_SET);
-	if (1 != fread(&obj->elf.header, sizeof(Elf32_Ehdr), 1, obj->elf.file))
+	if (!elf_file_read(elf, 0, &elf->header, sizeof(Elf32_Ehdr)))
 	{
 		*error = "Failed to read ELF header.";
-		fclose(obj->elf.file); free(obj);
-		return NULL;
+		return 0;
 	}
 
-	obj->relocations = ivector_create(sizeof(rel_symbol_t));
-	obj->symbols = ivector_create(sizeof(def_symbol_t));
-	if (!obj->relocations || !obj->symbols)
+	elf_swap_ehdr(&elf->header);
+	return 1;
+}
+
+static void elf_file_close(elf_file_t *elf)
+{
+	if (elf->sects) elf_file_release(elf, elf->sects);
+	if (elf->sh_strings) elf_file_release(elf, elf->sh_strings);
+	if (elf->io.ops) elf->io.ops->close(elf->io.ctx);
+}
+
+elf_rel_t *elf_rel_create(dl_io_t *io, region_t *region, char **error)
+{
+	elf_rel_t *obj = region_calloc(region, 1, sizeof(elf_rel_t));
+	if (!obj)
 	{
-		*error = "Failed to allocate relocation or symbol vectors.";
-		ivector_destroy(obj->relocations);
-		ivector_destroy(obj->symbols);
-		fclose(obj->elf.file); free(obj);
+		*error = "Failed to allocate space for ELF object.";
+		io->ops->close(io->ctx);
+		region_release(region);
 		return NULL;
 	}
+	obj->elf.region = region;
 
-	obj->loaded_sections = hashtable_create(hash_ptr, compare_ptr);
-	if (!obj->loaded_sections)
+	if (!elf_file_open(&obj->elf, io, error))
 	{
-		*error = "Failed to allocate section hashtable.";
-		ivector_destroy(obj->relocations);
-		ivector_destroy(obj->symbols);
-		fclose(obj->elf.file); free(obj);
+		elf_file_close(&obj->elf); region_free(region, obj);
+		region_release(region);
 		return NULL;
 	}
 
 	return obj;
 }
-void elf_rel_destroy(elf_rel_t *obj)
-{
-	if (obj->elf.file) fclose(obj->elf.file);
-	if (obj->elf.sects) free(obj->elf.sects);
-	if (obj->elf.sh_strings) free(obj->elf.sh_strings);
-	if (obj->relocations) ivector_destroy(obj->relocations);
-	if (obj->symbols) ivector_destroy(obj->symbols);
-	if (obj->loaded_sections) hashtable_destroy(obj->loaded_sections);
-	free(obj);
-}
 
-elf_exec_t *elf_exec_create(const char *path, char **error)
+int elf_rel_alloc_tables(elf_rel_t *obj, char **error)
 {
-	elf_exec_t *exec = malloc(sizeof(elf_exec_t));
-	if (!exec)
+	region_t *region = obj->elf.region;
+	obj->sect_addrs = region_calloc(region, obj->elf.header.e_shnum, sizeof(void*));
+	obj->wanted = region_calloc(region, obj->elf.header.e_shnum, 1);
+	if (!obj->sect_addrs || !obj->wanted)
 	{
-		*error = "Failed to alloc space for ELF executable.";
-		return NULL;
+		*error = "Failed to allocate section tables.";
+		return 0;
 	}
-	memset(exec, 0, sizeof(elf_exec_t));
 
-	exec->elf.file = fopen(path, "rb");
-	if (!exec->elf.file)
+	return 1;
+}
+
+static void free_sections(elf_rel_t *obj)
+{
+	for (int i = 0; i < obj->elf.header.e_shnum; ++i)
 	{
-		*error = "Could not open ELF file.";
-		free(exec);
-		return NULL;
+		void *sect_buff = obj->sect_addrs[i];
+		if (!sect_buff) continue;
+
+		if (sda_owns(sect_buff))
+			sda_free(sect_buff, obj->elf.sects[i].sh_size);
 	}
 
-	fseek(exec->elf.file, 0, SEEK_END);
-	long len = ftell(exec->elf.file);
-	if (len < (long)sizeof(Elf32_Ehdr))
+	//Real-time images are part of the module's region
+	if (!obj->elf.region) pool_free(obj->image);
+	region_free(obj->elf.region, obj->sect_addrs);
+}
+
+void elf_rel_destroy(elf_rel_t *obj)
+{
+	region_t *region = obj->elf.region;
+
+	if (obj->sect_addrs) free_sections(obj);
+	region_free(region, obj->sda_tramps);
+	free(obj->counted);
+	if (obj->raw_syms) elf_file_release(&obj->elf, obj->raw_syms);
+	if (obj->raw_strs) elf_file_release(&obj->elf, obj->raw_strs);
+	if (obj->merged)
 	{
-		*error = "File too small to be an ELF.";
-		fclose(exec->elf.file); free(exec);
-		return NULL;
+		for (int i = 0; i < obj->elf.header.e_shnum; ++i)
+			merge_release(&obj->merged[i]);
+		free(obj->merged);
 	}
+	for (size_t i = 0; i < obj->group_name_count; ++i)
+		free(obj->group_names[i]);
+	free(obj->group_names);
+	free(obj->group_owners);
+	free(obj->shared_from);
+	region_free(region, obj->wanted);
+	region_free(region, obj->referenced);
+	elf_file_close(&obj->elf);
+	reltab_free(&obj->relocations, region);
+	symindex_free(&obj->index, region);
+	symtab_free(&obj->symbols, region);
+	region_free(region, obj);
+	region_release(region);
+}
 
-	fseek(exec->elf.file, 0, SEEK_SET);
-	if (1 != fread(&exec->elf.header, sizeof(Elf32_Ehdr), 1, exec->elf.file))
+elf_exec_t *elf_exec_create(dl_io_t *io, char **error)
+{
+	elf_exec_t *exec = malloc(sizeof(elf_exec_t));
+	if (!exec)
 	{
-		*error = "Failed to read ELF header.";
-		fclose(exec->elf.file); free(exec);
+		*error = "Failed to alloc space for ELF executable.";
+		io->ops->close(io->ctx);
 		return NULL;
 	}
+	memset(exec, 0, sizeof(elf_exec_t));
 
-	exec->symbols = ivector_create(sizeof(def_symbol_t));
-	if (!exec->symbols)
+	if (!elf_file_open(&exec->elf, io, error))
 	{
-		*error = "Failed to allocate symbol vector.";
-		ivector_destroy(exec->symbols);
-		fclose(exec->elf.file); free(exec);
+		elf_file_close(&exec->elf); free(exec);
 		return NULL;
 	}
 
@@ -126,9 +194,9 @@ elf_exec_t *elf_exec_create(const char *path, char **error)
 }
 void elf_exec_destroy(elf_exec_t *exec)
 {
-	if (exec->elf.file) fclose(exec->elf.file);
-	if (exec->elf.sects) free(exec->elf.sects);
-	if (exec->elf.sh_strings) free(exec->elf.sh_strings);
-	if (exec->symbols) ivector_destroy(exec->symbols);
+	if (exec->strs) elf_file_release(&exec->elf, exec->strs);
+	elf_file_close(&exec->elf);
+	symtab_free(&exec->symbols, NULL);
+	symindex_free(&exec->index, NULL);
 	free(exec);
 }
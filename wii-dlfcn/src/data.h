@@ -1,57 +1,144 @@
 #ifndef DATA_H_
 #define DATA_H_
 
-#include <stdio.h>
-
-#include <sus/ivector.h>
-#include <sus/hashtable.h>
+#include <stddef.h>
+#include <stdint.h>
 
+#include "dlfcn.h"
+#include "dlfcn_io.h"
 #include "elf.h"
+#include "mergepool.h"
+#include "region.h"
+#include "symindex.h"
+#include "symtab.h"
+
+//How a section is loaded, values of elf_rel_t::wanted
+#define SECT_SKIPPED 0
+#define SECT_LOADED 1
+//Split into pieces shared through the constant pool
+#define SECT_MERGED 2
+//Member of a COMDAT group already resident elsewhere, not loaded
+#define SECT_SHARED 3
+//Reached from no root, not loaded
+#define SECT_COLLECTED 4
 
 typedef struct {
-	FILE *file;
+	dl_io_t io;
+	//Whole file, when the backend can map it
+	unsigned char *map;
+	size_t size;
 	Elf32_Ehdr header;
 	Elf32_Shdr *sects;
 	char *sh_strings;
+	//Current file position, reads there need no seek
+	Elf32_Off pos;
+	//I/O done on the file so far
+	size_t bytes_read;
+	size_t reads;
+	size_t seeks;
+	//Where tables read from the file are allocated, NULL for the heap
+	region_t *region;
 } elf_file_t;
 
-typedef struct {
+//One relocation, unpacked while it is applied, retained ones are stored in a reltab_t
+typedef struct rel_symbol {
 	char *name;
+	//Name as stored in the tables, see symtab_string
+	uint32_t name_ref;
 	Elf32_Off offset;
 	Elf32_Sword addend;
 	Elf32_Half section;
 	unsigned char rel_type;
+	//Address the relocation was bound to, so it can be re-applied when modules move
+	void *resolved;
 } rel_symbol_t;
 
+//Function of a module whose calls are counted, see dlcountcalls
 typedef struct {
-	char *name;
-	Elf32_Addr value;
-	unsigned char bind;
-	unsigned char type;
-	int section;
 	void *address;
-} def_symbol_t;
+	const char *name;
+	uint32_t *stub;
+} counted_func_t;
 
-typedef struct {
+typedef struct elf_rel {
 	elf_file_t elf;
-	//ivector_t<rel_symbol_t>
-	ivector_t *relocations;
-	//ivector_t<def_symbol_t>
-	ivector_t *symbols;
-	//hashtable_t<int, void*> owns values
-	hashtable_t *loaded_sections;
+	//Handle given to callers, slot and generation (see module_from_handle)
+	void *handle;
+	//Relocations of the loaded sections, empty unless retained (see dlretainrelocs)
+	//Otherwise they are streamed from the file when applied and never held whole
+	reltab_t relocations;
+	//Symbols, names are in raw_strs or the section name strings
+	symtab_t symbols;
+	//Defined symbols by name, globals shadowing locals
+	symindex_t index;
+	//Raw symbol table and its strings, as read from the file
+	//The table goes once parsed, the strings stay for as long as the records naming into them
+	Elf32_Sym *raw_syms;
+	size_t raw_sym_count;
+	char *raw_strs;
+	//char[raw_sym_count], set for symbols relocations of reached sections use, NULL until collect_sections
+	char *referenced;
+	//char[e_shnum], how each section is loaded (SECT_*)
+	char *wanted;
+	//merge_sect_t[e_shnum], pieces of SECT_MERGED sections, NULL until loaded
+	merge_sect_t *merged;
+	//Bytes of merged pieces found already pooled
+	size_t merge_shared;
+	//Signatures of the COMDAT groups this module loaded its own copy of
+	char **group_names;
+	size_t group_name_count;
+	//Owners of the groups bound to instead, NULL for the host
+	struct elf_rel **group_owners;
+	size_t group_owner_count;
+	//elf_rel_t*[e_shnum] owner of each SECT_SHARED section, NULL for the host
+	struct elf_rel **shared_from;
+	//Modules bound to this one's groups, it outlives dlclose until they are gone
+	int group_users;
+	int closed;
+	//Cache entry when the module may be evicted, see dlcachebudget
+	struct cache_entry *cache;
+	//void*[e_shnum] NULL if not loaded, small data sections are owned, the rest point into image
+	void **sect_addrs;
+	//Single pool allocation holding every section outside the small data arenas
+	void *image;
+	size_t image_size;
+	size_t image_align;
+	//Far small data access stubs, SDA_TRAMPOLINE_WORDS each
+	uint32_t *sda_tramps;
+	size_t sda_tramp_count;
+	size_t sda_tramp_cap;
+	//Call counting stubs, COUNTER_STUB_WORDS each, in the image after the sections
+	uint32_t *counters;
+	size_t counter_cap;
+	//Functions behind the counting stubs, by address
+	counted_func_t *counted;
+	size_t counted_count;
+	dlstats_t stats;
 } elf_rel_t;
 
 typedef struct {
 	elf_file_t elf;
-	//ivector_t<def_symbol_t>
-	ivector_t *symbols;
+	symtab_t symbols;
+	//Strings of the symbol table, symbol names are in them
+	char *strs;
+	//Exported symbols by name
+	symindex_t index;
 } elf_exec_t;
 
-elf_rel_t *elf_rel_create(const char *path, char **error);
+int elf_file_read(elf_file_t *elf, Elf32_Off offset, void *buff, size_t size);
+//Returns size bytes at offset, pointing into the mapping when there is one, NULL on error
+void *elf_file_fetch(elf_file_t *elf, Elf32_Off offset, size_t size);
+//Releases a buffer returned by elf_file_fetch or allocated by the caller
+void elf_file_release(elf_file_t *elf, void *buff);
+
+//Both take ownership of io, even on error
+//The module and everything read for it is allocated from region, NULL for the heap
+elf_rel_t *elf_rel_create(dl_io_t *io, region_t *region, char **error);
+//Allocates the per-section tables, once the header is known to be acceptable
+int elf_rel_alloc_tables(elf_rel_t *obj, char **error);
 void elf_rel_destroy(elf_rel_t *obj);
 
-elf_exec_t *elf_exec_create(const char *path, char **error);
+elf_exec_t *elf_exec_create(dl_io_t *io, char **error);
 void elf_exec_destroy(elf_exec_t *exec);
 
 #endif
@@ -1,4 +1,5 @@
 #include "dlfcn.h"
+#include "dlfcn_static.h"
 
 #include <stddef.h>
 #include <stdio.h>
@@ -7,522 +8,682 @@
 #include <string.h>
 
 #include <sus/hashes.h>
-#include <sus/ivector.h>
-#include <sus/hashset.h>
+#include <sus/hashtable.h>
 
 #include "data.h"
+#include "dlsync.h"
 #include "elf.h"
+#include "elfparse.h"
+#include "elfswap.h"
+#include "ioplan.h"
+#include "memops.h"
+#include "mergepool.h"
+#include "pack.h"
+#include "pool.h"
+#include "region.h"
 #include "relocations.h"
-
-static char *error = NULL;
+#include "sda.h"
+#include "stub.h"
+#include "symhash.h"
+#include "symindex.h"
+
+#ifdef GEKKO
+#include <ogc/cache.h>
+#include <ogc/lwp_watchdog.h>
+#else
+#include <time.h>
+#endif
+
+//Per thread, so dlerror reports the failure of the calling thread's own call
+static DL_THREAD_LOCAL char *error = NULL;
 static elf_exec_t *self = NULL;
-static hashset_t *loaded_relocatables = NULL;
+static const dl_static_symtab_t *host_table = NULL;
+static dl_section_policy_t section_policy = NULL;
+//hashtable_t<char*, char*> hot functions of the layout profile, names point into hot_names
+static hashtable_t *hot_functions = NULL;
+static char *hot_names = NULL;
+static int count_calls = 0;
+//Keep the relocation records of later modules, for dlcompact
+static int retain_relocs = 0;
+
+//Symbol resolution state shared by the modules of a dlopen_many batch
+typedef struct {
+	elf_rel_t **peers;
+	int peer_count;
+	//hashtable_t<char*, void*> host symbols already resolved
+	hashtable_t *host_memo;
+} resolve_ctx_t;
+
+//Most modules loaded at once, each takes a handle slot
+#ifndef DL_MAX_MODULES
+#define DL_MAX_MODULES 64
+#endif
+
+//Handles are a slot index and the generation of the slot, so the handle of an unloaded
+//module never matches whatever takes its slot next
+#define HANDLE_SLOT_BITS 8
+#define HANDLE_SLOT_MASK ((1u << HANDLE_SLOT_BITS) - 1)
+#define HANDLE_GENERATION_MASK (UINTPTR_MAX >> HANDLE_SLOT_BITS)
+
+_Static_assert(DL_MAX_MODULES <= (1 << HANDLE_SLOT_BITS), "DL_MAX_MODULES does not fit in a handle");
+
+typedef struct {
+	//Published for lock free readers, NULL while the slot is free
+	elf_rel_t *obj;
+	//Generation handed out next time the slot is taken
+	uintptr_t generation;
+} module_slot_t;
+
+//Dense so walking the loaded modules touches a few cache lines, every live slot is below slot_end
+static module_slot_t module_slots[DL_MAX_MODULES];
+static size_t slot_end = 0;
+
+//A COMDAT group loaded once and shared by every module carrying it
+typedef struct {
+	char *signature;
+	//Module whose copy is resident, NULL once it is unloaded
+	elf_rel_t *owner;
+} comdat_t;
+//hashtable_t<char*, comdat_t*> groups by signature
+static hashtable_t *comdat_groups = NULL;
+
+//A module opened by path while the cache is enabled, evicted and reloaded on demand
+typedef struct cache_entry {
+	char *path;
+	//The module, or a shell holding its handle while evicted
+	elf_rel_t *obj;
+	int resident;
+	//dlpin count, pinned modules are never evicted
+	int pins;
+	//dlopen count, the entry goes with the last dlclose
+	int refs;
+	//Set once an address only valid while resident escaped (data, or any symbol without stubs)
+	int data_bound;
+	//Bytes held while resident
+	size_t size;
+	size_t last_use;
+	//Function entry points handed out by dlsym, they outlive evictions
+	stub_t *stubs;
+} cache_entry_t;
+
+static cache_entry_t **cache_entries = NULL;
+static size_t cache_count = 0;
+static size_t cache_cap = 0;
+//0 while caching is disabled
+static size_t cache_budget = 0;
+static size_t cache_used = 0;
+static size_t cache_clock = 0;
+static size_t cache_hits = 0;
+static size_t cache_misses = 0;
+static size_t cache_evictions = 0;
+
+//Incremental loads between dlopen_begin and dlopen_finish, modules must not move meanwhile
+static int loads_pending = 0;
+
+//Host-side pointers into modules, kept valid by dlcompact
+static void ***registered_ptrs = NULL;
+static size_t registered_count = 0;
+static size_t registered_cap = 0;
+
+//Real-time mode (dlinit_rt), a fixed region per module, rt_modules is 0 while disabled
+static region_t rt_regions[DL_MAX_MODULES];
+static int rt_modules = 0;
+static dlrtlimits_t rt_limits;
+
+//Returns the module of handle, NULL if the handle is invalid or stale, call within a read section
+static elf_rel_t *module_from_handle(void *handle)
+{
+	uintptr_t slot = (uintptr_t)handle & HANDLE_SLOT_MASK;
+	if (slot >= DL_MAX_MODULES)
+		return NULL;
+
+	//The module cannot be freed before the read section ends, so its own handle is safe to compare
+	//Closed modules may linger while others still use their COMDAT groups
+	elf_rel_t *obj = __atomic_load_n(&module_slots[slot].obj, __ATOMIC_ACQUIRE);
+	return obj && obj->handle == handle && !obj->closed ? obj : NULL;
+}
 
-static int elf_valid_compat(Elf32_Ehdr *elf)
+//Gives each module a slot and makes it visible to readers, call with the writer lock held
+//Either every module gets a slot or none does
+static int publish_modules(elf_rel_t **add, int add_count)
 {
-	//Check ELF magic
-	if (elf->e_ident[EI_MAG0] != ELFMAG0 ||
-		elf->e_ident[EI_MAG1] != ELFMAG1 ||
-		elf->e_ident[EI_MAG2] != ELFMAG2 ||
-		elf->e_ident[EI_MAG3] != ELFMAG3)
+	size_t taken[DL_MAX_MODULES];
+	size_t found = 0;
+	for (size_t slot = 0; slot < DL_MAX_MODULES && found < (size_t)add_count; ++slot)
 	{
-		error = "Invalid ELF magic";
-		return 0;
+		if (!module_slots[slot].obj)
+			taken[found++] = slot;
 	}
 
-	//Require 32-bit, Big Endian, ELF version values
-	if (elf->e_ident[EI_CLASS] != ELFCLASS32 ||
-		elf->e_ident[EI_DATA] != ELFDATA2MSB || 
-		elf->e_ident[EI_VERSION] != EV_CURRENT)
+	if (found < (size_t)add_count)
 	{
-		error = "Invalid IDENT values";
+		error = "Too many modules loaded";
 		return 0;
 	}
 
-	//Require PPC
-	if (elf->e_machine != EM_PPC)
+	//Handles only reach callers once every module of the batch is published
+	for (int i = 0; i < add_count; ++i)
 	{
-		error = "Invalid target machine";
-		return 0;
-	}
+		module_slot_t *slot = &module_slots[taken[i]];
+		if (!slot->generation) slot->generation = 1;
 
-	//Require current ELF version
-	if (elf->e_version != EV_CURRENT)
-	{
-		error = "Invalid ELF version";
-		return 0;
+		add[i]->handle = (void*)((slot->generation << HANDLE_SLOT_BITS) | taken[i]);
+		__atomic_store_n(&slot->obj, add[i], __ATOMIC_RELEASE);
+		if (taken[i] >= slot_end) slot_end = taken[i] + 1;
 	}
 
 	return 1;
 }
 
-static int elf_rel_valid(elf_rel_t *obj)
+//Takes the module out of its slot, it may be freed once this returns, call with the writer lock held
+static void retire_module(elf_rel_t *obj)
 {
-	if (!elf_valid_compat(&obj->elf.header))
-		return 0;
-	
-	//Require object file
-	if (obj->elf.header.e_type != ET_REL)
-	{
-		error = "Unsupported ELF type, must be ET_REL (object file)";
-		return 0;
-	}
+	module_slot_t *slot = &module_slots[(uintptr_t)obj->handle & HANDLE_SLOT_MASK];
+	__atomic_store_n(&slot->obj, NULL, __ATOMIC_RELEASE);
+	slot->generation = (slot->generation + 1) & HANDLE_GENERATION_MASK;
 
-	return 1;
+	while (slot_end && !module_slots[slot_end - 1].obj)
+		--slot_end;
+
+	//Readers may still be inside a lookup on the module
+	dl_synchronize();
 }
 
-static int elf_exec_valid(elf_exec_t *exec)
+//Places symbols first to end, once the sections are loaded
+static void compute_symbol_addresses(elf_rel_t *obj, size_t first, size_t end)
 {
-	if (!elf_valid_compat(&exec->elf.header))
-		return 0;
-	
-	//Require object file
-	if (exec->elf.header.e_type != ET_EXEC)
+	symtab_t *tab = &obj->symbols;
+
+	for (size_t i = first; i < end; ++i)
 	{
-		error = "Unsupported ELF type, must be ET_EXEC (executable file)";
-		return 0;
+		Elf32_Half section = tab->sections[i];
+
+		if (section == SHN_ABS)
+		{
+			tab->addresses[i] = (void*)(uintptr_t)tab->values[i];
+			continue;
+		}
+
+		if (section < obj->elf.header.e_shnum && obj->wanted[section] == SECT_MERGED)
+		{
+			tab->addresses[i] = merge_lookup(&obj->merged[section], tab->values[i]);
+			continue;
+		}
+
+		void *sect_buff = section < obj->elf.header.e_shnum ? obj->sect_addrs[section] : NULL;
+		if (!sect_buff)
+		{
+			tab->addresses[i] = NULL;
+			continue;
+		}
+
+		tab->addresses[i] = (char*)sect_buff + tab->values[i];
 	}
+}
 
-	return 1;
+static void *section_alloc_sda(elf_rel_t *obj, Elf32_Shdr *sect)
+{
+	size_t align = sect->sh_addralign ? sect->sh_addralign : 1;
+
+	//Small data goes next to the host's own when there is room, so r13/r2 can reach it
+	int reg = sda_section_reg(&obj->elf.sh_strings[sect->sh_name]);
+	return reg ? sda_alloc(reg, sect->sh_size, align) : NULL;
+}
+
+//Pass of image_layout the section goes in
+//Without a profile everything goes in file order, otherwise hot code, then data, then the rest of the code
+static int layout_pass(elf_rel_t *obj, int i, const char *hot)
+{
+	if (!hot) return 0;
+	if (hot[i]) return 0;
+	return obj->elf.sects[i].sh_flags & SHF_EXECINSTR ? 2 : 1;
 }
 
-static int elf_load_sects(elf_file_t *elf)
+//Lays out every wanted section not placed in small data into one image, so a module
+//costs a single pool allocation and leaves a single hole when unloaded
+//Places the sections at base, or only measures the image when base is 0
+//Sections flagged in hot (NULL for none) come first, each on its own cache line
+static size_t image_layout(elf_rel_t *obj, uintptr_t base, size_t *align, const char *hot)
 {
-	int count = elf->header.e_shnum;
-	size_t len = sizeof(Elf32_Shdr) * count;
+	size_t size = 0;
+	*align = POOL_GRANULE;
 
-	elf->sects = malloc(len);
-	if (!elf->sects)
+	for (int pass = 0; pass < (hot ? 3 : 1); ++pass)
 	{
-		error = "Failed to alloc space for sections";
-		return 0;
-	}
+		for (int i = 0; i < obj->elf.header.e_shnum; ++i)
+		{
+			Elf32_Shdr *sect = &obj->elf.sects[i];
+			if (obj->wanted[i] != SECT_LOADED || obj->sect_addrs[i] || layout_pass(obj, i, hot) != pass) continue;
 
-	fseek(elf->file, elf->header.e_shoff, SEEK_SET);
-	if (count != (int)fread(elf->sects, sizeof(Elf32_Shdr), count, elf->file))
-	{
-		error = "Failed to load sections";
-		return 0;
+			size_t sect_align = sect->sh_addralign ? sect->sh_addralign : 1;
+			if (hot && hot[i] && sect_align < MEMOPS_LINE) sect_align = MEMOPS_LINE;
+			if (sect_align > *align) *align = sect_align;
+
+			size = (size + sect_align - 1) & ~(sect_align - 1);
+			if (base) obj->sect_addrs[i] = (void*)(base + size);
+			size += sect->sh_size;
+		}
 	}
 
-	return 1;
+	return size;
 }
 
-static int elf_load_shstrings(elf_file_t *elf)
+//Flags the sections defining a function of the layout profile, NULL when there are none
+static char *mark_hot_sections(elf_rel_t *obj)
 {
-	if (elf->header.e_shstrndx == SHN_UNDEF)
-		return 1;
+	if (!hot_functions || !obj->raw_syms) return NULL;
 
-	//section header strings section
-	Elf32_Shdr *sect = &elf->sects[elf->header.e_shstrndx];
-	Elf32_Off location = sect->sh_offset;
+	//Best effort, without the flags the module is just laid out in file order
+	char *hot = region_calloc(obj->elf.region, obj->elf.header.e_shnum, 1);
+	if (!hot) return NULL;
 
-	elf->sh_strings = malloc(sect->sh_size);
-	if (!elf->sh_strings)
+	int found = 0;
+	for (size_t i = 1; i < obj->raw_sym_count; ++i)
 	{
-		error = "Failed to alloc space for sh_strings";
-		return 0;
+		Elf32_Sym *sym = &obj->raw_syms[i];
+		if (ELF32_ST_TYPE(sym->st_info) != STT_FUNC || sym->st_shndx >= obj->elf.header.e_shnum || obj->wanted[sym->st_shndx] != SECT_LOADED)
+			continue;
+
+		if (hashtable_get(hot_functions, &obj->raw_strs[sym->st_name]))
+			found = hot[sym->st_shndx] = 1;
 	}
 
-	fseek(elf->file, location, SEEK_SET);
-	if (sect->sh_size != fread(elf->sh_strings, 1, sect->sh_size, elf->file))
+	if (!found)
 	{
-		error = "Failed to load sh_strings";
-		return 0;
+		region_free(obj->elf.region, hot);
+		return NULL;
 	}
 
-	return 1;
+	return hot;
 }
 
-static int save_symbols(elf_file_t *elf, Elf32_Sym *symbols, int sym_count, char *sym_strs, ivector_t *finals, hashtable_t *loaded_sections)
+//Cache lines from the start of the first hot section to the end of the last
+static size_t hot_span_lines(elf_rel_t *obj, const char *hot)
 {
-	for (int i = 1; i < sym_count; ++i)
+	uintptr_t start = UINTPTR_MAX, end = 0;
+	for (int i = 0; i < obj->elf.header.e_shnum; ++i)
 	{
-		Elf32_Sym *symbol = &symbols[i];
-		def_symbol_t final = { 0 };
-		int type = ELF32_ST_TYPE(symbol->st_info);
+		uintptr_t addr = (uintptr_t)obj->sect_addrs[i];
+		if (!hot[i] || !addr) continue;
+
+		if (addr < start) start = addr;
+		if (addr + obj->elf.sects[i].sh_size > end) end = addr + obj->elf.sects[i].sh_size;
+	}
+
+	if (end <= start) return 0;
+	return ((end + MEMOPS_LINE - 1) / MEMOPS_LINE) - (start / MEMOPS_LINE);
+}
 
-		//Skip unneeded symbols
-		if (type == STT_NOTYPE || type == STT_FILE) continue;
+//Functions defined in loaded sections, one counting stub each
+static size_t count_functions(elf_rel_t *obj)
+{
+	size_t count = 0;
+	for (size_t i = 1; i < obj->raw_sym_count; ++i)
+	{
+		Elf32_Sym *sym = &obj->raw_syms[i];
+		if (ELF32_ST_TYPE(sym->st_info) == STT_FUNC && sym->st_shndx < obj->elf.header.e_shnum && obj->wanted[sym->st_shndx] == SECT_LOADED)
+			++count;
+	}
 
+	return count;
+}
 
-		//Find symbol name
-		char *name = type == STT_SECTION ? &elf->sh_strings[elf->sects[symbol->st_shndx].sh_name] : &sym_strs[symbol->st_name];
+static int image_alloc(elf_rel_t *obj)
+{
+	char *hot = mark_hot_sections(obj);
+	//Real-time modules are never counted, the records would come from the heap
+	size_t counters = count_calls && obj->raw_syms && !obj->elf.region ? count_functions(obj) : 0;
+
+	//Counting stubs go after the sections, in branch reach of every function
+	size_t align;
+	size_t size = image_layout(obj, 0, &align, hot);
+	size_t counters_offset = (size + 3) & ~(size_t)3;
+	if (counters) size = counters_offset + counters * COUNTER_STUB_WORDS * sizeof(uint32_t);
+	if (!size)
+	{
+		region_free(obj->elf.region, hot);
+		return 1;
+	}
 
-		//Copy data
-		final.name = strdup(name);
-		final.bind = ELF32_ST_BIND(symbol->st_info);
-		final.type = type;
-		final.section = symbol->st_shndx;
+	//The pool aligns to POOL_GRANULE, stricter alignment is made up within the block
+	//Real-time modules have their image in their own region, nothing else can take it
+	obj->image_size = size + align - POOL_GRANULE;
+	obj->image_align = align;
+	obj->image = obj->elf.region ? region_aligned(obj->elf.region, POOL_GRANULE, obj->image_size) : pool_alloc(obj->image_size);
+	if (!obj->image)
+	{
+		region_free(obj->elf.region, hot);
+		return 0;
+	}
 
-		if (type == STT_SECTION)
-		{
-			if (!loaded_sections)
-			{
-				printf("Skip section symbol '%s' for file with no section table.\n", name);
-				final.value = 0;
-				goto _save_symbols_skip_value;
-			}
-			void *sect_base = hashtable_get(loaded_sections, (void*)(int)symbol->st_shndx);
-			if (!sect_base)
-			{
-				printf("Skip symbol of section not loaded\n");
-				final.value = 0;
-				goto _save_symbols_skip_value;
-			}
-			final.value = (int)sect_base + symbol->st_value;
-		}
-		else
-			final.value = symbol->st_value;
+	uintptr_t base = ((uintptr_t)obj->image + align - 1) & ~(uintptr_t)(align - 1);
+	image_layout(obj, base, &align, hot);
 
-_save_symbols_skip_value:
-		//Save symbol
-		ivector_append(finals, &final);
+	if (counters)
+	{
+		obj->counters = (uint32_t*)(base + counters_offset);
+		obj->counter_cap = counters;
 	}
 
-	ivector_trim(finals);
+	if (hot) obj->stats.hot_lines = hot_span_lines(obj, hot);
+	region_free(obj->elf.region, hot);
 	return 1;
 }
 
-static int elf_find_defined_symbols(elf_exec_t *exec)
+static void compute_load_stats(elf_rel_t *obj)
 {
-	//Skip NULL section
-	for (int i = 1; i < exec->elf.header.e_shnum; ++i)
-	{
-		Elf32_Shdr *sym_sect = &exec->elf.sects[i];
+	dlstats_t *stats = &obj->stats;
+	stats->bytes_read = obj->elf.bytes_read;
+	stats->reads = obj->elf.reads;
+	stats->seeks = obj->elf.seeks;
+	stats->bytes_skipped = 0;
+	stats->bytes_resident = (obj->sda_tramp_cap * SDA_TRAMPOLINE_WORDS + obj->counter_cap * COUNTER_STUB_WORDS) * sizeof(uint32_t);
+	stats->bytes_shared = obj->merge_shared;
+	stats->bytes_collected = 0;
 
-		//Skip non symbol sections
-		if (sym_sect->sh_type != SHT_SYMTAB) continue;
-
-		int sym_count = sym_sect->sh_size / sizeof(Elf32_Sym);
-		Elf32_Shdr *symstr_sect = &exec->elf.sects[sym_sect->sh_link];
+	for (int i = 1; i < obj->elf.header.e_shnum; ++i)
+	{
+		Elf32_Shdr *sect = &obj->elf.sects[i];
 
-		//Sanity check entsize
-		if (sym_sect->sh_entsize != sizeof(Elf32_Sym))
+		if (obj->sect_addrs[i] || obj->wanted[i] == SECT_MERGED)
 		{
-			error = "Invalid entsize for symtab";
-			return 0;
+			stats->bytes_resident += sect->sh_size;
+			continue;
 		}
 
-		//Allocate buffers
-		Elf32_Sym *symbols = malloc(sym_sect->sh_size);
-		char *sym_strs = malloc(symstr_sect->sh_size);
-
-		if (!symbols || !sym_strs)
+		if (obj->wanted[i] == SECT_SHARED)
 		{
-			error = "Failed to alloc space for symbols or symbol strings";
-			free(symbols);
-			free(sym_strs);
-			return 0;
+			stats->bytes_shared += sect->sh_size;
+			continue;
 		}
 
-		//Read data
-		fseek(exec->elf.file, sym_sect->sh_offset, SEEK_SET);
-		if (sym_sect->sh_size != fread(symbols, 1, sym_sect->sh_size, exec->elf.file))
-		{
-			error = "Failed to read symbols";
-			free(symbols);
-			free(sym_strs);
-			return 0;
-		}
-		fseek(exec->elf.file, symstr_sect->sh_offset, SEEK_SET);
-		if (symstr_sect->sh_size != fread(sym_strs, 1, symstr_sect->sh_size, exec->elf.file))
+		if (obj->wanted[i] == SECT_COLLECTED)
 		{
-			error = "Failed to read symbol strings";
-			free(symbols);
-			free(sym_strs);
-			return 0;
+			stats->bytes_collected += sect->sh_size;
+			continue;
 		}
 
-		//Interpret data (skipping NULL symbol)
-		int success = save_symbols(&exec->elf, &symbols[1], sym_count - 1, sym_strs, exec->symbols, NULL);
-
-		//Cleanup
-		free(symbols);
-		free(sym_strs);
+		//File contents never read: unloaded sections and their relocations
+		if (sect->sh_type == SHT_NOBITS || sect->sh_type == SHT_SYMTAB || sect->sh_type == SHT_STRTAB)
+			continue;
+		if (sect->sh_type == SHT_RELA && sect->sh_info < obj->elf.header.e_shnum
+			&& (obj->sect_addrs[sect->sh_info] || obj->wanted[sect->sh_info] == SECT_COLLECTED))
+			continue;
 
-		if (!success) return 0;
+		stats->bytes_skipped += sect->sh_size;
 	}
 
-	return 1;
+	//Merged pieces other modules had already loaded are not held by this one
+	stats->bytes_resident -= obj->merge_shared;
 }
 
-static int save_relocations(elf_file_t *elf, int target_sect_idx, Elf32_Rela *relocations, int rela_count, Elf32_Sym *symbols, char *sym_strs, ivector_t *finals)
+//Allocates the wanted sections and plans reading their contents, merged sections are read into merge_src
+static int plan_section_loads(elf_rel_t *obj, io_plan_t *plan, void ***merge_src)
 {
-	for (int i = 0; i < rela_count; ++i)
+	//Small data first, what does not fit in the arenas goes to the image with the rest
+	for (int i = 0; i < obj->elf.header.e_shnum; ++i)
 	{
-		Elf32_Rela *rela = &relocations[i];
-		rel_symbol_t final = { 0 };
-		
-		//Find symbol name
-		int sym_idx = ELF32_R_SYM(rela->r_info);
-		Elf32_Sym *symbol = &symbols[sym_idx];
-		char *name = ELF32_ST_TYPE(symbol->st_info) == STT_SECTION ? &elf->sh_strings[elf->sects[symbol->st_shndx].sh_name] : &sym_strs[symbol->st_name];
-
-		//Copy data
-		final.name = strdup(name);
-		final.section = target_sect_idx;
-		final.offset = rela->r_offset;
-		final.rel_type = ELF32_R_TYPE(rela->r_info);
-		final.addend = rela->r_addend;
-
-		//Save relocation
-		ivector_append(finals, &final);
+		if (obj->wanted[i] == SECT_LOADED) obj->sect_addrs[i] = section_alloc_sda(obj, &obj->elf.sects[i]);
 	}
 
-	ivector_trim(finals);
-	return 1;
-}
-
-static int elf_find_relocations(elf_rel_t *obj)
-{
-	//Skip NULL section
-	for (int i = 1; i < obj->elf.header.e_shnum; ++i)
+	if (!image_alloc(obj))
 	{
-		Elf32_Shdr *rela_sect = &obj->elf.sects[i];
-		char *sect_name = &obj->elf.sh_strings[rela_sect->sh_name];
-
-		//Skip non relocation sections (SHT_REL not used in powerpc-eabi-none)
-		if (rela_sect->sh_type != SHT_RELA) continue;
-
-		//Skip debug related relocations
-		//REVIEW: For now, also skip .eh_frame related relocations
-		if (strstr(sect_name, "debug")) continue;
-		if (strstr(sect_name, "eh_frame")) continue;
-
-		int rela_count = rela_sect->sh_size / sizeof(Elf32_Rela);
-		Elf32_Shdr *sym_sect = &obj->elf.sects[rela_sect->sh_link];
-		Elf32_Shdr *symstr_sect = &obj->elf.sects[sym_sect->sh_link];
+		error = "Failed to allocate memory for sections.";
+		return 0;
+	}
 
-		//Sanity check entsize
-		if (rela_sect->sh_entsize != sizeof(Elf32_Rela) || sym_sect->sh_entsize != sizeof(Elf32_Sym))
+	//Merged sections are only read to be split into the constant pool
+	if (memchr(obj->wanted, SECT_MERGED, obj->elf.header.e_shnum))
+	{
+		*merge_src = calloc(obj->elf.header.e_shnum, sizeof(void*));
+		obj->merged = calloc(obj->elf.header.e_shnum, sizeof(merge_sect_t));
+		if (!*merge_src || !obj->merged)
 		{
-			error = "Invalid entsize for rela or symtab";
+			error = "Failed to allocate merge state";
 			return 0;
 		}
+	}
 
-		//Allocate buffers
-		Elf32_Rela *relocations = malloc(rela_sect->sh_size);
-		Elf32_Sym *symbols = malloc(sym_sect->sh_size);
-		char *sym_strs = malloc(symstr_sect->sh_size);
+	for (int i = 0; i < obj->elf.header.e_shnum; ++i)
+	{
+		Elf32_Shdr *sect = &obj->elf.sects[i];
 
-		if (!relocations || !symbols || !sym_strs)
+		if (obj->wanted[i] == SECT_MERGED)
 		{
-			error = "Failed to alloc space for relocations or symbol strings";
-			free(relocations);
-			free(symbols);
-			free(sym_strs);
-			return 0;
+			if (!((*merge_src)[i] = plan_table(&obj->elf, plan, sect->sh_offset, sect->sh_size)))
+				goto _plan_section_loads_error;
+			continue;
 		}
 
-		//Read data
-		fseek(obj->elf.file, rela_sect->sh_offset, SEEK_SET);
-		if (rela_sect->sh_size != fread(relocations, 1, rela_sect->sh_size, obj->elf.file))
-		{
-			error = "Failed to read relocations";
-			free(relocations);
-			free(symbols);
-			free(sym_strs);
-			return 0;
-		}
-		fseek(obj->elf.file, sym_sect->sh_offset, SEEK_SET);
-		if (sym_sect->sh_size != fread(symbols, 1, sym_sect->sh_size, obj->elf.file))
-		{
-			error = "Failed to read symbols";
-			free(relocations);
-			free(symbols);
-			free(sym_strs);
-			return 0;
-		}
-		fseek(obj->elf.file, symstr_sect->sh_offset, SEEK_SET);
-		if (symstr_sect->sh_size != fread(sym_strs, 1, symstr_sect->sh_size, obj->elf.file))
+		if (obj->wanted[i] != SECT_LOADED) continue;
+
+		//Neither the pool nor the arenas hand out cleared memory
+		if (sect->sh_type == SHT_NOBITS)
 		{
-			error = "Failed to read symbol strings";
-			free(relocations);
-			free(symbols);
-			free(sym_strs);
-			return 0;
+			dl_zero(obj->sect_addrs[i], sect->sh_size);
+			continue;
 		}
 
-		//Interpret data
-		int success = save_relocations(&obj->elf, rela_sect->sh_info, relocations, rela_count, symbols, sym_strs, obj->relocations);
-
-		//Cleanup
-		free(relocations);
-		free(symbols);
-		free(sym_strs);
-
-		if (!success) return 0;
+		//Contents are read all at once, in file order
+		if (!io_plan_add(plan, sect->sh_offset, sect->sh_size, obj->sect_addrs[i]))
+			goto _plan_section_loads_error;
 	}
 
 	return 1;
+
+_plan_section_loads_error:
+	error = "Failed to plan section reads";
+	return 0;
 }
 
-static int elf_find_local_symbols(elf_rel_t *obj)
+//Splits the read merged sections into the constant pool, and frees merge_src whether ok or not
+//Splits section i into the constant pool unless an earlier step failed, then drops its file copy
+static int merge_loaded_section(elf_rel_t *obj, void **merge_src, int i, int ok)
 {
-	//Skip NULL section
-	for (int i = 1; i < obj->elf.header.e_shnum; ++i)
+	if (!merge_src[i]) return ok;
+
+	Elf32_Shdr *sect = &obj->elf.sects[i];
+	size_t bytes_new = 0;
+	if (ok && !merge_section(&obj->merged[i], merge_src[i], sect->sh_size, sect->sh_entsize,
+		sect->sh_addralign, (sect->sh_flags & SHF_STRINGS) != 0, &bytes_new, &obj->merge_shared))
 	{
-		Elf32_Shdr *sym_sect = &obj->elf.sects[i];
+		error = "Failed to merge section";
+		ok = 0;
+	}
 
-		//Skip non symbol sections
-		if (sym_sect->sh_type != SHT_SYMTAB) continue;
+	elf_file_release(&obj->elf, merge_src[i]);
+	merge_src[i] = NULL;
+	return ok;
+}
 
-		int sym_count = sym_sect->sh_size / sizeof(Elf32_Sym);
-		Elf32_Shdr *symstr_sect = &obj->elf.sects[sym_sect->sh_link];
+static int merge_loaded_sections(elf_rel_t *obj, void **merge_src, int ok)
+{
+	for (int i = 0; merge_src && i < obj->elf.header.e_shnum; ++i)
+		ok = merge_loaded_section(obj, merge_src, i, ok);
 
-		//Sanity check entsize
-		if (sym_sect->sh_entsize != sizeof(Elf32_Sym))
-		{
-			error = "Invalid entsize for symtab";
-			return 0;
-		}
+	free(merge_src);
+	return ok;
+}
+
+static int load_needed_sections(elf_rel_t *obj)
+{
+	io_plan_t plan;
+	io_plan_init(&plan, obj->elf.region);
 
-		//Allocate buffers
-		Elf32_Sym *symbols = malloc(sym_sect->sh_size);
-		char *sym_strs = malloc(symstr_sect->sh_size);
+	void **merge_src = NULL;
+	int ok = plan_section_loads(obj, &plan, &merge_src);
+	if (ok && !(ok = io_plan_execute(&plan, &obj->elf)))
+		error = "Failed to load sections";
 
-		if (!symbols || !sym_strs)
-		{
-			error = "Failed to alloc space for symbols or symbol strings";
-			free(symbols);
-			free(sym_strs);
-			return 0;
-		}
+	ok = merge_loaded_sections(obj, merge_src, ok);
+	io_plan_free(&plan);
+	return ok;
+}
 
-		//Read data
-		fseek(obj->elf.file, sym_sect->sh_offset, SEEK_SET);
-		if (sym_sect->sh_size != fread(symbols, 1, sym_sect->sh_size, obj->elf.file))
-		{
-			error = "Failed to read symbols";
-			free(symbols);
-			free(sym_strs);
-			return 0;
-		}
-		fseek(obj->elf.file, symstr_sect->sh_offset, SEEK_SET);
-		if (symstr_sect->sh_size != fread(sym_strs, 1, symstr_sect->sh_size, obj->elf.file))
+static uint32_t *take_sda_trampoline(elf_rel_t *obj)
+{
+	if (!obj->sda_tramps)
+	{
+		//Worst case, every small data relocation needs its own stub
+		//Counted from the file on the first stub, most modules never get here
+		Elf32_Rela relas[ELF_RELA_CHUNK];
+		for (int i = 1; i < obj->elf.header.e_shnum; ++i)
 		{
-			error = "Failed to read symbol strings";
-			free(symbols);
-			free(sym_strs);
-			return 0;
-		}
-
-		//Interpret data (skipping NULL symbol)
-		int success = save_symbols(&obj->elf, &symbols[1], sym_count - 1, sym_strs, obj->symbols, obj->loaded_sections);
+			if (!elf_rela_wanted(obj, i)) continue;
 
-		//Cleanup
-		free(symbols);
-		free(sym_strs);
+			size_t rela_count = obj->elf.sects[i].sh_size / sizeof(Elf32_Rela);
+			for (size_t first = 0; first < rela_count; first += ELF_RELA_CHUNK)
+			{
+				size_t count = rela_count - first < ELF_RELA_CHUNK ? rela_count - first : ELF_RELA_CHUNK;
+				if (!elf_read_relas(obj, i, first, relas, count, &error))
+					return NULL;
+
+				for (size_t r = 0; r < count; ++r)
+				{
+					int type = ELF32_R_TYPE(relas[r].r_info);
+					if (type == R_PPC_SDAREL16 || type == R_PPC_EMB_SDA21)
+						++obj->sda_tramp_cap;
+				}
+			}
+		}
 
-		if (!success) return 0;
+		obj->sda_tramps = region_aligned(obj->elf.region, 32, obj->sda_tramp_cap * SDA_TRAMPOLINE_WORDS * sizeof(uint32_t));
+		if (!obj->sda_tramps)
+			return NULL;
 	}
 
-	return 1;
+	if (obj->sda_tramp_count >= obj->sda_tramp_cap)
+		return NULL;
+
+	return &obj->sda_tramps[SDA_TRAMPOLINE_WORDS * obj->sda_tramp_count++];
 }
 
-static int compute_symbol_addresses(elf_rel_t *obj)
+static int apply_sda_relocation(elf_rel_t *obj, rel_symbol_t *relocation, uint32_t target, uintptr_t place)
 {
-	size_t sym_count = ivector_get_count(obj->symbols);
+	//Both forms patch a D-form instruction, with r_offset at or inside it
+	uint32_t *insn = (uint32_t*)(place & ~3);
 
-	for (size_t i = 0; i < sym_count; ++i)
+	if (relocation->rel_type == R_PPC_EMB_SDA21)
 	{
-		def_symbol_t* sym = ivector_get(obj->symbols, i);
-		void *sect_buff = hashtable_get(obj->loaded_sections, (void*)sym->section);
-
-		if (!sect_buff)
+		int reg = sda_pick_reg(target);
+		if (reg >= 0)
 		{
-			Elf32_Shdr *sect = &obj->elf.sects[sym->section];
-			char *sect_name = &obj->elf.sh_strings[sect->sh_name];
-			printf("No address for symbol '%s' of '%s'\n", sym->name, sect_name);
-			sym->address = NULL;
+			RELOCATE_EMB_SDA21(insn, target, 0, reg, sda_base(reg));
+			return 1;
 		}
-
-		sym->address = (char*)sect_buff + sym->value;
+	}
+	else if (sda_reachable(target, 13))
+	{
+		RELOCATE_SDAREL16(((uint16_t*)place), target, 0, sda_base(13));
+		return 1;
 	}
 
-	return 1;
-}
-
-static int load_progbits_section(elf_rel_t *obj, Elf32_Shdr *sect, int sect_num)
-{
-	void *sect_buff = aligned_alloc(sect->sh_addralign, sect->sh_size);
-	if (!sect_buff)
+	//Out of reach of the host's bases, rebase the access through a stub
+	uint32_t *stub = take_sda_trampoline(obj);
+	if (!stub)
 	{
-		error = "Failed to allocate memory for section.";
+		error = "Failed to allocate small data trampoline.";
 		return 0;
 	}
 
-	fseek(obj->elf.file, sect->sh_offset, SEEK_SET);
-	if (sect->sh_size != fread(sect_buff, 1, sect->sh_size, obj->elf.file))
+	if (!sda_build_trampoline(stub, insn, target))
 	{
-		error = "Failed to load .data";
+		error = "Unsupported instruction or trampoline out of range for small data relocation.";
 		return 0;
 	}
 
-	hashtable_add(obj->loaded_sections, (void*)sect_num, sect_buff);
 	return 1;
 }
 
-static int alloc_bss_section(elf_rel_t *obj, Elf32_Shdr *sect, int sect_num)
+static int compare_counted(const void *a, const void *b)
 {
-	void *sect_buff = aligned_alloc(sect->sh_addralign, sect->sh_size);
-	if (!sect_buff)
+	uintptr_t fa = (uintptr_t)((const counted_func_t*)a)->address, fb = (uintptr_t)((const counted_func_t*)b)->address;
+	return fa < fb ? -1 : fa > fb;
+}
+
+//Returns the counting stub of the function at address, NULL if calls to it are not counted
+static uint32_t *counter_stub_of(elf_rel_t *obj, void *address)
+{
+	if (!obj->counted_count) return NULL;
+
+	counted_func_t key = { address, NULL, NULL };
+	counted_func_t *func = bsearch(&key, obj->counted, obj->counted_count, sizeof(counted_func_t), compare_counted);
+	return func ? func->stub : NULL;
+}
+
+//Writes a counting stub for every function of the module, once its symbols have addresses
+static int build_call_counters(elf_rel_t *obj)
+{
+	if (!obj->counters) return 1;
+
+	obj->counted = malloc(obj->counter_cap * sizeof(counted_func_t));
+	if (!obj->counted)
 	{
-		error = "Failed to allocate memory for bss section.";
+		error = "Failed to allocate call counters";
 		return 0;
 	}
 
-	hashtable_add(obj->loaded_sections, (void*)sect_num, sect_buff);
-	return 1;
-}
+	size_t found = 0;
+	symtab_t *tab = &obj->symbols;
+	for (size_t i = 0; i < tab->count && found < obj->counter_cap; ++i)
+	{
+		Elf32_Half section = tab->sections[i];
+		if (ELF32_ST_TYPE(tab->info[i]) != STT_FUNC || !tab->addresses[i] || section >= obj->elf.header.e_shnum || obj->wanted[section] != SECT_LOADED)
+			continue;
 
-static int load_needed_sections(elf_rel_t *obj)
-{
-	for (int i = 0; i < obj->elf.header.e_shnum; ++i)
+		obj->counted[found].address = tab->addresses[i];
+		obj->counted[found].name = symtab_name(tab, i);
+		++found;
+	}
+
+	qsort(obj->counted, found, sizeof(counted_func_t), compare_counted);
+
+	//Aliases share the stub of the first name found for their address
+	for (size_t i = 0; i < found; ++i)
 	{
-		Elf32_Shdr *sect = &obj->elf.sects[i];
-		if (sect->sh_type == SHT_PROGBITS)
-		{
-			if (!load_progbits_section(obj, sect, i))
-				return 0;
+		if (obj->counted_count && obj->counted[obj->counted_count - 1].address == obj->counted[i].address)
+			continue;
 
-			printf("Loaded PROGBITS sect '%s'\n", &obj->elf.sh_strings[sect->sh_name]);
-		}
-		else if (sect->sh_type == SHT_NOBITS)
-		{
-			if (!alloc_bss_section(obj, sect, i))
-				return 0;
-		}
+		counted_func_t *func = &obj->counted[obj->counted_count];
+		*func = obj->counted[i];
+		func->stub = &obj->counters[obj->counted_count * COUNTER_STUB_WORDS];
+		counter_stub_write(func->stub, func->address);
+		++obj->counted_count;
 	}
 
-	return compute_symbol_addresses(obj);
+	return 1;
 }
 
-static int apply_relocation(elf_rel_t *obj, rel_symbol_t *relocation, def_symbol_t *symbol)
+static int apply_relocation(elf_rel_t *obj, rel_symbol_t *relocation, void *address)
 {
-	void *sect_buff = hashtable_get(obj->loaded_sections, (void*)(int)relocation->section);
+	void *sect_buff = obj->sect_addrs[relocation->section];
 	if (!sect_buff)
 	{
-		char *sect_name = &obj->elf.sh_strings[obj->elf.sects[relocation->section].sh_name];
-		printf("Sect '%s' for '%s' is not loaded.\n", sect_name, symbol->name);
 		error = "Relocation needed for section not loaded.";
 		return 0;
 	}
 
-	int place = (int)&((char*)sect_buff)[relocation->offset];
+	uintptr_t place = (uintptr_t)&((char*)sect_buff)[relocation->offset];
 
-	int sym = (int)symbol->value;
-	int *target = (int*)place;
+	uintptr_t sym = (uintptr_t)address;
+	uint32_t *target = (uint32_t*)place;
 	int addend = relocation->addend;
 
-	printf("Relocation of '%s' at %p with %p\n", symbol->name, (void*)target, (void*)sym);
-
 	switch (relocation->rel_type)
 	{
 		case R_PPC_REL24:
+		{
+			//Calls to the module's own functions go through their counting stub
+			uint32_t *counter = counter_stub_of(obj, (void*)(sym + addend));
+			if (counter)
+			{
+				sym = (uintptr_t)counter;
+				addend = 0;
+			}
+
 			RELOCATE_REL24(target, sym, place, addend);
 			break;
+		}
 
 		case R_PPC_ADDR16_HA:
 			RELOCATE_ADDR16_HA(((uint16_t*)target), sym, addend);
@@ -532,6 +693,10 @@ static int apply_relocation(elf_rel_t *obj, rel_symbol_t *relocation, def_symbol
 			RELOCATE_ADDR16_LO(((uint16_t*)target), sym, addend);
 			break;
 
+		case R_PPC_SDAREL16:
+		case R_PPC_EMB_SDA21:
+			return apply_sda_relocation(obj, relocation, (uint32_t)(sym + addend), place);
+
 		//TODO: Other relocations
 
 		default:
@@ -542,180 +707,2263 @@ static int apply_relocation(elf_rel_t *obj, rel_symbol_t *relocation, def_symbol
 	return 1;
 }
 
-static int apply_relocations(elf_rel_t *obj)
+static const dl_static_sym_t *find_static_symbol(const char *name)
 {
-	size_t rel_count = ivector_get_count(obj->relocations);
-	printf("Matching %d relocations:\n", rel_count);
-	for (size_t i = 0; i < rel_count; ++i)
-	{
-		rel_symbol_t *rel = ivector_get(obj->relocations, i);;
-		def_symbol_t *sym = NULL;
-		ivector_t *local_syms = obj->symbols;
-		size_t lsym_count = ivector_get_count(local_syms);
-		ivector_t *global_syms = self->symbols;
-		size_t gsym_count = ivector_get_count(global_syms);
-
-		//Find matching symbol //OPTIMIZE: Hashtable
-		for (size_t j = 0; j < lsym_count && sym == NULL; ++j)
-		{
-			def_symbol_t* lsym = ((def_symbol_t*)ivector_get(local_syms, j));
-			if (strcmp(lsym->name, rel->name))
-				continue;
-			
-			sym = lsym;
-			printf("[LOCAL] ");
-		}
-		for (size_t j = 0; j < gsym_count && sym == NULL; ++j)
-		{
-			def_symbol_t* gsym = ((def_symbol_t*)ivector_get(global_syms, j));
-			if (strcmp(gsym->name, rel->name))
-				continue;
-			
-			sym = gsym;
-			printf("[GLOBAL] ");
-		}
+	uint32_t count = host_table->count;
+	int32_t disp = host_table->disp[sym_hash(name, 0) % count];
+	uint32_t slot = disp < 0 ? (uint32_t)(-disp - 1) : sym_hash(name, (uint32_t)disp) % count;
+	const dl_static_sym_t *sym = &host_table->syms[host_table->order[slot]];
 
-		if (!sym)
-			return 0;
+	return strcmp(sym->name, name) ? NULL : sym;
+}
 
-		printf("Matched rel/sym %s\n", rel->name);
+static int find_host_symbol(const char *name, void **address)
+{
+	if (host_table)
+	{
+		const dl_static_sym_t *sym = find_static_symbol(name);
+		if (!sym) return 0;
 
-		if (!apply_relocation(obj, rel, sym))
-			return 0;
+		*address = (void*)(uintptr_t)sym->address;
+		return 1;
 	}
 
+	size_t sym = symindex_get(&self->index, name);
+	if (sym == SYMTAB_NONE) return 0;
+
+	*address = self->symbols.addresses[sym];
 	return 1;
 }
 
-static int compute_own_symbols(elf_exec_t *exec)
+static int find_local_symbol(elf_rel_t *obj, const char *name, void **address)
 {
-	size_t sym_count = ivector_get_count(exec->symbols);
+	int found = 0;
+	symtab_t *tab = &obj->symbols;
+	uint32_t hash = sym_hash(name, 0);
 
-	for (size_t i = 0; i < sym_count; ++i)
-	{//REVIEW: Currently relies on the hope that elf2dol will keep .text as the first section and that all needed functions are under it
-		def_symbol_t* sym = ivector_get(exec->symbols, i);
-		Elf32_Shdr *sect = &exec->elf.sects[sym->section];
-		char *sect_name = &exec->elf.sh_strings[sect->sh_name];
-		if (!strcmp(".text", sect_name))
-		{
-			sym->address = (void*)sym->value;
-			continue;
-		}
-		if (!strcmp(".data", sect_name))
-		{
-			sym->address = (void*)sym->value; //FIXME: Wrong
-			continue;
-		}
-		if (!strcmp(".sdata", sect_name))
-		{
-			sym->address = (void*)sym->value; //FIXME: Wrong
-			continue;
-		}
-		if (!strcmp(".init", sect_name) || !strcmp(".fini", sect_name)
-			|| !strcmp(".rodata", sect_name) || !strcmp(".eh_frame_hdr", sect_name)
-			|| !strcmp(".sdata2", sect_name) || !strcmp(".eh_frame", sect_name)
-			|| !strcmp(".init", sect_name) || !strcmp(".fini", sect_name)
-			|| !strcmp(".got2", sect_name) || !strcmp(".ctors", sect_name)
-			|| !strcmp(".dtors", sect_name) || !strcmp(".sbss", sect_name)
-			|| !strcmp(".bss", sect_name) || !strcmp(".comment", sect_name)
-			|| !strcmp(".gnu.attributes", sect_name) || !strcmp(".debug_aranges", sect_name)
-			|| !strcmp(".debug_info", sect_name) || !strcmp(".debug_abbrev", sect_name)
-			|| !strcmp(".debug_line", sect_name) || !strcmp(".debug_str", sect_name)
-			|| !strcmp(".debug_loclists", sect_name) || !strcmp(".debug_rnglists", sect_name)
-			|| !strcmp(".symtab", sect_name) || !strcmp(".strtab", sect_name)
-			|| !strcmp(".shstrtab", sect_name))
+	//Statics of the same name may live in several sections, some of them collected
+	for (size_t i = symtab_next(tab, name, hash, 0); i != SYMTAB_NONE; i = symtab_next(tab, name, hash, i + 1))
+	{
+		if (tab->sections[i] == SHN_UNDEF)
 			continue;
 
-		printf("No address for own symbol '%s' of '%s'\n", sym->name, sect_name);
-		sym->address = NULL;
+		*address = tab->addresses[i];
+		found = 1;
+		if (tab->addresses[i]) break;
 	}
 
+	return found;
+}
+
+//References into merged sections go to the pooled copy of the piece at symbol + addend,
+//as relocations add the addend back, the address returned has it taken off
+static int find_merged_target(elf_rel_t *obj, rel_symbol_t *rel, void **address)
+{
+	if (!obj->merged) return 0;
+
+	size_t sym = symindex_get(&obj->index, rel->name);
+	if (sym == SYMTAB_NONE || obj->symbols.sections[sym] >= obj->elf.header.e_shnum || obj->wanted[obj->symbols.sections[sym]] != SECT_MERGED)
+		return 0;
+
+	char *target = merge_lookup(&obj->merged[obj->symbols.sections[sym]], obj->symbols.values[sym] + rel->addend);
+	if (!target) return 0;
+
+	*address = target - rel->addend;
 	return 1;
 }
 
-int dlinit(char *own_path)
+static int find_exported_symbol(elf_rel_t *obj, const char *name, void **address)
 {
-	error = NULL;
-	if (self)
+	size_t sym = symindex_get(&obj->index, name);
+	if (sym == SYMTAB_NONE || ELF32_ST_BIND(obj->symbols.info[sym]) == STB_LOCAL)
+		return 0;
+
+	*address = obj->symbols.addresses[sym];
+	return 1;
+}
+
+static int find_batch_symbol(resolve_ctx_t *ctx, elf_rel_t *obj, const char *name, void **address)
+{
+	for (int i = 0; i < ctx->peer_count; ++i)
 	{
-		error = "Already initialized wii-dlfcn";
-		return 1;
+		if (ctx->peers[i] != obj && find_exported_symbol(ctx->peers[i], name, address))
+			return 1;
 	}
 
-	elf_exec_t *exec = elf_exec_create(own_path, &error);
-	if (!exec) return 1;
+	*address = hashtable_get(ctx->host_memo, (void*)name);
+	if (*address) return 1;
 
-	if (!elf_exec_valid(exec))
-		goto _dlinit_error;
+	if (!find_host_symbol(name, address))
+		return 0;
 
-	if (!elf_load_sects(&exec->elf))
-		goto _dlinit_error;
+	if (*address) hashtable_add(ctx->host_memo, (void*)name, *address);
+	return 1;
+}
+
+//Checks every global the group defines is provided by owner, or the host if NULL
+static int group_provided(elf_rel_t *obj, Elf32_Word *members, size_t member_count, elf_rel_t *owner)
+{
+	int provided = 0;
+
+	for (size_t i = 1; i < obj->raw_sym_count; ++i)
+	{
+		Elf32_Sym *sym = &obj->raw_syms[i];
+		if (sym->st_shndx == SHN_UNDEF || ELF32_ST_BIND(sym->st_info) == STB_LOCAL)
+			continue;
+
+		size_t m = 1;
+		while (m < member_count && members[m] != sym->st_shndx) ++m;
+		if (m == member_count) continue;
+
+		void *address;
+		const char *name = &obj->raw_strs[sym->st_name];
+		if (owner ? !find_exported_symbol(owner, name, &address) : !find_host_symbol(name, &address))
+			return 0;
+
+		provided = 1;
+	}
+
+	//A group without globals has nothing to bind to
+	return provided;
+}
+
+//Binds COMDAT groups already resident in another module or the host instead of loading them again
+static int select_groups(elf_rel_t *obj)
+{
+	int group_count = count_groups(obj);
+	Elf32_Word **members = calloc(obj->elf.header.e_shnum, sizeof(Elf32_Word*));
+	obj->group_names = calloc(group_count, sizeof(char*));
+	obj->group_owners = calloc(group_count, sizeof(elf_rel_t*));
+	if (!members || !obj->group_names || !obj->group_owners)
+	{
+		free(members);
+		error = "Failed to allocate group state";
+		return 0;
+	}
+
+	//Group tables are small and usually next to each other, read them together
+	io_plan_t plan;
+	io_plan_init(&plan, obj->elf.region);
+
+	int ok = 1;
+	for (int i = 1; ok && i < obj->elf.header.e_shnum; ++i)
+	{
+		Elf32_Shdr *sect = &obj->elf.sects[i];
+		if (sect->sh_type != SHT_GROUP || sect->sh_info >= obj->raw_sym_count) continue;
+
+		members[i] = plan_table(&obj->elf, &plan, sect->sh_offset, sect->sh_size);
+		ok = members[i] != NULL;
+	}
+
+	if (!ok || !io_plan_execute(&plan, &obj->elf))
+	{
+		error = "Failed to read section groups";
+		ok = 0;
+	}
+	io_plan_free(&plan);
+
+	int host = self || host_table;
+	for (int i = 1; i < obj->elf.header.e_shnum; ++i)
+	{
+		if (!members[i]) continue;
+
+		Elf32_Shdr *sect = &obj->elf.sects[i];
+		Elf32_Word *words = members[i];
+		size_t count = sect->sh_size / sizeof(Elf32_Word);
+		if (ok) elf_swap_words(words, count);
+
+		if (!ok || !count || !(words[0] & GRP_COMDAT))
+		{
+			elf_file_release(&obj->elf, words);
+			continue;
+		}
+
+		Elf32_Sym *sig_sym = &obj->raw_syms[sect->sh_info];
+		const char *signature = ELF32_ST_TYPE(sig_sym->st_info) == STT_SECTION && sig_sym->st_shndx < obj->elf.header.e_shnum
+			? &obj->elf.sh_strings[obj->elf.sects[sig_sym->st_shndx].sh_name] : &obj->raw_strs[sig_sym->st_name];
+
+		comdat_t *group = comdat_groups ? hashtable_get(comdat_groups, (void*)signature) : NULL;
+		elf_rel_t *owner = group ? group->owner : NULL;
+
+		if (!(owner || host) || !group_provided(obj, words, count, owner))
+		{
+			//This module's copy is loaded, and registered for others once it is resident
+			obj->group_names[obj->group_name_count] = strdup(signature);
+			if (obj->group_names[obj->group_name_count]) ++obj->group_name_count;
+			elf_file_release(&obj->elf, words);
+			continue;
+		}
+
+		if (!obj->shared_from && !(obj->shared_from = calloc(obj->elf.header.e_shnum, sizeof(elf_rel_t*))))
+		{
+			error = "Failed to allocate group state";
+			ok = 0;
+			elf_file_release(&obj->elf, words);
+			continue;
+		}
+
+		for (size_t m = 1; m < count; ++m)
+		{
+			if (words[m] >= obj->elf.header.e_shnum || !obj->wanted[words[m]]) continue;
+
+			obj->wanted[words[m]] = SECT_SHARED;
+			obj->shared_from[words[m]] = owner;
+		}
+
+		obj->group_owners[obj->group_owner_count++] = owner;
+		elf_file_release(&obj->elf, words);
+	}
+
+	free(members);
+	return ok;
+}
+
+//Points symbols first to end of groups bound elsewhere at the resident copy
+static void bind_shared_symbols(elf_rel_t *obj, size_t first, size_t end)
+{
+	if (!obj->shared_from) return;
+
+	symtab_t *tab = &obj->symbols;
+	for (size_t i = first; i < end; ++i)
+	{
+		Elf32_Half section = tab->sections[i];
+		if (section >= obj->elf.header.e_shnum || obj->wanted[section] != SECT_SHARED)
+			continue;
+
+		//Locals of the group stay unresolved, nothing outside the group may reference them
+		elf_rel_t *owner = obj->shared_from[section];
+		const char *name = symtab_name(tab, i);
+		void *address = NULL;
+		if (ELF32_ST_BIND(tab->info[i]) != STB_LOCAL && !(owner ? find_exported_symbol(owner, name, &address) : find_host_symbol(name, &address)))
+			address = NULL;
+
+		tab->addresses[i] = address;
+	}
+}
+
+//Takes the module's references on the groups it bound to, release_groups drops them
+static void hold_groups(elf_rel_t *obj)
+{
+	for (size_t i = 0; i < obj->group_owner_count; ++i)
+	{
+		if (obj->group_owners[i]) ++obj->group_owners[i]->group_users;
+	}
+}
+
+//Makes the module's groups available to later loads
+static void register_groups(elf_rel_t *obj)
+{
+	if (!obj->group_name_count) return;
+	if (!comdat_groups && !(comdat_groups = hashtable_create(hash_str, compare_str)))
+		return;
+
+	//Registering is best effort, a group missing from the table is just not shared
+	for (size_t i = 0; i < obj->group_name_count; ++i)
+	{
+		comdat_t *group = hashtable_get(comdat_groups, obj->group_names[i]);
+		if (!group)
+		{
+			group = malloc(sizeof(comdat_t));
+			if (!group) continue;
+
+			group->signature = strdup(obj->group_names[i]);
+			group->owner = NULL;
+			if (!group->signature)
+			{
+				free(group);
+				continue;
+			}
+			hashtable_add(comdat_groups, group->signature, group);
+		}
+
+		if (!group->owner) group->owner = obj;
+	}
+}
+
+static void commit_groups(elf_rel_t *obj)
+{
+	hold_groups(obj);
+	register_groups(obj);
+}
+
+static int raw_symbol_exported(elf_rel_t *obj, const char *name)
+{
+	for (size_t i = 1; i < obj->raw_sym_count; ++i)
+	{
+		Elf32_Sym *sym = &obj->raw_syms[i];
+		if (sym->st_shndx == SHN_UNDEF || ELF32_ST_BIND(sym->st_info) == STB_LOCAL)
+			continue;
+
+		if (!strcmp(&obj->raw_strs[sym->st_name], name))
+			return 1;
+	}
+
+	return 0;
+}
+
+static int preflight_symbol(elf_rel_t *obj, resolve_ctx_t *ctx, const char *name)
+{
+	void *address;
+
+	if (find_host_symbol(name, &address))
+		return 1;
+
+	for (int i = 0; ctx && i < ctx->peer_count; ++i)
+	{
+		if (ctx->peers[i] != obj && raw_symbol_exported(ctx->peers[i], name))
+			return 1;
+	}
+
+	return 0;
+}
+
+//Progress of preflight_some, and the undefined symbols found missing so far
+typedef struct {
+	size_t next;
+	int missing;
+	const char *first;
+} preflight_t;
+
+//Checks up to max more raw symbols, see preflight_undefined
+static void preflight_some(elf_rel_t *obj, resolve_ctx_t *ctx, preflight_t *preflight, size_t max)
+{
+	for (; max && preflight->next < obj->raw_sym_count; ++preflight->next, --max)
+	{
+		size_t i = preflight->next;
+		Elf32_Sym *sym = &obj->raw_syms[i];
+		const char *name = &obj->raw_strs[sym->st_name];
+
+		//Unresolved weak references are allowed to stay NULL, the NULL symbol is local
+		if (sym->st_shndx != SHN_UNDEF || ELF32_ST_BIND(sym->st_info) != STB_GLOBAL || !*name)
+			continue;
+
+		//Only referenced from collected sections or groups bound elsewhere, never resolved
+		if (obj->referenced && !obj->referenced[i])
+			continue;
+
+		if (preflight_symbol(obj, ctx, name))
+			continue;
+
+		if (!preflight->missing++) preflight->first = name;
+	}
+}
+
+//Fails naming the first missing symbol, once every symbol was checked
+static int preflight_report(const preflight_t *preflight)
+{
+	static DL_THREAD_LOCAL char message[128];
+
+	if (!preflight->missing)
+		return 1;
+
+	snprintf(message, sizeof(message), "Undefined symbol '%.64s' (%d undefined in total)", preflight->first, preflight->missing);
+	error = message;
+	return 0;
+}
+
+//Checks every undefined symbol the loaded sections use can be resolved, before they are read
+static int preflight_undefined(elf_rel_t *obj, resolve_ctx_t *ctx)
+{
+	preflight_t preflight = { 0 };
+	preflight_some(obj, ctx, &preflight, SIZE_MAX);
+	return preflight_report(&preflight);
+}
+
+//Resolves and applies one relocation
+static int apply_relocation_record(elf_rel_t *obj, resolve_ctx_t *ctx, rel_symbol_t *rel)
+{
+	void *address = NULL;
+
+	//Pooled constants first, then the module itself, then its batch or the host
+	if (!find_merged_target(obj, rel, &address))
+	{
+		if (find_local_symbol(obj, rel->name, &address))
+		{
+			if (!address)
+			{
+				error = "Relocation against a section not loaded";
+				return 0;
+			}
+		}
+		else if (!(ctx ? find_batch_symbol(ctx, obj, rel->name, &address) : find_host_symbol(rel->name, &address)))
+		{
+			error = "Undefined symbol";
+			return 0;
+		}
+	}
+
+	rel->resolved = address;
+	return apply_relocation(obj, rel, address);
+}
+
+//Position in the relocations of a module, by rela section and entry in it
+typedef struct {
+	int sect;
+	size_t done;
+} rela_cursor_t;
+
+//Reads, resolves and applies up to max relocations from the cursor on, one chunk at a time
+//Records are only kept when retained, otherwise each chunk is dropped once applied
+static int apply_relocations_from(elf_rel_t *obj, resolve_ctx_t *ctx, rela_cursor_t *cursor, size_t max)
+{
+	Elf32_Rela relas[ELF_RELA_CHUNK];
+
+	while (max && cursor->sect < obj->elf.header.e_shnum)
+	{
+		Elf32_Shdr *rela_sect = &obj->elf.sects[cursor->sect];
+		size_t rela_count = rela_sect->sh_size / sizeof(Elf32_Rela);
+		if (!elf_rela_wanted(obj, cursor->sect) || cursor->done >= rela_count)
+		{
+			++cursor->sect;
+			cursor->done = 0;
+			continue;
+		}
+
+		size_t count = rela_count - cursor->done;
+		if (count > ELF_RELA_CHUNK) count = ELF_RELA_CHUNK;
+		if (count > max) count = max;
+		if (!elf_read_relas(obj, cursor->sect, cursor->done, relas, count, &error))
+			return 0;
+
+		for (size_t r = 0; r < count; ++r)
+		{
+			rel_symbol_t rel;
+			if (!elf_parse_relocation(obj, rela_sect->sh_info, &relas[r], &rel, &error))
+				return 0;
+			if (!apply_relocation_record(obj, ctx, &rel))
+				return 0;
+			if (obj->relocations.resolved) reltab_store(&obj->relocations, &rel);
+		}
+
+		cursor->done += count;
+		max -= count;
+	}
+
+	return 1;
+}
+
+static int apply_relocations(elf_rel_t *obj, resolve_ctx_t *ctx)
+{
+	rela_cursor_t cursor = { 1, 0 };
+	return apply_relocations_from(obj, ctx, &cursor, SIZE_MAX);
+}
+
+static void sync_caches(elf_rel_t *obj)
+{
+#ifdef GEKKO
+	//Relocated code and stubs were written through the data cache
+	for (int i = 0; i < obj->elf.header.e_shnum; ++i)
+	{
+		if (!obj->sect_addrs[i]) continue;
+
+		DCFlushRange(obj->sect_addrs[i], obj->elf.sects[i].sh_size);
+		if (obj->elf.sects[i].sh_flags & SHF_EXECINSTR)
+			ICInvalidateRange(obj->sect_addrs[i], obj->elf.sects[i].sh_size);
+	}
+
+	if (obj->sda_tramps)
+	{
+		size_t len = obj->sda_tramp_count * SDA_TRAMPOLINE_WORDS * sizeof(uint32_t);
+		DCFlushRange(obj->sda_tramps, len);
+		ICInvalidateRange(obj->sda_tramps, len);
+	}
+
+	if (obj->counters)
+	{
+		size_t len = obj->counter_cap * COUNTER_STUB_WORDS * sizeof(uint32_t);
+		DCFlushRange(obj->counters, len);
+		ICInvalidateRange(obj->counters, len);
+	}
+#else
+	(void)obj;
+#endif
+}
+
+static int init_dynamic(char *own_path)
+{
+	if (self || host_table)
+	{
+		error = "Already initialized wii-dlfcn";
+		return 1;
+	}
+
+	dl_io_t io;
+	if (dl_io_open_stdio(own_path, &io))
+	{
+		error = "Could not open ELF file.";
+		return 1;
+	}
+
+	elf_exec_t *exec = elf_exec_create(&io, &error);
+	if (!exec) return 1;
+
+	if (!elf_exec_valid(exec, &error))
+		goto _dlinit_error;
+
+	if (!elf_load_sects(&exec->elf, &error))
+		goto _dlinit_error;
 	
-	if (!elf_load_shstrings(&exec->elf))
+	if (!elf_load_shstrings(&exec->elf, &error))
+		goto _dlinit_error;
+
+	if (!elf_find_defined_symbols(exec, &error))
+		goto _dlinit_error;
+
+	if (!compute_own_symbols(exec))
+		goto _dlinit_error;
+
+	if (!index_own_symbols(exec, &error))
 		goto _dlinit_error;
 
-	if (!elf_find_defined_symbols(exec))
-		goto _dlinit_error;
+	self = exec;
+	return 0;
+
+_dlinit_error:
+	elf_exec_destroy(exec);
+	return 1;
+}
+
+static int init_static(void)
+{
+	if (self || host_table)
+	{
+		error = "Already initialized wii-dlfcn";
+		return 1;
+	}
+
+	//Weak, only defined when built with STATIC_SYMTAB=1
+	if (!&dl_static_symtab || !dl_static_symtab.count)
+	{
+		error = "No static host symbol table linked in";
+		return 1;
+	}
+
+	host_table = &dl_static_symtab;
+	return 0;
+}
+
+int dlinit(char *own_path)
+{
+	error = NULL;
+	dl_sync_init();
+
+	dl_lock();
+	int ret = init_dynamic(own_path);
+	dl_unlock();
+	return ret;
+}
+
+int dlinit_static(void)
+{
+	error = NULL;
+	dl_sync_init();
+
+	dl_lock();
+	int ret = init_static();
+	dl_unlock();
+	return ret;
+}
+
+//Refuses calls that cannot load without the heap while in real-time mode
+static int rt_refused(void)
+{
+	if (!rt_modules) return 0;
+
+	error = "Not available in real-time mode, load through dlopen_io";
+	return 1;
+}
+
+//Bytes of the region of a real-time module within limits, every allocation of a load is counted:
+//headers and section tables, read plans and their staging, raw tables, records, symbol index, small data stubs,
+//alignment of each allocation and the image
+static size_t rt_region_size(const dlrtlimits_t *limits)
+{
+	size_t sections = limits->sections, symbols = limits->symbols, relocations = limits->relocations;
+
+	return sizeof(elf_rel_t)
+		+ sections * (sizeof(Elf32_Shdr) + sizeof(void*) + 3 + 2 * sizeof(int))
+		+ 8 * (sections + 10) * sizeof(io_range_t) + 2 * IO_PLAN_STAGE
+		+ limits->strings
+		+ symbols * (sizeof(Elf32_Sym) + 1) + symtab_bytes(symbols) + symindex_slots(symbols) * sizeof(uint32_t)
+		+ reltab_bytes(relocations) + relocations * SDA_TRAMPOLINE_WORDS * sizeof(uint32_t)
+		+ (sections + 64) * REGION_ALIGN + 2 * MEMOPS_LINE
+		+ limits->image;
+}
+
+static region_t *rt_take_region(void)
+{
+	for (int i = 0; i < rt_modules; ++i)
+	{
+		if (rt_regions[i].taken) continue;
+
+		rt_regions[i].taken = 1;
+		return &rt_regions[i];
+	}
+
+	error = "Too many modules loaded";
+	return NULL;
+}
+
+//Real-time limits are checked from the headers alone, before the tables they bound are read
+static int rt_admit_header(elf_rel_t *obj)
+{
+	if (!obj->elf.region || obj->elf.header.e_shnum <= rt_limits.sections)
+		return 1;
+
+	error = "Module has more sections than the real-time limit";
+	return 0;
+}
+
+static int rt_admit_tables(elf_rel_t *obj)
+{
+	if (!obj->elf.region) return 1;
+
+	size_t symbols = 0, relocations = 0, strings = 0;
+	int shnum = obj->elf.header.e_shnum;
+	if (obj->elf.header.e_shstrndx < shnum)
+		strings += obj->elf.sects[obj->elf.header.e_shstrndx].sh_size;
+
+	for (int i = 1; i < shnum; ++i)
+	{
+		Elf32_Shdr *sect = &obj->elf.sects[i];
+		if (sect->sh_type == SHT_SYMTAB)
+		{
+			symbols += sect->sh_size / sizeof(Elf32_Sym);
+			if (sect->sh_link < (Elf32_Word)shnum) strings += obj->elf.sects[sect->sh_link].sh_size;
+		}
+		else if (sect->sh_type == SHT_RELA)
+			relocations += sect->sh_size / sizeof(Elf32_Rela);
+	}
+
+	if (symbols > rt_limits.symbols)
+		error = "Module has more symbols than the real-time limit";
+	else if (relocations > rt_limits.relocations)
+		error = "Module has more relocations than the real-time limit";
+	else if (strings > rt_limits.strings)
+		error = "Module has more string table bytes than the real-time limit";
+	else
+		return 1;
+
+	return 0;
+}
+
+//Bounds what image_alloc takes whatever goes to small data and however the sections are laid out
+static int rt_admit_image(elf_rel_t *obj)
+{
+	if (!obj->elf.region) return 1;
+
+	size_t bound = 0, largest = 0;
+	for (int i = 0; i < obj->elf.header.e_shnum; ++i)
+	{
+		if (obj->wanted[i] != SECT_LOADED) continue;
+
+		size_t align = obj->elf.sects[i].sh_addralign;
+		if (align < MEMOPS_LINE) align = MEMOPS_LINE;
+		if (align > largest) largest = align;
+		bound += obj->elf.sects[i].sh_size + align;
+	}
+
+	if (bound + largest <= rt_limits.image)
+		return 1;
+
+	error = "Module sections exceed the real-time image limit";
+	return 0;
+}
+
+//Roots are only used with relocations, NULL keeps every section reached from a global
+//Reads the header and section table, and decides which sections are wanted
+//In real-time mode the module takes a region, and is rejected before anything is read that does not fit it
+static elf_rel_t *open_headers(dl_io_t *io)
+{
+	region_t *region = NULL;
+	if (rt_modules && !(region = rt_take_region()))
+	{
+		io->ops->close(io->ctx);
+		return NULL;
+	}
+
+	elf_rel_t *obj = elf_rel_create(io, region, &error);
+	if (!obj) return NULL;
+
+	if (!elf_rel_valid(obj, &error) || !rt_admit_header(obj) || !elf_rel_alloc_tables(obj, &error)
+		|| !elf_load_sects(&obj->elf, &error) || !rt_admit_tables(obj) || !elf_load_shstrings(&obj->elf, &error))
+	{
+		elf_rel_destroy(obj);
+		return NULL;
+	}
+
+	select_sections(obj, section_policy);
+	if (!rt_admit_image(obj))
+	{
+		elf_rel_destroy(obj);
+		return NULL;
+	}
+
+	return obj;
+}
+
+//Binds section groups to the copies already resident, once the symbol tables are read
+static int bind_groups(elf_rel_t *obj)
+{
+	//Real-time modules keep their own copy of every group, sharing them takes the heap
+	if (obj->elf.region || !count_groups(obj))
+		return 1;
+
+	return select_groups(obj);
+}
+
+//Reads the symbol tables, binding section groups and leaving out unreached sections
+//Relocations are streamed from the file while collecting, only once groups are bound
+static int read_module_tables(elf_rel_t *obj, const char **roots)
+{
+	return elf_read_tables(obj, &error) && bind_groups(obj) && collect_sections(obj, roots, &error);
+}
+
+static elf_rel_t *open_relocatable_io(dl_io_t *io, const char **roots)
+{
+	elf_rel_t *obj = open_headers(io);
+	if (!obj) return NULL;
+
+	if (!read_module_tables(obj, roots))
+	{
+		elf_rel_destroy(obj);
+		return NULL;
+	}
+
+	return obj;
+}
+
+static elf_rel_t *open_relocatable(const char *path)
+{
+	dl_io_t io;
+	if (dl_io_open_stdio(path, &io))
+	{
+		error = "Could not open ELF file.";
+		return NULL;
+	}
+
+	return open_relocatable_io(&io, NULL);
+}
+
+//Adds rows first to end of one binding to the index, globals go in before locals so a local never hides them
+static void index_module_symbols(elf_rel_t *obj, int locals, size_t first, size_t end)
+{
+	symtab_t *tab = &obj->symbols;
+	for (size_t i = first; i < end; ++i)
+	{
+		Elf32_Half section = tab->sections[i];
+		if (section == SHN_UNDEF || (ELF32_ST_BIND(tab->info[i]) == STB_LOCAL) != locals)
+			continue;
+
+		//Collected symbols are not there to be found
+		if (section < obj->elf.header.e_shnum && obj->wanted[section] == SECT_COLLECTED)
+			continue;
+
+		symindex_add(&obj->index, i);
+	}
+}
+
+//Records are filled as the relocations are applied
+static int init_relocation_records(elf_rel_t *obj)
+{
+	if (!retain_relocs)
+		return 1;
+
+	if (!reltab_init(&obj->relocations, obj->elf.region, elf_count_relocations(obj), obj->raw_strs, obj->elf.sh_strings))
+	{
+		error = "Failed to allocate relocation records";
+		return 0;
+	}
+
+	return 1;
+}
+
+//Passes parsing makes over the symbols, in order, those going over rows can stop at any of them
+typedef enum {
+	PARSE_INIT,
+	PARSE_SAVE,
+	PARSE_PLACE,
+	PARSE_INDEX_GLOBALS,
+	PARSE_INDEX_LOCALS,
+	PARSE_FINISH,
+	PARSE_DONE,
+} parse_pass_t;
+
+typedef struct {
+	parse_pass_t pass;
+	size_t next;
+} parse_cursor_t;
+
+//Parses symbols of a module whose sections are loaded, going over up to max rows from the cursor on
+static int parse_relocatable_from(elf_rel_t *obj, parse_cursor_t *cursor, size_t max)
+{
+	symtab_t *tab = &obj->symbols;
+
+	while (max && cursor->pass != PARSE_DONE)
+	{
+		//Saving goes over the raw symbols, the NULL one is left out as a NOTYPE symbol
+		size_t total = cursor->pass == PARSE_SAVE ? obj->raw_sym_count : tab->count;
+		if (cursor->pass == PARSE_INIT || cursor->pass == PARSE_FINISH) total = 0;
+		size_t first = cursor->next, end = total - first < max ? total : first + max;
+
+		switch (cursor->pass)
+		{
+		case PARSE_INIT:
+			if (!elf_init_local_symbols(obj))
+			{
+				error = "Failed to allocate symbols";
+				return 0;
+			}
+			break;
+
+		case PARSE_SAVE:
+			elf_save_local_symbols(obj, first, end - first);
+			break;
+
+		case PARSE_PLACE:
+			compute_symbol_addresses(obj, first, end);
+			bind_shared_symbols(obj, first, end);
+			break;
+
+		case PARSE_INDEX_GLOBALS:
+			if (!first && !symindex_init(&obj->index, tab, obj->elf.region))
+			{
+				error = "Failed to allocate symbol index";
+				return 0;
+			}
+			index_module_symbols(obj, 0, first, end);
+			break;
+
+		case PARSE_INDEX_LOCALS:
+			index_module_symbols(obj, 1, first, end);
+			break;
+
+		default:
+			if (!build_call_counters(obj) || !init_relocation_records(obj))
+				return 0;
+			break;
+		}
+
+		max -= end - first;
+		cursor->next = end;
+		if (end == total)
+		{
+			cursor->next = 0;
+			++cursor->pass;
+		}
+	}
+
+	return 1;
+}
+
+//Parses symbols and relocations of a module whose sections are loaded
+static int parse_relocatable(elf_rel_t *obj)
+{
+	parse_cursor_t cursor = { PARSE_INIT, 0 };
+	return parse_relocatable_from(obj, &cursor, SIZE_MAX);
+}
+
+static int load_relocatable(elf_rel_t *obj)
+{
+	return load_needed_sections(obj) && parse_relocatable(obj);
+}
+
+static void finish_relocatable(elf_rel_t *obj)
+{
+	//Symbols and relocations are parsed into records by now, which still name into raw_strs
+	if (obj->raw_syms) elf_file_release(&obj->elf, obj->raw_syms);
+	obj->raw_syms = NULL;
+	obj->raw_sym_count = 0;
+
+	compute_load_stats(obj);
+}
+
+static int link_relocatable(elf_rel_t *obj, resolve_ctx_t *ctx)
+{
+	if (!apply_relocations(obj, ctx))
+		return 0;
+
+	sync_caches(obj);
+	return 1;
+}
+
+static elf_rel_t *open_cached(const char *path);
+
+void *dlopen(const char *path, int mode)
+{
+	if (rt_refused())
+		return NULL;
+
+	//Opened by path, so the module can be read again after an eviction
+	dl_lock();
+	if (cache_budget)
+	{
+		elf_rel_t *obj = open_cached(path);
+		dl_unlock();
+		return obj ? obj->handle : NULL;
+	}
+	dl_unlock();
+
+	dl_io_t io;
+	if (dl_io_open_stdio(path, &io))
+	{
+		error = "Could not open ELF file.";
+		return NULL;
+	}
+
+	return dlopen_io(&io, mode);
+}
+
+static void cache_make_room(size_t size);
+
+//Loads and links a module without publishing it
+//Cached modules first evict others until the module fits the cache budget
+static elf_rel_t *load_module(dl_io_t *io, const char **roots, int cached)
+{
+	elf_rel_t *obj = open_relocatable_io(io, roots);
+	if (!obj) return NULL;
+
+	//Fail before any section is allocated or read
+	if (!preflight_undefined(obj, NULL))
+		goto _load_module_error;
+
+	if (cached)
+	{
+		size_t align;
+		cache_make_room(image_layout(obj, 0, &align, NULL));
+	}
+
+	if (!load_relocatable(obj))
+		goto _load_module_error;
+
+	if (!link_relocatable(obj, NULL))
+		goto _load_module_error;
+
+	finish_relocatable(obj);
+	return obj;
+
+_load_module_error:
+	elf_rel_destroy(obj);
+	return NULL;
+}
+
+static elf_rel_t *open_module(dl_io_t *io, const char **roots)
+{
+	elf_rel_t *obj = load_module(io, roots, 0);
+	if (!obj) return NULL;
+
+	if (!publish_modules(&obj, 1))
+	{
+		elf_rel_destroy(obj);
+		return NULL;
+	}
+
+	commit_groups(obj);
+	return obj;
+}
+
+void *dlopen_io(dl_io_t *io, int mode)
+{
+	//Bound immediately, see dlopen
+	(void)mode;
+
+	dl_lock();
+	elf_rel_t *obj = open_module(io, NULL);
+	dl_unlock();
+	return obj ? obj->handle : NULL;
+}
+
+void *dlopen_roots(const char *path, int mode, const char **roots)
+{
+	//Bound immediately, see dlopen
+	(void)mode;
+
+	if (rt_refused())
+		return NULL;
+
+	dl_io_t io;
+	if (dl_io_open_stdio(path, &io))
+	{
+		error = "Could not open ELF file.";
+		return NULL;
+	}
+
+	dl_lock();
+	elf_rel_t *obj = open_module(&io, roots);
+	dl_unlock();
+	return obj ? obj->handle : NULL;
+}
+
+dl_pack_t *dlpackopen(const char *path)
+{
+	return pack_open(path, &error);
+}
+
+int dlpackclose(dl_pack_t *pack)
+{
+	pack_release(pack);
+	return 0;
+}
+
+void *dlopen_pack(dl_pack_t *pack, const char *name, int mode)
+{
+	if (rt_refused())
+		return NULL;
+
+	//The pack's stream is shared with the modules loading from it
+	dl_io_t io;
+	dl_lock();
+	int failed = pack_member_io(pack, name, &io, &error);
+	dl_unlock();
+	if (failed)
+		return NULL;
+
+	return dlopen_io(&io, mode);
+}
+
+static int open_batch(const char **paths, int count, void **handles_out)
+{
+	resolve_ctx_t ctx = { 0 };
+	ctx.peer_count = count;
+	ctx.peers = calloc(count, sizeof(elf_rel_t*));
+	ctx.host_memo = hashtable_create(hash_str, compare_str);
+	if (!ctx.peers || !ctx.host_memo)
+	{
+		error = "Failed to allocate batch state";
+		goto _dlopen_many_error;
+	}
+
+	//Go phase by phase over the batch, so file lookups and header reads happen
+	//back to back and every module is resident before any of them is linked
+	for (int i = 0; i < count; ++i)
+	{
+		ctx.peers[i] = open_relocatable(paths[i]);
+		if (!ctx.peers[i]) goto _dlopen_many_error;
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		if (!preflight_undefined(ctx.peers[i], &ctx)) goto _dlopen_many_error;
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		if (!load_relocatable(ctx.peers[i])) goto _dlopen_many_error;
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		if (!link_relocatable(ctx.peers[i], &ctx)) goto _dlopen_many_error;
+	}
+
+	for (int i = 0; i < count; ++i)
+		finish_relocatable(ctx.peers[i]);
+
+	//Slots for the whole batch or for none of it
+	if (!publish_modules(ctx.peers, count))
+		goto _dlopen_many_error;
+
+	for (int i = 0; i < count; ++i)
+	{
+		commit_groups(ctx.peers[i]);
+		handles_out[i] = ctx.peers[i]->handle;
+	}
+
+	hashtable_destroy(ctx.host_memo);
+	free(ctx.peers);
+	return 0;
+
+_dlopen_many_error:
+	//All or nothing, nothing from the batch stays loaded
+	for (int i = 0; ctx.peers && i < count; ++i)
+	{
+		if (ctx.peers[i]) elf_rel_destroy(ctx.peers[i]);
+	}
+
+	if (ctx.host_memo) hashtable_destroy(ctx.host_memo);
+	free(ctx.peers);
+	return 1;
+}
+
+int dlopen_many(const char **paths, int count, int mode, void **handles_out)
+{
+	//Batches are bound immediately like any other load, see dlopen
+	(void)mode;
+
+	error = NULL;
+	if (count <= 0)
+	{
+		error = "Invalid module count";
+		return 1;
+	}
+
+	if (rt_refused())
+		return 1;
+
+	dl_lock();
+	int ret = open_batch(paths, count, handles_out);
+	dl_unlock();
+	return ret;
+}
+
+static int check_module(const char *path)
+{
+	if (!self && !host_table)
+	{
+		error = "wii-dlfcn not initialized";
+		return 1;
+	}
+
+	//Relocations are walked as a load would, so imports only dead code uses are not reported
+	elf_rel_t *obj = open_relocatable(path);
+	if (!obj) return 1;
+
+	int ok = preflight_undefined(obj, NULL);
+	elf_rel_destroy(obj);
+	return ok ? 0 : 1;
+}
+
+int dlcheck(const char *path)
+{
+	error = NULL;
+
+	dl_lock();
+	int ret = check_module(path);
+	dl_unlock();
+	return ret;
+}
+
+static void unload_module(elf_rel_t *obj);
+
+//Drops the module's references on the groups it bound to and withdraws the groups it provided
+static void release_groups(elf_rel_t *obj)
+{
+	for (size_t i = 0; i < obj->group_name_count; ++i)
+	{
+		comdat_t *group = comdat_groups ? hashtable_get(comdat_groups, obj->group_names[i]) : NULL;
+		if (group && group->owner == obj) group->owner = NULL;
+	}
+
+	for (size_t i = 0; i < obj->group_owner_count; ++i)
+	{
+		elf_rel_t *owner = obj->group_owners[i];
+		if (owner && !--owner->group_users && owner->closed)
+			unload_module(owner);
+	}
+}
+
+static void unload_module(elf_rel_t *obj)
+{
+	//Unpublish first, the module is only freed once no reader can be using it
+	retire_module(obj);
+	release_groups(obj);
+	elf_rel_destroy(obj);
+}
+
+//Return addresses followed up the stack before a module is assumed not to be running
+#define CACHE_STACK_DEPTH 64
+
+//Puts obj in old's slot, old may be freed once this returns, call with the writer lock held
+static void replace_module(elf_rel_t *old, elf_rel_t *obj)
+{
+	obj->handle = old->handle;
+	obj->cache = old->cache;
+	__atomic_store_n(&module_slots[(uintptr_t)old->handle & HANDLE_SLOT_MASK].obj, obj, __ATOMIC_RELEASE);
+	dl_synchronize();
+}
+
+//Whether the calling thread is running code of the module, somewhere up its stack
+static int module_on_stack(elf_rel_t *obj)
+{
+#ifdef GEKKO
+	uintptr_t start = (uintptr_t)obj->image, end = start + obj->image_size;
+
+	//Each frame starts with the back chain, the word after it holds the LR saved by the callee
+	uintptr_t *frame = __builtin_frame_address(0);
+	for (int depth = 0; frame && depth < CACHE_STACK_DEPTH; ++depth)
+	{
+		frame = (uintptr_t*)frame[0];
+		if (frame && frame[1] >= start && frame[1] < end)
+			return 1;
+	}
+#else
+	(void)obj;
+#endif
+	return 0;
+}
+
+static int entry_evictable(cache_entry_t *entry)
+{
+	return entry->resident && !entry->pins && !entry->data_bound && !entry->obj->group_users && !module_on_stack(entry->obj);
+}
+
+//Points the entry's stubs at the resident functions, or back at the reloader
+static void rebind_stubs(cache_entry_t *entry)
+{
+#if STUB_SUPPORTED
+	for (stub_t *stub = entry->stubs; stub; stub = stub->next)
+	{
+		size_t sym = entry->resident ? symindex_get(&entry->obj->index, stub->name) : SYMTAB_NONE;
+		stub_bind(stub, sym != SYMTAB_NONE ? entry->obj->symbols.addresses[sym] : NULL);
+	}
+#else
+	(void)entry;
+#endif
+}
+
+//Frees the module, leaving a shell in its slot so its handle stays valid
+static int evict_entry(cache_entry_t *entry)
+{
+	elf_rel_t *obj = entry->obj;
+	elf_rel_t *shell = calloc(1, sizeof(elf_rel_t));
+	if (!shell) return 0;
+
+	entry->resident = 0;
+	rebind_stubs(entry);
+	replace_module(obj, shell);
+	entry->obj = shell;
+
+	release_groups(obj);
+	elf_rel_destroy(obj);
+	cache_used -= entry->size;
+	++cache_evictions;
+	return 1;
+}
+
+//Evicts least recently used modules until size more bytes fit the budget
+//Pinned, running or otherwise referenced modules stay, which may leave the cache over budget
+static void cache_make_room(size_t size)
+{
+	while (cache_used + size > cache_budget)
+	{
+		cache_entry_t *victim = NULL;
+		for (size_t i = 0; i < cache_count; ++i)
+		{
+			cache_entry_t *entry = cache_entries[i];
+			if ((!victim || entry->last_use < victim->last_use) && entry_evictable(entry))
+				victim = entry;
+		}
+
+		if (!victim || !evict_entry(victim))
+			return;
+	}
+}
+
+static int reload_entry(cache_entry_t *entry)
+{
+	dl_io_t io;
+	if (dl_io_open_stdio(entry->path, &io))
+	{
+		error = "Could not open ELF file.";
+		return 0;
+	}
+
+	elf_rel_t *obj = load_module(&io, NULL, 1);
+	if (!obj) return 0;
+
+	elf_rel_t *shell = entry->obj;
+	replace_module(shell, obj);
+	free(shell);
+	commit_groups(obj);
+
+	entry->obj = obj;
+	entry->resident = 1;
+	entry->size = obj->stats.bytes_resident;
+	cache_used += entry->size;
+	++cache_misses;
+	rebind_stubs(entry);
+	return 1;
+}
+
+//Makes the entry's module resident, reloading it if it was evicted, and marks it as just used
+static int touch_entry(cache_entry_t *entry)
+{
+	if (entry->resident)
+		++cache_hits;
+	else if (!reload_entry(entry))
+		return 0;
+
+	entry->last_use = ++cache_clock;
+	return 1;
+}
+
+static elf_rel_t *open_cached(const char *path)
+{
+	for (size_t i = 0; i < cache_count; ++i)
+	{
+		cache_entry_t *entry = cache_entries[i];
+		if (strcmp(entry->path, path)) continue;
+
+		if (!touch_entry(entry)) return NULL;
+		++entry->refs;
+		return entry->obj;
+	}
+
+	if (cache_count == cache_cap)
+	{
+		size_t cap = cache_cap ? cache_cap * 2 : 8;
+		cache_entry_t **grown = realloc(cache_entries, cap * sizeof(cache_entry_t*));
+		if (!grown)
+		{
+			error = "Failed to allocate cache entry";
+			return NULL;
+		}
+		cache_entries = grown;
+		cache_cap = cap;
+	}
+
+	cache_entry_t *entry = calloc(1, sizeof(cache_entry_t));
+	char *copy = strdup(path);
+	elf_rel_t *obj = NULL;
+	if (!entry || !copy)
+	{
+		error = "Failed to allocate cache entry";
+		goto _open_cached_error;
+	}
+
+	dl_io_t io;
+	if (dl_io_open_stdio(path, &io))
+	{
+		error = "Could not open ELF file.";
+		goto _open_cached_error;
+	}
+
+	obj = load_module(&io, NULL, 1);
+	if (!obj)
+		goto _open_cached_error;
+
+	if (!publish_modules(&obj, 1))
+		goto _open_cached_error;
+
+	commit_groups(obj);
+
+	entry->path = copy;
+	entry->obj = obj;
+	entry->resident = 1;
+	entry->refs = 1;
+	entry->size = obj->stats.bytes_resident;
+	entry->last_use = ++cache_clock;
+	obj->cache = entry;
+
+	cache_entries[cache_count++] = entry;
+	cache_used += entry->size;
+	++cache_misses;
+	return obj;
+
+_open_cached_error:
+	if (obj) elf_rel_destroy(obj);
+	free(copy);
+	free(entry);
+	return NULL;
+}
+
+//Forgets the entry, the module left behind is closed like any other
+static void drop_entry(cache_entry_t *entry)
+{
+	for (size_t i = 0; i < cache_count; ++i)
+	{
+		if (cache_entries[i] != entry) continue;
+		cache_entries[i] = cache_entries[--cache_count];
+		break;
+	}
+
+	if (entry->resident) cache_used -= entry->size;
+	entry->obj->cache = NULL;
+
+#if STUB_SUPPORTED
+	while (entry->stubs)
+	{
+		stub_t *next = entry->stubs->next;
+		stub_destroy(entry->stubs);
+		entry->stubs = next;
+	}
+#endif
+
+	free(entry->path);
+	free(entry);
+}
+
+//Looks a symbol of a resident cached module up
+//Functions are handed out as stubs, which keep working across evictions
+static int cached_symbol(cache_entry_t *entry, const char *name, void **address)
+{
+	size_t sym = symindex_get(&entry->obj->index, name);
+	if (sym == SYMTAB_NONE) return 0;
+	*address = entry->obj->symbols.addresses[sym];
+
+#if STUB_SUPPORTED
+	if (ELF32_ST_TYPE(entry->obj->symbols.info[sym]) == STT_FUNC)
+	{
+		stub_t *stub = entry->stubs;
+		while (stub && strcmp(stub->name, name))
+			stub = stub->next;
+
+		if (!stub && (stub = stub_create(entry, name)))
+		{
+			stub_bind(stub, *address);
+			stub->next = entry->stubs;
+			entry->stubs = stub;
+		}
+
+		if (stub)
+		{
+			*address = stub->code;
+			return 1;
+		}
+	}
+#endif
+
+	//The address dies with an eviction, so the module must not be evicted from now on
+	entry->data_bound = 1;
+	return 1;
+}
+
+static void *stub_failed(void)
+{
+	return NULL;
+}
+
+void *stub_resolve(stub_t *stub)
+{
+	void *address = NULL;
+
+	dl_lock();
+	cache_entry_t *entry = stub->owner;
+	if (touch_entry(entry))
+	{
+		size_t sym = symindex_get(&entry->obj->index, stub->name);
+		address = sym != SYMTAB_NONE ? entry->obj->symbols.addresses[sym] : NULL;
+	}
+	dl_unlock();
+
+	//Nowhere to go on into, the call returns 0 and dlerror tells why
+	if (!address)
+	{
+		if (!error) error = "Symbol not found";
+		return (void*)(uintptr_t)stub_failed;
+	}
+
+	return address;
+}
+
+static int close_module(void *handle)
+{
+	elf_rel_t *obj = module_from_handle(handle);
+	if (!obj)
+	{
+		error = "Invalid handle";
+		return 1;
+	}
+
+	//Every dlopen of a cached path shares the entry, the last dlclose closes the module
+	cache_entry_t *entry = obj->cache;
+	if (entry)
+	{
+		if (--entry->refs) return 0;
+
+		int resident = entry->resident;
+		drop_entry(entry);
+		if (!resident)
+		{
+			retire_module(obj);
+			free(obj);
+			return 0;
+		}
+	}
+
+	//Code of its COMDAT groups stays while other modules run it, the last of them frees it
+	obj->closed = 1;
+	if (!obj->group_users)
+		unload_module(obj);
+
+	return 0;
+}
+
+int dlclose(void *handle)
+{
+	dl_lock();
+	int ret = close_module(handle);
+	dl_unlock();
+	return ret;
+}
+
+//Relocations read or applied, symbols gone over, and file bytes read, by one step of an
+//incremental load before the time is checked again
+#ifndef DL_STEP_RELOCATIONS
+#define DL_STEP_RELOCATIONS 64
+#endif
+#ifndef DL_STEP_SYMBOLS
+#define DL_STEP_SYMBOLS 256
+#endif
+#ifndef DL_STEP_BYTES
+#define DL_STEP_BYTES 8192
+#endif
+
+typedef enum {
+	LOAD_HEADERS,
+	LOAD_TABLES,
+	LOAD_TABLE_READS,
+	LOAD_SWAP,
+	LOAD_GROUPS,
+	LOAD_COLLECT,
+	LOAD_PREFLIGHT,
+	LOAD_ALLOC,
+	LOAD_SECTIONS,
+	LOAD_MERGE,
+	LOAD_PARSE,
+	LOAD_RELOCATE,
+	LOAD_PUBLISH,
+	LOAD_DONE,
+	LOAD_FAILED,
+} load_phase_t;
+
+struct dl_load {
+	load_phase_t phase;
+	//Owned by obj once the headers are read
+	dl_io_t io;
+	elf_rel_t *obj;
+	io_plan_t plan;
+	//Next symbol to swap, walk of the relocation graph and symbols checked so far
+	size_t next_sym;
+	collect_state_t collect;
+	preflight_t preflight;
+	//Sections read for merging, and the next one to merge
+	void **merge_src;
+	int next_merge;
+	parse_cursor_t parse;
+	//Next relocation to apply
+	rela_cursor_t next_rel;
+	//Group owners are referenced from the tables phase on, so they cannot go away between steps
+	int groups_held;
+	void *handle;
+};
+
+static uint64_t time_us(void)
+{
+#ifdef GEKKO
+	return ticks_to_microsecs(gettime());
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#endif
+}
+
+//Runs a bounded part of the current phase, moving to the next phase once it is done
+static int load_chunk(dl_load_t *load)
+{
+	elf_rel_t *obj = load->obj;
+
+	switch (load->phase)
+	{
+	case LOAD_HEADERS:
+		load->obj = open_headers(&load->io);
+		load->io.ops = NULL;
+		if (!load->obj) return 0;
+		break;
+
+	case LOAD_TABLES:
+		if (!elf_plan_tables(obj, &load->plan, &error)) return 0;
+		break;
+
+	case LOAD_TABLE_READS:
+		if (!io_plan_execute_some(&load->plan, &obj->elf, DL_STEP_BYTES))
+		{
+			error = "Failed to read symbol tables";
+			return 0;
+		}
+		if (!io_plan_done(&load->plan)) return 1;
+		io_plan_free(&load->plan);
+		break;
+
+	case LOAD_SWAP:
+	{
+		size_t count = obj->raw_sym_count - load->next_sym;
+		if (count > DL_STEP_SYMBOLS) count = DL_STEP_SYMBOLS;
+		elf_swap_syms(&obj->raw_syms[load->next_sym], count);
+		load->next_sym += count;
+		if (load->next_sym < obj->raw_sym_count) return 1;
+		break;
+	}
+
+	case LOAD_GROUPS:
+		if (!bind_groups(obj)) return 0;
+		hold_groups(obj);
+		load->groups_held = 1;
+		break;
+
+	case LOAD_COLLECT:
+		if (!load->collect.reached && !collect_init(obj, &load->collect, &error)) return 0;
+		if (!collect_some(obj, &load->collect, NULL, DL_STEP_RELOCATIONS, &error)) return 0;
+		if (!collect_done(obj, &load->collect)) return 1;
+		collect_finish(obj, &load->collect);
+		break;
+
+	case LOAD_PREFLIGHT:
+		preflight_some(obj, NULL, &load->preflight, DL_STEP_SYMBOLS);
+		if (load->preflight.next < obj->raw_sym_count) return 1;
+		if (!preflight_report(&load->preflight)) return 0;
+		break;
+
+	case LOAD_ALLOC:
+		if (!plan_section_loads(obj, &load->plan, &load->merge_src)) return 0;
+		break;
+
+	case LOAD_SECTIONS:
+		if (!io_plan_execute_some(&load->plan, &obj->elf, DL_STEP_BYTES))
+		{
+			error = "Failed to load sections";
+			return 0;
+		}
+		if (!io_plan_done(&load->plan)) return 1;
+		break;
+
+	case LOAD_MERGE:
+		//A section at a time, those read whole are not merged
+		while (load->merge_src && load->next_merge < obj->elf.header.e_shnum && !load->merge_src[load->next_merge])
+			++load->next_merge;
+		if (load->merge_src && load->next_merge < obj->elf.header.e_shnum)
+			return merge_loaded_section(obj, load->merge_src, load->next_merge++, 1);
+
+		merge_loaded_sections(obj, load->merge_src, 1);
+		load->merge_src = NULL;
+		io_plan_free(&load->plan);
+		break;
+
+	case LOAD_PARSE:
+		if (!parse_relocatable_from(obj, &load->parse, DL_STEP_SYMBOLS)) return 0;
+		if (load->parse.pass != PARSE_DONE) return 1;
+		break;
+
+	case LOAD_RELOCATE:
+		if (!apply_relocations_from(obj, NULL, &load->next_rel, DL_STEP_RELOCATIONS)) return 0;
+		if (load->next_rel.sect < obj->elf.header.e_shnum) return 1;
+		break;
+
+	case LOAD_PUBLISH:
+		sync_caches(obj);
+		finish_relocatable(obj);
+		if (!publish_modules(&obj, 1)) return 0;
+
+		register_groups(obj);
+		load->handle = obj->handle;
+		break;
+
+	default:
+		return 1;
+	}
+
+	++load->phase;
+	return 1;
+}
+
+//Frees whatever the load holds, call with the writer lock held
+static void load_abort(dl_load_t *load)
+{
+	if (load->merge_src) merge_loaded_sections(load->obj, load->merge_src, 0);
+	load->merge_src = NULL;
+	io_plan_free(&load->plan);
+
+	if (load->obj)
+	{
+		if (load->collect.reached) collect_free(load->obj, &load->collect);
+		if (load->groups_held) release_groups(load->obj);
+		elf_rel_destroy(load->obj);
+	}
+	else if (load->io.ops)
+		load->io.ops->close(load->io.ctx);
+
+	load->obj = NULL;
+	load->io.ops = NULL;
+	load->phase = LOAD_FAILED;
+}
+
+dl_load_t *dlopen_begin(const char *path, int mode)
+{
+	//Every relocation is applied by the steps before the load is done, see dlopen
+	(void)mode;
+
+	if (rt_refused())
+		return NULL;
+
+	dl_load_t *load = calloc(1, sizeof(dl_load_t));
+	if (!load)
+	{
+		error = "Failed to allocate load state";
+		return NULL;
+	}
+
+	if (dl_io_open_stdio(path, &load->io))
+	{
+		free(load);
+		error = "Could not open ELF file.";
+		return NULL;
+	}
+
+	io_plan_init(&load->plan, NULL);
+	load->phase = LOAD_HEADERS;
+
+	dl_lock();
+	++loads_pending;
+	dl_unlock();
+	return load;
+}
+
+int dlopen_step(dl_load_t *load, unsigned budget_us)
+{
+	uint64_t start = time_us();
+
+	//The lock is only held a chunk at a time, other threads go on between chunks
+	while (load->phase != LOAD_DONE && load->phase != LOAD_FAILED)
+	{
+		dl_lock();
+		if (!load_chunk(load))
+			load_abort(load);
+		dl_unlock();
+
+		if (time_us() - start >= budget_us)
+			break;
+	}
+
+	if (load->phase == LOAD_DONE) return DL_STEP_DONE;
+	return load->phase == LOAD_FAILED ? DL_STEP_ERROR : DL_STEP_MORE;
+}
+
+void *dlopen_finish(dl_load_t *load)
+{
+	dl_lock();
+	if (load->phase != LOAD_DONE && load->phase != LOAD_FAILED)
+	{
+		load_abort(load);
+		error = "Load cancelled";
+	}
+	--loads_pending;
+	dl_unlock();
+
+	void *handle = load->handle;
+	free(load);
+	return handle;
+}
+
+//A module image moved by dlcompact
+typedef struct {
+	elf_rel_t *obj;
+	uintptr_t old_base;
+	size_t size;
+	ptrdiff_t delta;
+} image_move_t;
+
+static void *moved_address(image_move_t *moves, size_t move_count, void *address)
+{
+	uintptr_t addr = (uintptr_t)address;
+	for (size_t i = 0; i < move_count; ++i)
+	{
+		//End inclusive, symbols may mark the end of a section
+		if (addr >= moves[i].old_base && addr <= moves[i].old_base + moves[i].size)
+			return (void*)(addr + moves[i].delta);
+	}
+
+	return address;
+}
+
+static int compare_images(const void *a, const void *b)
+{
+	uintptr_t ia = (uintptr_t)(*(elf_rel_t *const *)a)->image, ib = (uintptr_t)(*(elf_rel_t *const *)b)->image;
+	return ia < ib ? -1 : ia > ib;
+}
+
+//Modules with small data or counting stubs are pinned, the stubs encode absolute addresses
+//Relocations are re-applied from their records, so only modules loaded retaining them move
+static int module_movable(elf_rel_t *obj)
+{
+	return obj->image && obj->relocations.resolved && !obj->sda_tramp_count && !obj->counters && pool_owns(obj->image);
+}
+
+//Modules without records cannot follow a module they bound COMDAT groups to, so it stays in place
+//Batch peers need no check, a batch is opened under dl_lock with a single dlretainrelocs setting
+static int module_bound_unretained(elf_rel_t *obj)
+{
+	for (size_t i = 0; i < slot_end; ++i)
+	{
+		elf_rel_t *other = module_slots[i].obj;
+		if (!other || other == obj || other->relocations.resolved) continue;
+
+		for (size_t g = 0; g < other->group_owner_count; ++g)
+		{
+			if (other->group_owners[g] == obj)
+				return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void move_module(elf_rel_t *obj, image_move_t *move)
+{
+	for (int i = 0; i < obj->elf.header.e_shnum; ++i)
+	{
+		if (obj->sect_addrs[i] && !sda_owns(obj->sect_addrs[i]))
+			obj->sect_addrs[i] = (char*)obj->sect_addrs[i] + move->delta;
+	}
+}
+
+static int relink_module(elf_rel_t *obj, image_move_t *moves, size_t move_count, int moved)
+{
+	symtab_t *tab = &obj->symbols;
+	for (size_t i = 0; i < tab->count; ++i)
+	{
+		if (tab->sections[i] != SHN_ABS && tab->sections[i] != SHN_UNDEF)
+			tab->addresses[i] = moved_address(moves, move_count, tab->addresses[i]);
+	}
 
-	if (!compute_own_symbols(exec))
-		goto _dlinit_error;
+	//Only the resolved and type columns are scanned, a row is unpacked when it is re-applied
+	int changed = moved;
+	reltab_t *rels = &obj->relocations;
+	for (size_t i = 0; i < rels->count; ++i)
+	{
+		void *target = moved_address(moves, move_count, rels->resolved[i]);
+		if (target == rels->resolved[i] && !moved)
+			continue;
 
-	self = exec;
-	loaded_relocatables = hashset_create(hash_str, compare_str);
+		//Stubbed small data accesses cannot be rewritten in place
+		if ((rels->types[i] == R_PPC_SDAREL16 || rels->types[i] == R_PPC_EMB_SDA21) && obj->sda_tramp_count)
+			continue;
+
+		rel_symbol_t rel;
+		rels->resolved[i] = target;
+		reltab_load(rels, i, &rel);
+		changed = 1;
+		if (!apply_relocation(obj, &rel, target))
+			return 0;
+	}
+
+	if (changed) sync_caches(obj);
+	return 1;
+}
+
+static int compact_modules(dl_moved_cb_t moved_cb, void *user)
+{
+	//Pending loads already resolved addresses in other modules
+	if (loads_pending)
+	{
+		error = "Incremental load in progress";
+		return 1;
+	}
+
+	if (!slot_end) return 0;
+
+	elf_rel_t *order[DL_MAX_MODULES];
+	image_move_t *moves = malloc(slot_end * sizeof(image_move_t));
+	if (!moves)
+	{
+		error = "Failed to allocate compaction state";
+		return 1;
+	}
+
+	size_t order_count = 0;
+	for (size_t i = 0; i < slot_end; ++i)
+	{
+		elf_rel_t *obj = module_slots[i].obj;
+		if (obj && module_movable(obj) && !module_bound_unretained(obj))
+			order[order_count++] = obj;
+	}
+
+	//Lowest first, every image slides down into the hole the previous one left
+	qsort(order, order_count, sizeof(elf_rel_t*), compare_images);
+
+	size_t move_count = 0;
+	for (size_t i = 0; i < order_count; ++i)
+	{
+		elf_rel_t *obj = order[i];
+		void *image = pool_slide(obj->image, obj->image_align);
+		if (image == obj->image) continue;
+
+		image_move_t *move = &moves[move_count++];
+		move->obj = obj;
+		move->old_base = (uintptr_t)obj->image;
+		move->size = obj->image_size;
+		move->delta = (char*)image - (char*)obj->image;
+
+		obj->image = image;
+		move_module(obj, move);
+	}
+
+	//Re-apply every relocation whose place or target moved, in all modules retaining records
+	int ok = 1;
+	for (size_t i = 0; ok && move_count && i < slot_end; ++i)
+	{
+		elf_rel_t *obj = module_slots[i].obj;
+		if (!obj || (obj->cache && !obj->cache->resident)) continue;
+
+		int moved = 0;
+		for (size_t m = 0; m < move_count; ++m)
+			moved |= moves[m].obj == obj;
+
+		ok = relink_module(obj, moves, move_count, moved);
+	}
+
+	for (size_t i = 0; i < registered_count; ++i)
+		*registered_ptrs[i] = moved_address(moves, move_count, *registered_ptrs[i]);
+
+	//Stubs handed out for cached modules follow their functions
+	for (size_t m = 0; m < move_count; ++m)
+	{
+		if (moves[m].obj->cache) rebind_stubs(moves[m].obj->cache);
+	}
+
+	for (size_t m = 0; moved_cb && m < move_count; ++m)
+		moved_cb(moves[m].obj->handle, moves[m].delta, user);
+
+	free(moves);
+	return !ok;
+}
+
+static int register_ptr(void **slot)
+{
+	if (registered_count == registered_cap)
+	{
+		size_t cap = registered_cap ? registered_cap * 2 : 16;
+		void ***grown = realloc(registered_ptrs, cap * sizeof(void**));
+		if (!grown)
+		{
+			error = "Failed to allocate pointer registry";
+			return 1;
+		}
+
+		registered_ptrs = grown;
+		registered_cap = cap;
+	}
+
+	registered_ptrs[registered_count++] = slot;
 	return 0;
+}
 
-_dlinit_error:
-	elf_exec_destroy(exec);
+static int unregister_ptr(void **slot)
+{
+	for (size_t i = 0; i < registered_count; ++i)
+	{
+		if (registered_ptrs[i] != slot) continue;
+
+		registered_ptrs[i] = registered_ptrs[--registered_count];
+		return 0;
+	}
+
+	error = "Pointer not registered";
 	return 1;
 }
 
-void *dlopen(const char *path, int mode)
+int dlcompact(dl_moved_cb_t moved, void *user)
 {
-	(void)mode; //TODO: Not
+	error = NULL;
 
-	elf_rel_t *obj = elf_rel_create(path, &error);
-	if (!obj) return NULL;
-	
-	if (!elf_rel_valid(obj))
-		goto _dlopen_error;
+	dl_lock();
+	int ret = compact_modules(moved, user);
+	dl_unlock();
+	return ret;
+}
 
-	if (!elf_load_sects(&obj->elf))
-		goto _dlopen_error;
+int dlregisterptr(void **slot)
+{
+	dl_lock();
+	int ret = register_ptr(slot);
+	dl_unlock();
+	return ret;
+}
 
-	if (!elf_load_shstrings(&obj->elf))
-		goto _dlopen_error;
+int dlunregisterptr(void **slot)
+{
+	dl_lock();
+	int ret = unregister_ptr(slot);
+	dl_unlock();
+	return ret;
+}
 
-	if (!load_needed_sections(obj))
-		goto _dlopen_error;
+int dlpoolinit(void *mem, size_t size)
+{
+	dl_lock();
+	int ret = pool_init(mem, size);
+	dl_unlock();
 
-	if (!elf_find_local_symbols(obj))
-		goto _dlopen_error;
+	if (ret) error = "Module pool in use or region too small";
+	return ret;
+}
 
-	if (!elf_find_relocations(obj))
-		goto _dlopen_error;
-	
-	//Apply relocations
-	if (!apply_relocations(obj))
-		goto _dlopen_error;
+size_t dlrtsize(const dlrtlimits_t *limits)
+{
+	if (limits->modules <= 0) return 0;
 
-	hashset_add(loaded_relocatables, obj);
+	return limits->modules * ((rt_region_size(limits) + REGION_ALIGN - 1) & ~(size_t)(REGION_ALIGN - 1));
+}
 
-	return obj;
+static int init_rt(void *mem, size_t size, const dlrtlimits_t *limits)
+{
+	if (!self && !host_table)
+	{
+		error = "wii-dlfcn not initialized";
+		return 1;
+	}
 
-_dlopen_error:
-	elf_rel_destroy(obj);
-	return NULL;
+	for (size_t slot = 0; slot < slot_end; ++slot)
+	{
+		if (module_slots[slot].obj)
+		{
+			error = "Modules already loaded";
+			return 1;
+		}
+	}
+
+	if (limits->modules <= 0 || limits->modules > DL_MAX_MODULES || cache_budget || loads_pending)
+	{
+		error = "Invalid real-time module count, or the cache or an incremental load is active";
+		return 1;
+	}
+
+	if (((uintptr_t)mem & (REGION_ALIGN - 1)) || size < dlrtsize(limits))
+	{
+		error = "Real-time memory misaligned or smaller than dlrtsize";
+		return 1;
+	}
+
+	size_t region_size = dlrtsize(limits) / limits->modules;
+	for (int i = 0; i < limits->modules; ++i)
+		region_init(&rt_regions[i], (unsigned char*)mem + i * region_size, region_size);
+
+	rt_limits = *limits;
+	rt_modules = limits->modules;
+	return 0;
 }
 
-int dlclose(void *handle)
+int dlinit_rt(void *mem, size_t size, const dlrtlimits_t *limits)
+{
+	error = NULL;
+
+	dl_lock();
+	int ret = init_rt(mem, size, limits);
+	dl_unlock();
+	return ret;
+}
+
+void dlpoolstats(dlpoolstats_t *stats)
+{
+	dl_lock();
+	pool_stats(stats);
+	dl_unlock();
+}
+
+void dlsectionpolicy(dl_section_policy_t policy)
+{
+	dl_lock();
+	section_policy = policy;
+	dl_unlock();
+}
+
+int dllayoutprofile(const char *path)
+{
+	hashtable_t *functions = NULL;
+	char *names = NULL;
+
+	if (path)
+	{
+		FILE *file = fopen(path, "rb");
+		long len = -1;
+		if (file && !fseek(file, 0, SEEK_END) && (len = ftell(file)) >= 0 && !fseek(file, 0, SEEK_SET))
+		{
+			names = malloc(len + 1);
+			if (names && fread(names, 1, len, file) != (size_t)len)
+				len = -1;
+		}
+		if (file) fclose(file);
+
+		functions = hashtable_create(hash_str, compare_str);
+		if (len < 0 || !names || !functions)
+		{
+			error = "Could not read layout profile";
+			goto _dllayoutprofile_error;
+		}
+		names[len] = '\0';
+
+		//First word of every line, blank lines and # comments skipped
+		for (char *line = names; line && *line; )
+		{
+			char *next = strchr(line, '\n');
+			if (next) *next++ = '\0';
+
+			line[strcspn(line, " \t\r")] = '\0';
+			if (*line && *line != '#' && !hashtable_get(functions, line))
+				hashtable_add(functions, line, line);
+
+			line = next;
+		}
+	}
+
+	dl_lock();
+	if (hot_functions) hashtable_destroy(hot_functions);
+	free(hot_names);
+	hot_functions = functions;
+	hot_names = names;
+	dl_unlock();
+	return 0;
+
+_dllayoutprofile_error:
+	if (functions) hashtable_destroy(functions);
+	free(names);
+	return 1;
+}
+
+void dlcountcalls(int enable)
+{
+	dl_lock();
+	count_calls = enable;
+	dl_unlock();
+}
+
+void dlretainrelocs(int enable)
+{
+	dl_lock();
+	retain_relocs = enable;
+	dl_unlock();
+}
+
+//Call count of a function, taken once since counts keep moving while the module runs
+typedef struct {
+	const char *name;
+	uint32_t calls;
+} call_count_t;
+
+static int compare_calls(const void *a, const void *b)
+{
+	uint32_t ca = ((const call_count_t*)a)->calls, cb = ((const call_count_t*)b)->calls;
+	return ca < cb ? 1 : ca > cb ? -1 : 0;
+}
+
+int dlprofilewrite(void *handle, const char *path)
+{
+	int slot = dl_read_enter();
+	elf_rel_t *obj = module_from_handle(handle);
+	if (!obj || !obj->counted_count)
+	{
+		dl_read_exit(slot);
+		error = obj ? "Calls of the module are not counted" : "Invalid handle";
+		return 1;
+	}
+
+	size_t count = obj->counted_count;
+	call_count_t *calls = malloc(count * sizeof(call_count_t));
+	FILE *file = calls ? fopen(path, "w") : NULL;
+	if (!file)
+	{
+		dl_read_exit(slot);
+		free(calls);
+		error = "Could not write profile";
+		return 1;
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		calls[i].name = obj->counted[i].name;
+		calls[i].calls = counter_stub_count(obj->counted[i].stub);
+	}
+	qsort(calls, count, sizeof(call_count_t), compare_calls);
+
+	int ok = 1;
+	for (size_t i = 0; ok && i < count && calls[i].calls; ++i)
+		ok = fprintf(file, "%s %u\n", calls[i].name, (unsigned)calls[i].calls) > 0;
+
+	dl_read_exit(slot);
+	free(calls);
+	if (fclose(file) || !ok)
+	{
+		error = "Could not write profile";
+		return 1;
+	}
+
+	return 0;
+}
+
+int dlcachebudget(size_t bytes)
+{
+	if (bytes && rt_refused())
+		return 1;
+
+	dl_lock();
+	cache_budget = bytes;
+	if (cache_budget) cache_make_room(0);
+	dl_unlock();
+	return 0;
+}
+
+static int pin_module(void *handle, int delta)
+{
+	elf_rel_t *obj = module_from_handle(handle);
+	if (!obj)
+	{
+		error = "Invalid handle";
+		return 1;
+	}
+
+	//Modules outside the cache are never evicted
+	cache_entry_t *entry = obj->cache;
+	if (!entry) return 0;
+
+	if (delta < 0 && !entry->pins)
+	{
+		error = "Module is not pinned";
+		return 1;
+	}
+
+	//A pinned module is resident until unpinned
+	if (delta > 0 && !touch_entry(entry))
+		return 1;
+
+	entry->pins += delta;
+	return 0;
+}
+
+int dlpin(void *handle)
+{
+	dl_lock();
+	int ret = pin_module(handle, 1);
+	dl_unlock();
+	return ret;
+}
+
+int dlunpin(void *handle)
 {
-	if (!hashset_contains(loaded_relocatables, handle))
+	dl_lock();
+	int ret = pin_module(handle, -1);
+	dl_unlock();
+	return ret;
+}
+
+void dlcachestats(dlcachestats_t *stats)
+{
+	dl_lock();
+	stats->budget = cache_budget;
+	stats->used = cache_used;
+	stats->modules = cache_count;
+	stats->resident = 0;
+	for (size_t i = 0; i < cache_count; ++i)
+		stats->resident += cache_entries[i]->resident;
+	stats->hits = cache_hits;
+	stats->misses = cache_misses;
+	stats->evictions = cache_evictions;
+	dl_unlock();
+}
+
+int dlstats(void *handle, dlstats_t *stats)
+{
+	int slot = dl_read_enter();
+	elf_rel_t *obj = module_from_handle(handle);
+
+	if (!obj)
 	{
+		dl_read_exit(slot);
 		error = "Invalid handle";
 		return 1;
 	}
 
-	elf_rel_destroy((elf_rel_t*)handle);
+	*stats = obj->stats;
+	dl_read_exit(slot);
 	return 0;
 }
 
@@ -726,28 +2974,151 @@ char *dlerror(void)
 	return ret;
 }
 
+#define LOOKUP_LOCKED -1
+
+//Starts a symbol lookup, lock free unless the module is cached and the lookup may have to reload it
+static elf_rel_t *lookup_begin(void *ptr, int *slot)
+{
+	*slot = dl_read_enter();
+	elf_rel_t *obj = module_from_handle(ptr);
+	if (obj && !obj->cache) return obj;
+
+	if (obj)
+	{
+		dl_read_exit(*slot);
+		*slot = LOOKUP_LOCKED;
+		dl_lock();
+
+		obj = module_from_handle(ptr);
+		if (obj && obj->cache)
+		{
+			cache_entry_t *entry = obj->cache;
+			return touch_entry(entry) ? entry->obj : NULL;
+		}
+	}
+
+	if (!obj) error = "Invalid handle";
+	return obj;
+}
+
+static void lookup_end(int slot)
+{
+	if (slot == LOOKUP_LOCKED)
+		dl_unlock();
+	else
+		dl_read_exit(slot);
+}
+
+static int module_symbol(elf_rel_t *obj, const char *name, void **address)
+{
+	if (obj->cache)
+		return cached_symbol(obj->cache, name, address);
+
+	size_t sym = symindex_get(&obj->index, name);
+	if (sym == SYMTAB_NONE) return 0;
+
+	//Calls through the pointer are counted too
+	void *found = obj->symbols.addresses[sym];
+	uint32_t *counter = ELF32_ST_TYPE(obj->symbols.info[sym]) == STT_FUNC ? counter_stub_of(obj, found) : NULL;
+	*address = counter ? (void*)counter : found;
+	return 1;
+}
+
 void *dlsym(void *ptr, const char *name)
 {
-	elf_rel_t *handle = (elf_rel_t*)ptr;
-	if (!hashset_contains(loaded_relocatables, handle))
+	//Lock free outside the cache, a module stays mapped while any reader may still see it
+	int slot;
+	elf_rel_t *handle = lookup_begin(ptr, &slot);
+
+	if (!handle)
 	{
-		error = "Invalid handle";
+		lookup_end(slot);
 		return NULL;
 	}
 
-	size_t sym_count = ivector_get_count(handle->symbols);
-	for (size_t i = 0; i < sym_count; ++i)
+	void *address;
+	if (module_symbol(handle, name, &address))
 	{
-		def_symbol_t *sym = (def_symbol_t*)ivector_get(handle->symbols, i);
-
-		if (!strcmp(sym->name, name))
-		{
-			if (!sym->address) printf("NULL sym\n");
-			return sym->address;
-		}
+		lookup_end(slot);
+		return address;
 	}
 
-	printf("Symbol '%s' not found\n", name);
+	lookup_end(slot);
 	error = "Symbol not found";
 	return NULL;
 }
+
+//Missing symbols of a bulk lookup, reported together once the lookup is done
+typedef struct {
+	int count;
+	size_t len;
+	char message[256];
+} missing_syms_t;
+
+static void bind_symbol(elf_rel_t *handle, const char *name, void **slot, missing_syms_t *missing)
+{
+	if (module_symbol(handle, name, slot)) return;
+	*slot = NULL;
+
+	//List as many names as fit, the total is appended at the end
+	size_t room = sizeof(missing->message) - missing->len;
+	int written = snprintf(&missing->message[missing->len], room, "%s'%s'", missing->count ? ", " : "Symbols not found: ", name);
+	if (written > 0 && (size_t)written < room)
+		missing->len += written;
+	else
+		missing->message[missing->len] = '\0';
+
+	++missing->count;
+}
+
+static int report_missing(missing_syms_t *missing)
+{
+	static DL_THREAD_LOCAL char message[sizeof(missing->message) + 32];
+	if (!missing->count)
+		return 0;
+
+	snprintf(message, sizeof(message), "%s (%d missing)", missing->message, missing->count);
+	error = message;
+	return 1;
+}
+
+int dlsym_many(void *ptr, const char **names, int count, void **out)
+{
+	missing_syms_t missing = { 0 };
+
+	//Validated once for the whole batch
+	int slot;
+	elf_rel_t *handle = lookup_begin(ptr, &slot);
+
+	if (!handle)
+	{
+		lookup_end(slot);
+		return 1;
+	}
+
+	for (int i = 0; i < count; ++i)
+		bind_symbol(handle, names[i], &out[i], &missing);
+
+	lookup_end(slot);
+	return report_missing(&missing);
+}
+
+int dlbind(void *ptr, const dlbind_entry_t *table)
+{
+	missing_syms_t missing = { 0 };
+
+	int slot;
+	elf_rel_t *handle = lookup_begin(ptr, &slot);
+
+	if (!handle)
+	{
+		lookup_end(slot);
+		return 1;
+	}
+
+	for (const dlbind_entry_t *entry = table; entry->name; ++entry)
+		bind_symbol(handle, entry->name, entry->slot, &missing);
+
+	lookup_end(slot);
+	return report_missing(&missing);
+}
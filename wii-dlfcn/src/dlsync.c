@@ -0,0 +1,94 @@
+#include "dlsync.h"
+
+#ifdef GEKKO
+#include <unistd.h>
+#include <ogc/mutex.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+//Readers register on the counter of the current epoch, writers flip the epoch and
+//wait for the counter of the previous one to drain
+static volatile int epoch = 0;
+static volatile unsigned readers[2] = { 0, 0 };
+
+#ifdef GEKKO
+static mutex_t writer_lock;
+static int writer_lock_ready = 0;
+#else
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+void dl_sync_init(void)
+{
+#ifdef GEKKO
+	if (writer_lock_ready) return;
+	LWP_MutexInit(&writer_lock, false);
+	writer_lock_ready = 1;
+#endif
+}
+
+void dl_lock(void)
+{
+#ifdef GEKKO
+	LWP_MutexLock(writer_lock);
+#else
+	pthread_mutex_lock(&writer_lock);
+#endif
+}
+
+void dl_unlock(void)
+{
+#ifdef GEKKO
+	LWP_MutexUnlock(writer_lock);
+#else
+	pthread_mutex_unlock(&writer_lock);
+#endif
+}
+
+int dl_read_enter(void)
+{
+	for (;;)
+	{
+		int slot = __atomic_load_n(&epoch, __ATOMIC_SEQ_CST);
+		__atomic_add_fetch(&readers[slot], 1, __ATOMIC_SEQ_CST);
+
+		//Registered on the epoch still current, any snapshot read from here on is covered
+		if (__atomic_load_n(&epoch, __ATOMIC_SEQ_CST) == slot)
+			return slot;
+
+		__atomic_sub_fetch(&readers[slot], 1, __ATOMIC_SEQ_CST);
+	}
+}
+
+void dl_read_exit(int slot)
+{
+	__atomic_sub_fetch(&readers[slot], 1, __ATOMIC_RELEASE);
+}
+
+static void wait_readers(int slot)
+{
+	while (__atomic_load_n(&readers[slot], __ATOMIC_ACQUIRE))
+	{
+		//A reader may have lower priority than the writer, so block instead of
+		//yielding, LWP_YieldThread only hands over to threads of equal priority
+#ifdef GEKKO
+		usleep(50);
+#else
+		sched_yield();
+#endif
+	}
+}
+
+void dl_synchronize(void)
+{
+	//Two flips, readers registered on the newer counter before the first flip may
+	//predate the snapshot being replaced too
+	for (int i = 0; i < 2; ++i)
+	{
+		int old = __atomic_load_n(&epoch, __ATOMIC_RELAXED);
+		__atomic_store_n(&epoch, !old, __ATOMIC_SEQ_CST);
+		wait_readers(old);
+	}
+}
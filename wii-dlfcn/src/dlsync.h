@@ -0,0 +1,24 @@
+#ifndef DLSYNC_H_
+#define DLSYNC_H_
+
+//Per-thread storage for loader state such as the last error
+#ifndef DL_THREAD_LOCAL
+#define DL_THREAD_LOCAL _Thread_local
+#endif
+
+//Prepares the writer lock, must run before a second thread uses the loader
+void dl_sync_init(void);
+
+//Writer lock, serializes everything that loads, unloads or publishes modules
+void dl_lock(void);
+void dl_unlock(void);
+
+//Read-side critical section, snapshots read between enter and exit stay valid until exit
+//Returns the slot to hand back to dl_read_exit
+int dl_read_enter(void);
+void dl_read_exit(int slot);
+
+//Waits until every reader that may still see a replaced snapshot has left, call with the lock held
+void dl_synchronize(void);
+
+#endif
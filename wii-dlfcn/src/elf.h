@@ -115,6 +115,14 @@
 #define SHT_SHLIB 10
 /* Dynamic symbol table */
 #define SHT_DYNSYM 11
+/* Array of constructors */
+#define SHT_INIT_ARRAY 14
+/* Array of destructors */
+#define SHT_FINI_ARRAY 15
+/* Array of pre-constructors */
+#define SHT_PREINIT_ARRAY 16
+/* Section group */
+#define SHT_GROUP 17
 /* Processor specific */
 #define SHT_LOPROC 0x70000000
 /* Processor specific */
@@ -131,9 +139,19 @@
 #define SHF_ALLOC 0x2
 /* Executable */
 #define SHF_EXECINSTR 0x4
+/* Elements may be merged with identical ones */
+#define SHF_MERGE 0x10
+/* Elements are NUL-terminated strings */
+#define SHF_STRINGS 0x20
+/* Member of a section group */
+#define SHF_GROUP 0x200
 /* Processor specific */
 #define SHF_MASKPROC 0xf0000000
 
+/*=== Section group flags ===*/
+/* Only one copy of the group is kept across the link */
+#define GRP_COMDAT 0x1
+
 /*=== Symbol info bit manipulations ===*/
 /* Symbol binding */
 #define ELF32_ST_BIND(i) ((i)>>4)
@@ -276,6 +294,10 @@
 /* word30 = (S + A - P) >> 2 */
 #define R_PPC_ADDR30 37
 
+/*=== PowerPC EABI specific relocation types ===*/
+/* low21 = S + A - (_SDA_BASE_ | _SDA2_BASE_ | 0), base register in rA */
+#define R_PPC_EMB_SDA21 109
+
 typedef uint32_t Elf32_Addr;
 typedef uint16_t Elf32_Half;
 typedef uint32_t Elf32_Off;
@@ -0,0 +1,662 @@
+#include "elfparse.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "elf.h"
+#include "elfswap.h"
+#include "symhash.h"
+
+static int elf_valid_compat(Elf32_Ehdr *elf, char **error)
+{
+	//Check ELF magic
+	if (elf->e_ident[EI_MAG0] != ELFMAG0 ||
+		elf->e_ident[EI_MAG1] != ELFMAG1 ||
+		elf->e_ident[EI_MAG2] != ELFMAG2 ||
+		elf->e_ident[EI_MAG3] != ELFMAG3)
+	{
+		*error = "Invalid ELF magic";
+		return 0;
+	}
+
+	//Require 32-bit, Big Endian, ELF version values
+	if (elf->e_ident[EI_CLASS] != ELFCLASS32 ||
+		elf->e_ident[EI_DATA] != ELFDATA2MSB || 
+		elf->e_ident[EI_VERSION] != EV_CURRENT)
+	{
+		*error = "Invalid IDENT values";
+		return 0;
+	}
+
+	//Require PPC
+	if (elf->e_machine != EM_PPC)
+	{
+		*error = "Invalid target machine";
+		return 0;
+	}
+
+	//Require current ELF version
+	if (elf->e_version != EV_CURRENT)
+	{
+		*error = "Invalid ELF version";
+		return 0;
+	}
+
+	return 1;
+}
+
+int elf_rel_valid(elf_rel_t *obj, char **error)
+{
+	if (!elf_valid_compat(&obj->elf.header, error))
+		return 0;
+	
+	//Require object file
+	if (obj->elf.header.e_type != ET_REL)
+	{
+		*error = "Unsupported ELF type, must be ET_REL (object file)";
+		return 0;
+	}
+
+	return 1;
+}
+
+int elf_exec_valid(elf_exec_t *exec, char **error)
+{
+	if (!elf_valid_compat(&exec->elf.header, error))
+		return 0;
+	
+	//Require object file
+	if (exec->elf.header.e_type != ET_EXEC)
+	{
+		*error = "Unsupported ELF type, must be ET_EXEC (executable file)";
+		return 0;
+	}
+
+	return 1;
+}
+
+int elf_load_sects(elf_file_t *elf, char **error)
+{
+	int count = elf->header.e_shnum;
+	size_t len = sizeof(Elf32_Shdr) * count;
+
+	elf->sects = elf_file_fetch(elf, elf->header.e_shoff, len);
+	if (!elf->sects)
+	{
+		*error = "Failed to load sections";
+		return 0;
+	}
+
+	elf_swap_shdrs(elf->sects, count);
+
+	return 1;
+}
+
+int elf_load_shstrings(elf_file_t *elf, char **error)
+{
+	if (elf->header.e_shstrndx == SHN_UNDEF)
+		return 1;
+
+	//section header strings section
+	Elf32_Shdr *sect = &elf->sects[elf->header.e_shstrndx];
+	Elf32_Off location = sect->sh_offset;
+
+	elf->sh_strings = elf_file_fetch(elf, location, sect->sh_size);
+	if (!elf->sh_strings)
+	{
+		*error = "Failed to load sh_strings";
+		return 0;
+	}
+
+	return 1;
+}
+
+//Where the name of a symbol is, section symbols are named after their section
+static uint32_t symbol_name_ref(elf_file_t *elf, Elf32_Sym *symbol)
+{
+	if (ELF32_ST_TYPE(symbol->st_info) == STT_SECTION)
+		return SYMTAB_SECT_NAME | elf->sects[symbol->st_shndx].sh_name;
+	return symbol->st_name;
+}
+
+//Records the symbols worth keeping as rows of tab, which has room for sym_count
+//Appends the symbols that can be looked up to tab
+static void save_symbols(elf_file_t *elf, Elf32_Sym *symbols, size_t sym_count, symtab_t *tab)
+{
+	size_t count = tab->count;
+	for (size_t i = 0; i < sym_count; ++i)
+	{
+		Elf32_Sym *symbol = &symbols[i];
+		int type = ELF32_ST_TYPE(symbol->st_info);
+
+		//Skip unneeded symbols
+		if (type == STT_NOTYPE || type == STT_FILE) continue;
+
+		//Names stay where they were read, the strings outlive the table
+		tab->names[count] = symbol_name_ref(elf, symbol);
+		tab->hashes[count] = sym_hash(symtab_name(tab, count), 0);
+		tab->info[count] = symbol->st_info;
+		tab->sections[count] = symbol->st_shndx;
+		tab->values[count] = symbol->st_value;
+		tab->addresses[count] = NULL;
+		++count;
+	}
+
+	tab->count = count;
+}
+
+int elf_find_defined_symbols(elf_exec_t *exec, char **error)
+{
+	//Executables carry a single symbol table, skipping the NULL section
+	Elf32_Shdr *sym_sect = NULL;
+	for (int i = 1; i < exec->elf.header.e_shnum && !sym_sect; ++i)
+	{
+		if (exec->elf.sects[i].sh_type == SHT_SYMTAB)
+			sym_sect = &exec->elf.sects[i];
+	}
+
+	if (!sym_sect) return 1;
+
+	int sym_count = sym_sect->sh_size / sizeof(Elf32_Sym);
+
+	//Sanity check entsize
+	if (sym_sect->sh_entsize != sizeof(Elf32_Sym) || sym_sect->sh_link >= exec->elf.header.e_shnum || sym_count < 1)
+	{
+		*error = "Invalid entsize or link for symtab";
+		return 0;
+	}
+
+	Elf32_Shdr *symstr_sect = &exec->elf.sects[sym_sect->sh_link];
+
+	//Read data
+	Elf32_Sym *symbols = elf_file_fetch(&exec->elf, sym_sect->sh_offset, sym_sect->sh_size);
+	exec->strs = elf_file_fetch(&exec->elf, symstr_sect->sh_offset, symstr_sect->sh_size);
+	int ok = exec->strs && symtab_init(&exec->symbols, NULL, sym_count - 1, exec->strs, exec->elf.sh_strings);
+
+	if (!symbols || !ok)
+	{
+		*error = "Failed to read symbols or symbol strings";
+		if (symbols) elf_file_release(&exec->elf, symbols);
+		return 0;
+	}
+
+	elf_swap_syms(symbols, sym_count);
+
+	//Interpret data (skipping NULL symbol)
+	save_symbols(&exec->elf, &symbols[1], sym_count - 1, &exec->symbols);
+
+	//Cleanup
+	elf_file_release(&exec->elf, symbols);
+	return 1;
+}
+
+int elf_rela_wanted(elf_rel_t *obj, int idx)
+{
+	//SHT_REL is not used in powerpc-eabi-none, relocations of unloaded sections (debug info, skipped or collected) are never read
+	Elf32_Shdr *sect = &obj->elf.sects[idx];
+	return sect->sh_type == SHT_RELA && sect->sh_info < obj->elf.header.e_shnum && obj->wanted[sect->sh_info] == SECT_LOADED;
+}
+
+size_t elf_count_relocations(elf_rel_t *obj)
+{
+	size_t total = 0;
+	for (int i = 1; i < obj->elf.header.e_shnum; ++i)
+	{
+		if (elf_rela_wanted(obj, i)) total += obj->elf.sects[i].sh_size / sizeof(Elf32_Rela);
+	}
+
+	return total;
+}
+
+int elf_read_relas(elf_rel_t *obj, int idx, size_t first, Elf32_Rela *relas, size_t count, char **error)
+{
+	Elf32_Shdr *rela_sect = &obj->elf.sects[idx];
+
+	//Sanity check entsize
+	if (rela_sect->sh_entsize != sizeof(Elf32_Rela))
+	{
+		*error = "Invalid entsize for rela";
+		return 0;
+	}
+
+	//Always copied, even from a mapping, the entries are swapped in place
+	if (!elf_file_read(&obj->elf, rela_sect->sh_offset + first * sizeof(Elf32_Rela), relas, count * sizeof(Elf32_Rela)))
+	{
+		*error = "Failed to read relocations";
+		return 0;
+	}
+
+	elf_swap_relas(relas, count);
+	return 1;
+}
+
+int elf_parse_relocation(elf_rel_t *obj, int target_sect_idx, Elf32_Rela *rela, rel_symbol_t *final, char **error)
+{
+	//Find symbol name
+	size_t sym_idx = ELF32_R_SYM(rela->r_info);
+	if (sym_idx >= obj->raw_sym_count)
+	{
+		*error = "Relocation symbol index out of range";
+		return 0;
+	}
+	Elf32_Sym *symbol = &obj->raw_syms[sym_idx];
+
+	//Copy data, the name stays where it was read
+	final->name_ref = symbol_name_ref(&obj->elf, symbol);
+	final->name = (char*)symtab_string(obj->raw_strs, obj->elf.sh_strings, final->name_ref);
+	final->section = target_sect_idx;
+	final->offset = rela->r_offset;
+	final->rel_type = ELF32_R_TYPE(rela->r_info);
+	final->addend = rela->r_addend;
+	final->resolved = NULL;
+	return 1;
+}
+
+int elf_find_relocations(elf_rel_t *obj, char **error)
+{
+	if (!reltab_init(&obj->relocations, obj->elf.region, elf_count_relocations(obj), obj->raw_strs, obj->elf.sh_strings))
+	{
+		*error = "Failed to allocate relocation records";
+		return 0;
+	}
+
+	//Skip NULL section
+	for (int i = 1; i < obj->elf.header.e_shnum; ++i)
+	{
+		if (!elf_rela_wanted(obj, i)) continue;
+
+		Elf32_Shdr *rela_sect = &obj->elf.sects[i];
+		size_t rela_count = rela_sect->sh_size / sizeof(Elf32_Rela);
+		Elf32_Rela relas[ELF_RELA_CHUNK];
+
+		for (size_t first = 0; first < rela_count; first += ELF_RELA_CHUNK)
+		{
+			size_t count = rela_count - first < ELF_RELA_CHUNK ? rela_count - first : ELF_RELA_CHUNK;
+			if (!elf_read_relas(obj, i, first, relas, count, error))
+				return 0;
+
+			//Interpret data
+			for (size_t r = 0; r < count; ++r)
+			{
+				rel_symbol_t rel;
+				if (!elf_parse_relocation(obj, rela_sect->sh_info, &relas[r], &rel, error))
+					return 0;
+				reltab_store(&obj->relocations, &rel);
+			}
+		}
+	}
+
+	return 1;
+}
+
+static Elf32_Shdr *find_symtab(elf_rel_t *obj)
+{
+	//Relocatables carry a single symbol table
+	for (int i = 1; i < obj->elf.header.e_shnum; ++i)
+	{
+		if (obj->elf.sects[i].sh_type == SHT_SYMTAB)
+			return &obj->elf.sects[i];
+	}
+
+	return NULL;
+}
+
+//Maps the range when the file is mapped, otherwise allocates for it and queues the read
+void *plan_table(elf_file_t *elf, io_plan_t *plan, Elf32_Off offset, size_t size)
+{
+	if (elf->map)
+		return elf_file_fetch(elf, offset, size);
+
+	void *buff = region_alloc(elf->region, size);
+	if (buff && !io_plan_add(plan, offset, size, buff))
+	{
+		region_free(elf->region, buff);
+		return NULL;
+	}
+
+	return buff;
+}
+
+int elf_plan_tables(elf_rel_t *obj, io_plan_t *plan, char **error)
+{
+	Elf32_Shdr *sym_sect = find_symtab(obj);
+	if (!sym_sect)
+	{
+		*error = "No symbol table";
+		return 0;
+	}
+
+	//Sanity check entsize
+	if (sym_sect->sh_entsize != sizeof(Elf32_Sym) || sym_sect->sh_link >= obj->elf.header.e_shnum)
+	{
+		*error = "Invalid entsize or link for symtab";
+		return 0;
+	}
+
+	Elf32_Shdr *symstr_sect = &obj->elf.sects[sym_sect->sh_link];
+
+	obj->raw_syms = plan_table(&obj->elf, plan, sym_sect->sh_offset, sym_sect->sh_size);
+	obj->raw_strs = plan_table(&obj->elf, plan, symstr_sect->sh_offset, symstr_sect->sh_size);
+	obj->raw_sym_count = sym_sect->sh_size / sizeof(Elf32_Sym);
+
+	if (!obj->raw_syms || !obj->raw_strs)
+	{
+		*error = "Failed to alloc space for symbols or symbol strings";
+		return 0;
+	}
+
+	return 1;
+}
+
+int elf_read_tables(elf_rel_t *obj, char **error)
+{
+	io_plan_t plan;
+	io_plan_init(&plan, obj->elf.region);
+
+	int ok = elf_plan_tables(obj, &plan, error);
+	if (ok && !io_plan_execute(&plan, &obj->elf))
+	{
+		*error = "Failed to read symbol tables";
+		ok = 0;
+	}
+
+	io_plan_free(&plan);
+	if (!ok) return 0;
+
+	//Whole table at once, into host byte order
+	elf_swap_syms(obj->raw_syms, obj->raw_sym_count);
+	return 1;
+}
+
+int elf_init_local_symbols(elf_rel_t *obj)
+{
+	//Sized for every symbol but the NULL one, the rows are appended by elf_save_local_symbols
+	return symtab_init(&obj->symbols, obj->elf.region, obj->raw_sym_count ? obj->raw_sym_count - 1 : 0, obj->raw_strs, obj->elf.sh_strings);
+}
+
+void elf_save_local_symbols(elf_rel_t *obj, size_t first, size_t count)
+{
+	save_symbols(&obj->elf, &obj->raw_syms[first], count, &obj->symbols);
+}
+
+int elf_find_local_symbols(elf_rel_t *obj)
+{
+	if (!obj->raw_sym_count) return 1;
+
+	if (!elf_init_local_symbols(obj))
+		return 0;
+
+	//Interpret data (skipping NULL symbol)
+	elf_save_local_symbols(obj, 1, obj->raw_sym_count - 1);
+	return 1;
+}
+
+static int is_optional_section(const char *name)
+{
+	return !strcmp(name, ".eh_frame") || !strcmp(name, ".eh_frame_hdr")
+		|| !strncmp(name, ".gcc_except_table", 17);
+}
+
+static int section_wanted(elf_rel_t *obj, Elf32_Shdr *sect, dl_section_policy_t policy)
+{
+	//Only sections that occupy memory at runtime, this leaves out .comment, .debug_* and the like
+	if (!(sect->sh_flags & SHF_ALLOC) || !sect->sh_size)
+		return 0;
+
+	const char *name = &obj->elf.sh_strings[sect->sh_name];
+	if (!is_optional_section(name))
+		return 1;
+
+	return policy ? policy(name, sect->sh_size) : 0;
+}
+
+//Strings and constants can be shared with other modules, unless something in them is relocated
+static int section_mergeable(elf_rel_t *obj, int idx)
+{
+	Elf32_Shdr *sect = &obj->elf.sects[idx];
+	if (!(sect->sh_flags & SHF_MERGE) || (sect->sh_flags & SHF_WRITE) || sect->sh_type == SHT_NOBITS || !sect->sh_entsize)
+		return 0;
+
+	for (int i = 1; i < obj->elf.header.e_shnum; ++i)
+	{
+		if (obj->elf.sects[i].sh_type == SHT_RELA && obj->elf.sects[i].sh_info == (Elf32_Word)idx)
+			return 0;
+	}
+
+	return 1;
+}
+
+void select_sections(elf_rel_t *obj, dl_section_policy_t policy)
+{
+	for (int i = 0; i < obj->elf.header.e_shnum; ++i)
+	{
+		obj->wanted[i] = section_wanted(obj, &obj->elf.sects[i], policy) ? SECT_LOADED : SECT_SKIPPED;
+
+		//Real-time modules keep their own copy, the constant pool grows on the heap
+		if (obj->wanted[i] && !obj->elf.region && section_mergeable(obj, i))
+			obj->wanted[i] = SECT_MERGED;
+	}
+}
+
+//Sections nothing references but the runtime may still run
+static int section_kept(elf_rel_t *obj, int idx)
+{
+	Elf32_Shdr *sect = &obj->elf.sects[idx];
+	if (sect->sh_type == SHT_INIT_ARRAY || sect->sh_type == SHT_FINI_ARRAY || sect->sh_type == SHT_PREINIT_ARRAY)
+		return 1;
+
+	//Optional sections only get here when the policy asked for them, and they describe the code they reference
+	const char *name = &obj->elf.sh_strings[sect->sh_name];
+	return !strncmp(name, ".ctors", 6) || !strncmp(name, ".dtors", 6)
+		|| !strncmp(name, ".init", 5) || !strncmp(name, ".fini", 5)
+		|| is_optional_section(name);
+}
+
+static int symbol_is_root(elf_rel_t *obj, Elf32_Sym *sym, const char **roots)
+{
+	if (sym->st_shndx == SHN_UNDEF || ELF32_ST_BIND(sym->st_info) == STB_LOCAL)
+		return 0;
+
+	if (!roots)
+		return 1;
+
+	const char *name = &obj->raw_strs[sym->st_name];
+	for (const char **root = roots; *root; ++root)
+	{
+		if (!strcmp(*root, name))
+			return 1;
+	}
+
+	return 0;
+}
+
+static void mark_section(elf_rel_t *obj, Elf32_Half idx, collect_state_t *state)
+{
+	if (idx >= obj->elf.header.e_shnum || state->reached[idx]) return;
+	if (obj->wanted[idx] != SECT_LOADED && obj->wanted[idx] != SECT_MERGED) return;
+
+	state->reached[idx] = 1;
+	state->stack[state->depth++] = idx;
+}
+
+int collect_init(elf_rel_t *obj, collect_state_t *state, char **error)
+{
+	int shnum = obj->elf.header.e_shnum;
+	region_t *region = obj->elf.region;
+	memset(state, 0, sizeof(collect_state_t));
+	state->reached = region_calloc(region, shnum, 1);
+	state->stack = region_alloc(region, shnum * sizeof(int));
+	state->rela_of = region_calloc(region, shnum, sizeof(int));
+	obj->referenced = region_calloc(region, obj->raw_sym_count, 1);
+	if (!state->reached || !state->stack || !state->rela_of || !obj->referenced)
+	{
+		collect_free(obj, state);
+		*error = "Failed to allocate collection state";
+		return 0;
+	}
+
+	for (int i = 1; i < shnum; ++i)
+	{
+		Elf32_Shdr *sect = &obj->elf.sects[i];
+		if (sect->sh_type == SHT_RELA && sect->sh_info < (Elf32_Word)shnum)
+			state->rela_of[sect->sh_info] = i;
+	}
+
+	for (int i = 1; i < shnum; ++i)
+	{
+		if (section_kept(obj, i)) mark_section(obj, i, state);
+	}
+
+	state->next_sym = 1;
+	return 1;
+}
+
+int collect_some(elf_rel_t *obj, collect_state_t *state, const char **roots, size_t max, char **error)
+{
+	for (; max && state->next_sym < obj->raw_sym_count; ++state->next_sym, --max)
+	{
+		Elf32_Sym *sym = &obj->raw_syms[state->next_sym];
+		if (symbol_is_root(obj, sym, roots))
+			mark_section(obj, sym->st_shndx, state);
+	}
+
+	//Every section is pushed at most once, the stack never outgrows e_shnum
+	//Relocations are streamed in chunks and dropped, applying reads them again
+	Elf32_Rela relas[ELF_RELA_CHUNK];
+	while (max)
+	{
+		if (!state->rela)
+		{
+			if (!state->depth) break;
+
+			int rela_idx = state->rela_of[state->stack[--state->depth]];
+			if (!rela_idx || !elf_rela_wanted(obj, rela_idx)) continue;
+
+			state->rela = rela_idx;
+			state->done = 0;
+		}
+
+		size_t rela_count = obj->elf.sects[state->rela].sh_size / sizeof(Elf32_Rela);
+		size_t count = rela_count - state->done;
+		if (count > ELF_RELA_CHUNK) count = ELF_RELA_CHUNK;
+		if (count > max) count = max;
+		if (count && !elf_read_relas(obj, state->rela, state->done, relas, count, error))
+			return 0;
+
+		for (size_t r = 0; r < count; ++r)
+		{
+			size_t sym_idx = ELF32_R_SYM(relas[r].r_info);
+			if (sym_idx >= obj->raw_sym_count) continue;
+
+			obj->referenced[sym_idx] = 1;
+			mark_section(obj, obj->raw_syms[sym_idx].st_shndx, state);
+		}
+
+		state->done += count;
+		max -= count;
+		if (state->done >= rela_count) state->rela = 0;
+	}
+
+	return 1;
+}
+
+int collect_done(elf_rel_t *obj, const collect_state_t *state)
+{
+	return state->next_sym >= obj->raw_sym_count && !state->rela && !state->depth;
+}
+
+void collect_finish(elf_rel_t *obj, collect_state_t *state)
+{
+	for (int i = 1; i < obj->elf.header.e_shnum; ++i)
+	{
+		if (!state->reached[i] && (obj->wanted[i] == SECT_LOADED || obj->wanted[i] == SECT_MERGED))
+			obj->wanted[i] = SECT_COLLECTED;
+	}
+
+	collect_free(obj, state);
+}
+
+void collect_free(elf_rel_t *obj, collect_state_t *state)
+{
+	region_t *region = obj->elf.region;
+	region_free(region, state->reached);
+	region_free(region, state->stack);
+	region_free(region, state->rela_of);
+	memset(state, 0, sizeof(collect_state_t));
+}
+
+//Leaves out every section the roots do not reach through relocations, so modules built with
+//-ffunction-sections -fdata-sections only cost what is used
+//Reads the relocations of every reached section, after the symbols, noting the symbols they use
+int collect_sections(elf_rel_t *obj, const char **roots, char **error)
+{
+	collect_state_t state;
+	if (!collect_init(obj, &state, error))
+		return 0;
+
+	if (!collect_some(obj, &state, roots, SIZE_MAX, error))
+	{
+		collect_free(obj, &state);
+		return 0;
+	}
+
+	collect_finish(obj, &state);
+	return 1;
+}
+
+int count_groups(elf_rel_t *obj)
+{
+	int count = 0;
+	for (int i = 1; i < obj->elf.header.e_shnum; ++i)
+		count += obj->elf.sects[i].sh_type == SHT_GROUP;
+	return count;
+}
+
+int index_own_symbols(elf_exec_t *exec, char **error)
+{
+	symtab_t *tab = &exec->symbols;
+	if (!symindex_init(&exec->index, tab, NULL))
+	{
+		*error = "Failed to allocate host symbol index";
+		return 0;
+	}
+
+	for (size_t i = 0; i < tab->count; ++i)
+	{
+		//Only what a module could legitimately link against, the first of a name wins
+		if (ELF32_ST_BIND(tab->info[i]) == STB_LOCAL || !tab->addresses[i])
+			continue;
+
+		symindex_add(&exec->index, i);
+	}
+
+	return 1;
+}
+
+int compute_own_symbols(elf_exec_t *exec)
+{
+	symtab_t *tab = &exec->symbols;
+	for (size_t i = 0; i < tab->count; ++i)
+	{
+		Elf32_Half section = tab->sections[i];
+
+		//Executables hold absolute addresses, loaded as linked by elf2dol
+		if (section == SHN_ABS)
+		{
+			tab->addresses[i] = (void*)(uintptr_t)tab->values[i];
+			continue;
+		}
+
+		if (section == SHN_UNDEF || section >= exec->elf.header.e_shnum)
+		{
+			tab->addresses[i] = NULL;
+			continue;
+		}
+
+		Elf32_Shdr *sect = &exec->elf.sects[section];
+		tab->addresses[i] = (sect->sh_flags & SHF_ALLOC) ? (void*)(uintptr_t)tab->values[i] : NULL;
+	}
+
+	return 1;
+}
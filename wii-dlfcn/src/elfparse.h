@@ -0,0 +1,74 @@
+#ifndef ELFPARSE_H_
+#define ELFPARSE_H_
+
+#include <stddef.h>
+
+#include "data.h"
+#include "elf.h"
+#include "ioplan.h"
+
+//Parsing of headers, tables and section selection, shared by the loader and the host tools
+//Functions returning int return 1 on success, 0 setting *error otherwise
+
+int elf_rel_valid(elf_rel_t *obj, char **error);
+int elf_exec_valid(elf_exec_t *exec, char **error);
+int elf_load_sects(elf_file_t *elf, char **error);
+int elf_load_shstrings(elf_file_t *elf, char **error);
+
+//Maps the range when the file is mapped, otherwise allocates for it and queues the read
+void *plan_table(elf_file_t *elf, io_plan_t *plan, Elf32_Off offset, size_t size);
+//Queues the reads of the symbol table and its strings, left in file byte order
+int elf_plan_tables(elf_rel_t *obj, io_plan_t *plan, char **error);
+//Reads the symbol table and its strings, swapping the table to host byte order
+int elf_read_tables(elf_rel_t *obj, char **error);
+
+//Relocations are never kept raw: they are read ELF_RELA_CHUNK entries at a time into a caller buffer
+#define ELF_RELA_CHUNK 64
+//Whether section idx holds relocations of a section that is loaded
+int elf_rela_wanted(elf_rel_t *obj, int idx);
+size_t elf_count_relocations(elf_rel_t *obj);
+//Reads count entries of rela section idx from entry first, in host byte order
+int elf_read_relas(elf_rel_t *obj, int idx, size_t first, Elf32_Rela *relas, size_t count, char **error);
+//Fills *final from one entry of the relocations of section target_sect_idx, the name points into the tables
+int elf_parse_relocation(elf_rel_t *obj, int target_sect_idx, Elf32_Rela *rela, rel_symbol_t *final, char **error);
+
+//Parses the raw tables into symtab_t and reltab_t rows
+int elf_find_local_symbols(elf_rel_t *obj);
+//Same in steps: sizes the table, then appends count raw symbols from first on at a time
+int elf_init_local_symbols(elf_rel_t *obj);
+void elf_save_local_symbols(elf_rel_t *obj, size_t first, size_t count);
+//Records every relocation of the loaded sections at once, for tools
+int elf_find_relocations(elf_rel_t *obj, char **error);
+
+//Decides how each section is loaded (SECT_LOADED, SECT_MERGED or SECT_SKIPPED)
+void select_sections(elf_rel_t *obj, dl_section_policy_t policy);
+//Walk of the relocation graph from the roots, kept between collect_some calls
+typedef struct {
+	char *reached;
+	//Reached sections whose relocations are still to be read, and the rela section of each
+	int *stack;
+	int depth;
+	int *rela_of;
+	//Next symbol checked for being a root, then the rela section being read and entries done in it
+	size_t next_sym;
+	int rela;
+	size_t done;
+} collect_state_t;
+
+//Marks SECT_COLLECTED the sections not reachable from roots, NULL for every global
+//Fills elf_rel_t::referenced, the undefined symbols left out code uses need not resolve
+int collect_sections(elf_rel_t *obj, const char **roots, char **error);
+//Same in steps: collect_some checks up to max symbols or relocations, call it until collect_done,
+//then collect_finish marks the sections, collect_free drops a walk left unfinished
+int collect_init(elf_rel_t *obj, collect_state_t *state, char **error);
+int collect_some(elf_rel_t *obj, collect_state_t *state, const char **roots, size_t max, char **error);
+int collect_done(elf_rel_t *obj, const collect_state_t *state);
+void collect_finish(elf_rel_t *obj, collect_state_t *state);
+void collect_free(elf_rel_t *obj, collect_state_t *state);
+int count_groups(elf_rel_t *obj);
+
+int elf_find_defined_symbols(elf_exec_t *exec, char **error);
+int compute_own_symbols(elf_exec_t *exec);
+int index_own_symbols(elf_exec_t *exec, char **error);
+
+#endif
@@ -0,0 +1,105 @@
+#include "elfswap.h"
+
+#if ELF_NEEDS_SWAP
+
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+//Byte order within 16 bytes, for a run of 32-bit words and for one Elf32_Sym
+#define WORD_SHUFFLE 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+#define SYM_SHUFFLE 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 12, 13, 15, 14
+
+typedef char sym_is_16_bytes[sizeof(Elf32_Sym) == 16 ? 1 : -1];
+typedef char shdr_is_words[sizeof(Elf32_Shdr) == 10 * sizeof(uint32_t) ? 1 : -1];
+typedef char rela_is_words[sizeof(Elf32_Rela) == 3 * sizeof(uint32_t) ? 1 : -1];
+
+static void swap_sym(Elf32_Sym *sym)
+{
+	sym->st_name = __builtin_bswap32(sym->st_name);
+	sym->st_value = __builtin_bswap32(sym->st_value);
+	sym->st_size = __builtin_bswap32(sym->st_size);
+	sym->st_shndx = __builtin_bswap16(sym->st_shndx);
+}
+
+void elf_swap_words(uint32_t *words, size_t count)
+{
+	size_t i = 0;
+
+#if defined(__AVX2__)
+	const __m256i mask = _mm256_setr_epi8(WORD_SHUFFLE, WORD_SHUFFLE);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*)&words[i]);
+		_mm256_storeu_si256((__m256i*)&words[i], _mm256_shuffle_epi8(v, mask));
+	}
+#elif defined(__SSSE3__)
+	const __m128i mask = _mm_setr_epi8(WORD_SHUFFLE);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)&words[i]);
+		_mm_storeu_si128((__m128i*)&words[i], _mm_shuffle_epi8(v, mask));
+	}
+#endif
+
+	for (; i < count; ++i)
+		words[i] = __builtin_bswap32(words[i]);
+}
+
+void elf_swap_ehdr(Elf32_Ehdr *header)
+{
+	header->e_type = __builtin_bswap16(header->e_type);
+	header->e_machine = __builtin_bswap16(header->e_machine);
+	header->e_version = __builtin_bswap32(header->e_version);
+	header->e_entry = __builtin_bswap32(header->e_entry);
+	header->e_phoff = __builtin_bswap32(header->e_phoff);
+	header->e_shoff = __builtin_bswap32(header->e_shoff);
+	header->e_flags = __builtin_bswap32(header->e_flags);
+	header->e_ehsize = __builtin_bswap16(header->e_ehsize);
+	header->e_phentsize = __builtin_bswap16(header->e_phentsize);
+	header->e_phnum = __builtin_bswap16(header->e_phnum);
+	header->e_shentsize = __builtin_bswap16(header->e_shentsize);
+	header->e_shnum = __builtin_bswap16(header->e_shnum);
+	header->e_shstrndx = __builtin_bswap16(header->e_shstrndx);
+}
+
+void elf_swap_shdrs(Elf32_Shdr *sects, size_t count)
+{
+	elf_swap_words((uint32_t*)sects, count * 10);
+}
+
+void elf_swap_relas(Elf32_Rela *relas, size_t count)
+{
+	elf_swap_words((uint32_t*)relas, count * 3);
+}
+
+void elf_swap_syms(Elf32_Sym *syms, size_t count)
+{
+	size_t i = 0;
+
+	//One symbol per 16 bytes, three words, two single bytes and a half word
+#if defined(__AVX2__)
+	const __m256i mask = _mm256_setr_epi8(SYM_SHUFFLE, SYM_SHUFFLE);
+	for (; i + 2 <= count; i += 2)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*)&syms[i]);
+		_mm256_storeu_si256((__m256i*)&syms[i], _mm256_shuffle_epi8(v, mask));
+	}
+#elif defined(__SSSE3__)
+	const __m128i mask = _mm_setr_epi8(SYM_SHUFFLE);
+	for (; i < count; ++i)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)&syms[i]);
+		_mm_storeu_si128((__m128i*)&syms[i], _mm_shuffle_epi8(v, mask));
+	}
+#endif
+
+	for (; i < count; ++i)
+		swap_sym(&syms[i]);
+}
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef ELFSWAP_H_
+#define ELFSWAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "elf.h"
+
+//Modules are big-endian PowerPC ELF, tables need swapping only on little-endian hosts
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define ELF_NEEDS_SWAP 1
+#else
+#define ELF_NEEDS_SWAP 0
+#endif
+
+#if ELF_NEEDS_SWAP
+
+//Swap tables in place, from file to host byte order, in one pass each
+void elf_swap_ehdr(Elf32_Ehdr *header);
+void elf_swap_shdrs(Elf32_Shdr *sects, size_t count);
+void elf_swap_syms(Elf32_Sym *syms, size_t count);
+void elf_swap_relas(Elf32_Rela *relas, size_t count);
+//Byte swaps count 32-bit words, vectorized where the host allows
+void elf_swap_words(uint32_t *words, size_t count);
+
+#else
+
+//Native byte order, nothing to do
+static inline void elf_swap_ehdr(Elf32_Ehdr *header) { (void)header; }
+static inline void elf_swap_shdrs(Elf32_Shdr *sects, size_t count) { (void)sects; (void)count; }
+static inline void elf_swap_syms(Elf32_Sym *syms, size_t count) { (void)syms; (void)count; }
+static inline void elf_swap_relas(Elf32_Rela *relas, size_t count) { (void)relas; (void)count; }
+static inline void elf_swap_words(uint32_t *words, size_t count) { (void)words; (void)count; }
+
+#endif
+
+#endif
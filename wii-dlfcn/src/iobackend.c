@@ -0,0 +1,147 @@
+#include "dlfcn_io.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(GEKKO) && defined(__unix__)
+#define HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*=== stdio ===*/
+typedef struct {
+	FILE *file;
+	//Position of the stream, fseek only when a read starts elsewhere
+	long pos;
+} stdio_ctx_t;
+
+static int stdio_read_at(void *ptr, uint32_t offset, void *buff, size_t size)
+{
+	stdio_ctx_t *ctx = ptr;
+
+	if (ctx->pos != (long)offset)
+	{
+		if (fseek(ctx->file, offset, SEEK_SET))
+			return 0;
+		ctx->pos = offset;
+	}
+
+	size_t got = fread(buff, 1, size, ctx->file);
+	ctx->pos += got;
+	return got == size;
+}
+
+static long stdio_size(void *ptr)
+{
+	stdio_ctx_t *ctx = ptr;
+
+	if (fseek(ctx->file, 0, SEEK_END))
+		return -1;
+
+	ctx->pos = ftell(ctx->file);
+	return ctx->pos;
+}
+
+static void stdio_close(void *ptr)
+{
+	stdio_ctx_t *ctx = ptr;
+	fclose(ctx->file);
+	free(ctx);
+}
+
+static const dl_io_ops_t stdio_ops = { stdio_read_at, stdio_size, NULL, stdio_close };
+
+int dl_io_open_stdio(const char *path, dl_io_t *io)
+{
+	stdio_ctx_t *ctx = malloc(sizeof(stdio_ctx_t));
+	if (!ctx) return 1;
+
+	ctx->file = fopen(path, "rb");
+	ctx->pos = 0;
+	if (!ctx->file)
+	{
+		free(ctx);
+		return 1;
+	}
+
+	io->ops = &stdio_ops;
+	io->ctx = ctx;
+	return 0;
+}
+
+/*=== mmap ===*/
+#ifdef HAVE_MMAP
+typedef struct {
+	unsigned char *map;
+	size_t size;
+} mmap_ctx_t;
+
+static int mmap_read_at(void *ptr, uint32_t offset, void *buff, size_t size)
+{
+	mmap_ctx_t *ctx = ptr;
+
+	if (offset > ctx->size || size > ctx->size - offset)
+		return 0;
+
+	memcpy(buff, ctx->map + offset, size);
+	return 1;
+}
+
+static long mmap_size(void *ptr)
+{
+	return (long)((mmap_ctx_t*)ptr)->size;
+}
+
+static void *mmap_map(void *ptr)
+{
+	return ((mmap_ctx_t*)ptr)->map;
+}
+
+static void mmap_close(void *ptr)
+{
+	mmap_ctx_t *ctx = ptr;
+	if (ctx->size) munmap(ctx->map, ctx->size);
+	free(ctx);
+}
+
+static const dl_io_ops_t mmap_ops = { mmap_read_at, mmap_size, mmap_map, mmap_close };
+
+int dl_io_open_mmap(const char *path, dl_io_t *io)
+{
+	struct stat st;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return 1;
+
+	mmap_ctx_t *ctx = malloc(sizeof(mmap_ctx_t));
+	if (!ctx || fstat(fd, &st))
+	{
+		free(ctx); close(fd);
+		return 1;
+	}
+
+	//Private and writable, so tables can be fixed up in place without touching the file
+	ctx->size = st.st_size;
+	ctx->map = ctx->size ? mmap(NULL, ctx->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) : NULL;
+	close(fd);
+
+	if (ctx->map == MAP_FAILED)
+	{
+		free(ctx);
+		return 1;
+	}
+
+	io->ops = &mmap_ops;
+	io->ctx = ctx;
+	return 0;
+}
+#else
+int dl_io_open_mmap(const char *path, dl_io_t *io)
+{
+	(void)path; (void)io;
+	return 1;
+}
+#endif
@@ -0,0 +1,146 @@
+#include "ioplan.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "data.h"
+
+static int compare_ranges(const void *a, const void *b)
+{
+	Elf32_Off oa = ((const io_range_t*)a)->offset;
+	Elf32_Off ob = ((const io_range_t*)b)->offset;
+	return oa < ob ? -1 : oa > ob;
+}
+
+void io_plan_init(io_plan_t *plan, region_t *region)
+{
+	memset(plan, 0, sizeof(io_plan_t));
+	plan->region = region;
+}
+
+int io_plan_add(io_plan_t *plan, Elf32_Off offset, size_t size, void *dest)
+{
+	if (!size) return 1;
+
+	if (plan->count == plan->cap)
+	{
+		size_t cap = plan->cap ? plan->cap * 2 : 16;
+		io_range_t *ranges;
+		if (plan->region)
+		{
+			//Regions do not resize in place, the old ranges are left behind until the module goes
+			ranges = region_alloc(plan->region, cap * sizeof(io_range_t));
+			if (ranges && plan->count) memcpy(ranges, plan->ranges, plan->count * sizeof(io_range_t));
+		}
+		else
+			ranges = realloc(plan->ranges, cap * sizeof(io_range_t));
+		if (!ranges) return 0;
+
+		plan->ranges = ranges;
+		plan->cap = cap;
+	}
+
+	io_range_t *range = &plan->ranges[plan->count++];
+	range->offset = offset;
+	range->size = size;
+	range->dest = dest;
+	return 1;
+}
+
+int io_plan_execute(io_plan_t *plan, elf_file_t *elf)
+{
+	plan->next = plan->next_done = 0;
+	return io_plan_execute_some(plan, elf, SIZE_MAX);
+}
+
+//Ranges from first on that can be read in one call, and the bytes that call spans
+static size_t plan_run(io_plan_t *plan, size_t first, size_t *span)
+{
+	Elf32_Off start = plan->ranges[first].offset;
+	Elf32_Off end = start + plan->ranges[first].size;
+
+	size_t last = first + 1;
+	for (; last < plan->count; ++last)
+	{
+		io_range_t *range = &plan->ranges[last];
+		Elf32_Off range_end = range->offset + range->size;
+		if (range->offset > end && range->offset - end > IO_PLAN_MAX_GAP)
+			break;
+		if ((range_end > end ? range_end : end) - start > IO_PLAN_STAGE)
+			break;
+
+		if (range_end > end) end = range_end;
+	}
+
+	*span = end - start;
+	return last - first;
+}
+
+//Reads a run with one call and hands each range its bytes
+static int read_run(io_plan_t *plan, elf_file_t *elf, size_t run, size_t span)
+{
+	if (!plan->stage && !(plan->stage = region_alloc(plan->region, IO_PLAN_STAGE)))
+		return 0;
+
+	Elf32_Off start = plan->ranges[plan->next].offset;
+	if (!elf_file_read(elf, start, plan->stage, span))
+		return 0;
+
+	for (size_t i = plan->next; i < plan->next + run; ++i)
+		memcpy(plan->ranges[i].dest, plan->stage + (plan->ranges[i].offset - start), plan->ranges[i].size);
+
+	plan->next += run;
+	return 1;
+}
+
+int io_plan_execute_some(io_plan_t *plan, elf_file_t *elf, size_t max_bytes)
+{
+	if (!plan->next && !plan->next_done)
+		qsort(plan->ranges, plan->count, sizeof(io_range_t), compare_ranges);
+
+	while (plan->next < plan->count && max_bytes)
+	{
+		io_range_t *range = &plan->ranges[plan->next];
+
+		//Nearby ranges are merged into one sequential read, mapped files have nothing to gain
+		size_t span = 0;
+		size_t run = !elf->map && !plan->next_done ? plan_run(plan, plan->next, &span) : 1;
+		if (run > 1 && span <= max_bytes)
+		{
+			if (!read_run(plan, elf, run, span))
+				return 0;
+
+			max_bytes -= span;
+			continue;
+		}
+
+		size_t size = range->size - plan->next_done;
+		if (size > max_bytes) size = max_bytes;
+
+		if (!elf_file_read(elf, range->offset + plan->next_done, (char*)range->dest + plan->next_done, size))
+			return 0;
+
+		max_bytes -= size;
+		plan->next_done += size;
+		if (plan->next_done == range->size)
+		{
+			++plan->next;
+			plan->next_done = 0;
+		}
+	}
+
+	return 1;
+}
+
+int io_plan_done(io_plan_t *plan)
+{
+	return plan->next == plan->count;
+}
+
+void io_plan_free(io_plan_t *plan)
+{
+	region_free(plan->region, plan->ranges);
+	region_free(plan->region, plan->stage);
+	io_plan_init(plan, plan->region);
+}
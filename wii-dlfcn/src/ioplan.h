@@ -0,0 +1,43 @@
+#ifndef IOPLAN_H_
+#define IOPLAN_H_
+
+#include <stddef.h>
+
+#include "data.h"
+#include "elf.h"
+#include "region.h"
+
+//Ranges at most this far apart are read together, gap included, rather than seeked between
+#define IO_PLAN_MAX_GAP 1024
+//Largest span read at once into the staging buffer, larger ranges are read straight to their destination
+#define IO_PLAN_STAGE 4096
+
+typedef struct {
+	Elf32_Off offset;
+	size_t size;
+	void *dest;
+} io_range_t;
+
+//Set of byte ranges read together, in file order
+typedef struct {
+	io_range_t *ranges;
+	size_t count;
+	size_t cap;
+	//Progress of io_plan_execute_some, range and bytes of it already read
+	size_t next;
+	size_t next_done;
+	//IO_PLAN_STAGE bytes runs of nearby ranges are read into, allocated on the first run
+	unsigned char *stage;
+	//Where the ranges and the stage are allocated, NULL for the heap
+	region_t *region;
+} io_plan_t;
+
+void io_plan_init(io_plan_t *plan, region_t *region);
+int io_plan_add(io_plan_t *plan, Elf32_Off offset, size_t size, void *dest);
+int io_plan_execute(io_plan_t *plan, elf_file_t *elf);
+//Reads up to max_bytes more of the plan, call until io_plan_done, no ranges may be added meanwhile
+int io_plan_execute_some(io_plan_t *plan, elf_file_t *elf, size_t max_bytes);
+int io_plan_done(io_plan_t *plan);
+void io_plan_free(io_plan_t *plan);
+
+#endif
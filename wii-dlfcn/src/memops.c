@@ -0,0 +1,43 @@
+#include "memops.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define LINE_MASK ((uintptr_t)MEMOPS_LINE - 1)
+
+void dl_zero(void *dest, size_t size)
+{
+#ifdef GEKKO
+	uintptr_t start = (uintptr_t)dest, end = start + size;
+	uintptr_t first = (start + LINE_MASK) & ~LINE_MASK, last = end & ~LINE_MASK;
+
+	//Partial lines at either end are cleared normally, dcbz would clear their neighbours too
+	if (size >= MEMOPS_MIN && first < last)
+	{
+		memset(dest, 0, first - start);
+		dl_zero_lines((void*)first, (last - first) / MEMOPS_LINE);
+		memset((void*)last, 0, end - last);
+		return;
+	}
+#endif
+	memset(dest, 0, size);
+}
+
+void dl_copy(void *dest, const void *src, size_t size)
+{
+#ifdef GEKKO
+	uintptr_t start = (uintptr_t)dest, end = start + size;
+	uintptr_t first = (start + LINE_MASK) & ~LINE_MASK, last = end & ~LINE_MASK;
+
+	//Once dest is line aligned, src must be aligned for the 64 bit loads
+	if (size >= MEMOPS_MIN && first < last && !((start ^ (uintptr_t)src) & 7))
+	{
+		size_t head = first - start, body = last - first;
+		memcpy(dest, src, head);
+		dl_copy_lines((void*)first, (const char*)src + head, body / MEMOPS_LINE);
+		memcpy((void*)last, (const char*)src + head + body, end - last);
+		return;
+	}
+#endif
+	memcpy(dest, src, size);
+}
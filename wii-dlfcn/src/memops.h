@@ -0,0 +1,26 @@
+#ifndef MEMOPS_H_
+#define MEMOPS_H_
+
+#include <stddef.h>
+
+//Data cache line of the Gekko/Broadway
+#define MEMOPS_LINE 32
+//Below this size the line kernels are not worth their setup
+#define MEMOPS_MIN 256
+
+//Same as memset(dest, 0, size), whole cache lines are claimed with dcbz instead of being read in first
+//dest must be cacheable memory, dcbz faults on cache inhibited addresses
+void dl_zero(void *dest, size_t size);
+//Same as memcpy, whole lines are prefetched with dcbt and moved with 64 bit loads and stores
+//Falls back to memcpy when dest and src are not 8 byte aligned alike
+void dl_copy(void *dest, const void *src, size_t size);
+
+#ifdef GEKKO
+//Kernels of memops_kernels.s, dest is line aligned
+//dest <= lines * MEMOPS_LINE zero bytes
+extern void dl_zero_lines(void *dest, size_t lines);
+//src is 8 byte aligned
+extern void dl_copy_lines(void *dest, const void *src, size_t lines);
+#endif
+
+#endif
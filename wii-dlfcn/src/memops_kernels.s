@@ -0,0 +1,47 @@
+	.global dl_zero_lines
+	.global dl_copy_lines
+	.text
+
+# Lines fetched ahead of the copy, far enough to hide the memory latency
+	.set PREFETCH, 128
+
+# void dl_zero_lines(void *dest, size_t lines)
+# r3 <= dest, line aligned
+# r4 <= lines
+# Each line is claimed in the cache already zeroed, nothing is read from memory
+dl_zero_lines:
+	cmpwi 4, 0
+	beqlr            # nothing to clear
+	mtctr 4          # ctr <- lines
+1:
+	dcbz 0, 3        # *r3 line <- 0
+	addi 3, 3, 32
+	bdnz 1b
+	blr
+
+# void dl_copy_lines(void *dest, const void *src, size_t lines)
+# r3 <= dest, line aligned
+# r4 <= src, 8 byte aligned
+# r5 <= lines
+# r6 = prefetch distance
+# f0-f3 = line being moved, FPR loads and stores move 64 bit words bit exact
+dl_copy_lines:
+	cmpwi 5, 0
+	beqlr            # nothing to copy
+	mtctr 5          # ctr <- lines
+	li 6, PREFETCH
+1:
+	dcbt 6, 4        # start fetching a later src line
+	lfd 0, 0(4)
+	lfd 1, 8(4)
+	lfd 2, 16(4)
+	lfd 3, 24(4)
+	dcbz 0, 3        # whole dest line is overwritten, claim it instead of reading it in
+	stfd 0, 0(3)
+	stfd 1, 8(3)
+	stfd 2, 16(3)
+	stfd 3, 24(3)
+	addi 4, 4, 32
+	addi 3, 3, 32
+	bdnz 1b
+	blr
@@ -0,0 +1,231 @@
+#include "mergepool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MERGE_MIN_BUCKETS 64
+
+//Shared copy of a piece, chained in its hash bucket
+struct merge_entry {
+	struct merge_entry *next;
+	uint32_t hash;
+	uint32_t size;
+	uint32_t align;
+	uint32_t refs;
+	unsigned char *data;
+};
+
+static merge_entry_t **buckets = NULL;
+static size_t bucket_count = 0;
+static size_t entry_count = 0;
+static size_t bytes_pooled = 0;
+static size_t bytes_saved = 0;
+
+//FNV-1a over the contents
+static uint32_t merge_hash(const unsigned char *data, size_t size)
+{
+	uint32_t h = 0x811C9DC5u;
+	for (size_t i = 0; i < size; ++i)
+	{
+		h ^= data[i];
+		h *= 0x01000193u;
+	}
+	return h;
+}
+
+static int grow_buckets(void)
+{
+	size_t count = bucket_count ? bucket_count * 2 : MERGE_MIN_BUCKETS;
+	merge_entry_t **grown = calloc(count, sizeof(merge_entry_t*));
+	if (!grown) return 0;
+
+	for (size_t b = 0; b < bucket_count; ++b)
+	{
+		merge_entry_t *entry = buckets[b];
+		while (entry)
+		{
+			merge_entry_t *next = entry->next;
+			entry->next = grown[entry->hash & (count - 1)];
+			grown[entry->hash & (count - 1)] = entry;
+			entry = next;
+		}
+	}
+
+	free(buckets);
+	buckets = grown;
+	bucket_count = count;
+	return 1;
+}
+
+static merge_entry_t *intern(const unsigned char *data, uint32_t size, uint32_t align, int *shared)
+{
+	uint32_t hash = merge_hash(data, size);
+
+	//Same contents with at least the alignment asked for can be shared
+	for (merge_entry_t *entry = bucket_count ? buckets[hash & (bucket_count - 1)] : NULL; entry; entry = entry->next)
+	{
+		if (entry->hash != hash || entry->size != size || entry->align < align || memcmp(entry->data, data, size))
+			continue;
+
+		++entry->refs;
+		*shared = 1;
+		return entry;
+	}
+
+	if (entry_count >= bucket_count && !grow_buckets())
+		return NULL;
+
+	merge_entry_t *entry = malloc(sizeof(merge_entry_t));
+	unsigned char *copy = aligned_alloc(align, (size + align - 1) & ~(align - 1));
+	if (!entry || !copy)
+	{
+		free(entry); free(copy);
+		return NULL;
+	}
+
+	memcpy(copy, data, size);
+	entry->hash = hash;
+	entry->size = size;
+	entry->align = align;
+	entry->refs = 1;
+	entry->data = copy;
+	entry->next = buckets[hash & (bucket_count - 1)];
+	buckets[hash & (bucket_count - 1)] = entry;
+	++entry_count;
+
+	*shared = 0;
+	return entry;
+}
+
+static void unref(merge_entry_t *entry)
+{
+	if (--entry->refs)
+	{
+		bytes_saved -= entry->size;
+		return;
+	}
+
+	merge_entry_t **link = &buckets[entry->hash & (bucket_count - 1)];
+	while (*link != entry) link = &(*link)->next;
+	*link = entry->next;
+
+	bytes_pooled -= entry->size;
+	--entry_count;
+	free(entry->data);
+	free(entry);
+}
+
+static size_t piece_size(const unsigned char *data, size_t size, size_t entsize, int strings)
+{
+	if (!strings)
+		return entsize;
+
+	//Up to and including the terminating NUL character
+	static const unsigned char zeros[16] = { 0 };
+	for (size_t len = 0; len + entsize <= size; len += entsize)
+	{
+		if (!memcmp(&data[len], zeros, entsize))
+			return len + entsize;
+	}
+
+	return 0;
+}
+
+int merge_section(merge_sect_t *sect, const unsigned char *data, size_t size, size_t entsize, size_t align, int strings, size_t *bytes_new, size_t *bytes_shared)
+{
+	sect->pieces = NULL;
+	sect->count = 0;
+
+	if (!entsize || entsize > 16 || size % entsize)
+		return 0;
+	if (!align) align = 1;
+
+	//Upper bound, one piece per element
+	sect->pieces = malloc((size / entsize) * sizeof(merge_piece_t));
+	if (!sect->pieces && size)
+		return 0;
+
+	size_t offset = 0;
+	while (offset < size)
+	{
+		size_t len = piece_size(&data[offset], size - offset, entsize, strings);
+		if (!len)
+		{
+			merge_release(sect);
+			return 0;
+		}
+
+		//Strings padded to the section alignment (.rodata.str1.4) keep their padding,
+		//so every piece starts aligned like it did in the section
+		while (strings && (offset + len) % align && offset + len < size && !data[offset + len])
+			++len;
+
+		int shared;
+		merge_entry_t *entry = intern(&data[offset], (uint32_t)len, (uint32_t)align, &shared);
+		if (!entry)
+		{
+			merge_release(sect);
+			return 0;
+		}
+
+		if (shared)
+		{
+			*bytes_shared += len;
+			bytes_saved += len;
+		}
+		else
+		{
+			*bytes_new += len;
+			bytes_pooled += len;
+		}
+
+		merge_piece_t *piece = &sect->pieces[sect->count++];
+		piece->offset = (uint32_t)offset;
+		piece->size = (uint32_t)len;
+		piece->entry = entry;
+
+		offset += len;
+	}
+
+	return 1;
+}
+
+void *merge_lookup(const merge_sect_t *sect, uint32_t offset)
+{
+	size_t lo = 0, hi = sect->count;
+	while (lo < hi)
+	{
+		size_t mid = (lo + hi) / 2;
+		const merge_piece_t *piece = &sect->pieces[mid];
+
+		if (offset < piece->offset) hi = mid;
+		else if (offset >= piece->offset + piece->size) lo = mid + 1;
+		else return piece->entry->data + (offset - piece->offset);
+	}
+
+	//One past the end of the last piece, as in end of section markers
+	if (sect->count)
+	{
+		const merge_piece_t *last = &sect->pieces[sect->count - 1];
+		if (offset == last->offset + last->size)
+			return last->entry->data + last->size;
+	}
+
+	return NULL;
+}
+
+void merge_release(merge_sect_t *sect)
+{
+	for (size_t i = 0; i < sect->count; ++i)
+		unref(sect->pieces[i].entry);
+
+	free(sect->pieces);
+	sect->pieces = NULL;
+	sect->count = 0;
+}
+
+void merge_stats(size_t *pooled, size_t *saved)
+{
+	*pooled = bytes_pooled;
+	*saved = bytes_saved;
+}
@@ -0,0 +1,34 @@
+#ifndef MERGEPOOL_H_
+#define MERGEPOOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct merge_entry merge_entry_t;
+
+//Piece of a SHF_MERGE section, a string or a constant, and its shared copy
+typedef struct {
+	uint32_t offset;
+	uint32_t size;
+	merge_entry_t *entry;
+} merge_piece_t;
+
+//A SHF_MERGE section split into pieces, in offset order
+typedef struct {
+	merge_piece_t *pieces;
+	size_t count;
+} merge_sect_t;
+
+//Splits a section into pieces and interns each into the shared constant pool
+//strings selects SHF_STRINGS (pieces end with an entsize wide NUL) over fixed size constants
+//Adds the bytes newly pooled to *bytes_new and those found already pooled to *bytes_shared
+int merge_section(merge_sect_t *sect, const unsigned char *data, size_t size, size_t entsize, size_t align, int strings, size_t *bytes_new, size_t *bytes_shared);
+//Returns where offset of the original section lives in the pool, NULL if out of the section
+void *merge_lookup(const merge_sect_t *sect, uint32_t offset);
+//Drops the section's references, pooled copies go away with their last user
+void merge_release(merge_sect_t *sect);
+
+//Bytes held by the pool and bytes it currently saves over per-module copies
+void merge_stats(size_t *bytes_pooled, size_t *bytes_saved);
+
+#endif
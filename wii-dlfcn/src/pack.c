@@ -0,0 +1,251 @@
+#include "pack.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "elfswap.h"
+#include "packfmt.h"
+#include "symhash.h"
+
+struct dl_pack {
+	FILE *file;
+	//Position of the stream, shared by every module read from the pack
+	long pos;
+	long size;
+	//The caller's and one per open module backend
+	int refs;
+	uint32_t entry_count;
+	pack_entry_t *entries;
+	//Modules already checked against their fingerprint, one flag per entry
+	unsigned char *verified;
+	char *names;
+	uint32_t names_size;
+};
+
+typedef struct {
+	dl_pack_t *pack;
+	const pack_entry_t *entry;
+} member_ctx_t;
+
+static void pack_free(dl_pack_t *pack)
+{
+	if (pack->file) fclose(pack->file);
+	free(pack->entries);
+	free(pack->verified);
+	free(pack->names);
+	free(pack);
+}
+
+static int pack_read(dl_pack_t *pack, long offset, void *buff, size_t size)
+{
+	if (pack->pos != offset)
+	{
+		if (fseek(pack->file, offset, SEEK_SET))
+			return 0;
+		pack->pos = offset;
+	}
+
+	size_t got = fread(buff, 1, size, pack->file);
+	pack->pos += got;
+	return got == size;
+}
+
+static int pack_valid(dl_pack_t *pack, pack_header_t *header)
+{
+	if (header->magic != PACK_MAGIC || header->version != PACK_VERSION)
+		return 0;
+
+	if (header->names_offset > (uint32_t)pack->size || header->names_size > (uint32_t)pack->size - header->names_offset)
+		return 0;
+
+	for (uint32_t i = 0; i < pack->entry_count; ++i)
+	{
+		pack_entry_t *entry = &pack->entries[i];
+		if (entry->name >= header->names_size)
+			return 0;
+		if (entry->offset > (uint32_t)pack->size || entry->size > (uint32_t)pack->size - entry->offset)
+			return 0;
+	}
+
+	return 1;
+}
+
+dl_pack_t *pack_open(const char *path, char **error)
+{
+	dl_pack_t *pack = calloc(1, sizeof(dl_pack_t));
+	if (!pack)
+	{
+		*error = "Failed to allocate pack";
+		return NULL;
+	}
+
+	pack->file = fopen(path, "rb");
+	if (!pack->file)
+	{
+		*error = "Could not open pack file.";
+		goto _pack_open_error;
+	}
+
+	pack_header_t header;
+	if (fseek(pack->file, 0, SEEK_END) || (pack->size = ftell(pack->file)) < 0)
+	{
+		*error = "Failed to read pack header";
+		goto _pack_open_error;
+	}
+	pack->pos = pack->size;
+
+	if (!pack_read(pack, 0, &header, sizeof(header)))
+	{
+		*error = "Failed to read pack header";
+		goto _pack_open_error;
+	}
+	elf_swap_words((uint32_t*)&header, PACK_HEADER_WORDS);
+
+	//Index and names are read once, every module lookup after that is in memory
+	if (header.entry_count > (uint32_t)pack->size / sizeof(pack_entry_t) || header.names_size > (uint32_t)pack->size)
+	{
+		*error = "Invalid pack file";
+		goto _pack_open_error;
+	}
+
+	pack->entry_count = header.entry_count;
+	pack->names_size = header.names_size;
+	pack->entries = malloc(header.entry_count ? header.entry_count * sizeof(pack_entry_t) : 1);
+	pack->verified = calloc(header.entry_count ? header.entry_count : 1, 1);
+	pack->names = malloc(header.names_size + 1);
+	if (!pack->entries || !pack->verified || !pack->names)
+	{
+		*error = "Failed to allocate pack index";
+		goto _pack_open_error;
+	}
+
+	if (!pack_read(pack, sizeof(header), pack->entries, header.entry_count * sizeof(pack_entry_t))
+		|| !pack_read(pack, header.names_offset, pack->names, header.names_size))
+	{
+		*error = "Failed to read pack index";
+		goto _pack_open_error;
+	}
+	elf_swap_words((uint32_t*)pack->entries, header.entry_count * PACK_ENTRY_WORDS);
+	pack->names[header.names_size] = '\0';
+
+	if (!pack_valid(pack, &header))
+	{
+		*error = "Invalid pack file";
+		goto _pack_open_error;
+	}
+
+	pack->refs = 1;
+	return pack;
+
+_pack_open_error:
+	pack_free(pack);
+	return NULL;
+}
+
+void pack_release(dl_pack_t *pack)
+{
+	if (!__atomic_sub_fetch(&pack->refs, 1, __ATOMIC_ACQ_REL))
+		pack_free(pack);
+}
+
+static const pack_entry_t *pack_find(dl_pack_t *pack, const char *name)
+{
+	uint32_t hash = sym_hash(name, 0);
+
+	//First entry of the hash, then through its collisions
+	uint32_t lo = 0, hi = pack->entry_count;
+	while (lo < hi)
+	{
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (pack->entries[mid].name_hash < hash) lo = mid + 1;
+		else hi = mid;
+	}
+
+	for (; lo < pack->entry_count && pack->entries[lo].name_hash == hash; ++lo)
+	{
+		if (!strcmp(&pack->names[pack->entries[lo].name], name))
+			return &pack->entries[lo];
+	}
+
+	return NULL;
+}
+
+//Hashes a module's bytes a sector at a time, against the fingerprint dlpack stored
+static int pack_verify(dl_pack_t *pack, const pack_entry_t *entry)
+{
+	unsigned char chunk[PACK_DEFAULT_BLOCK];
+	uint32_t h = PACK_FINGERPRINT_SEED;
+
+	for (uint32_t done = 0; done < entry->size;)
+	{
+		uint32_t size = entry->size - done < sizeof(chunk) ? entry->size - done : sizeof(chunk);
+		if (!pack_read(pack, (long)entry->offset + done, chunk, size))
+			return 0;
+
+		h = pack_fingerprint_update(h, chunk, size);
+		done += size;
+	}
+
+	return h == entry->fingerprint;
+}
+
+/*=== member backend ===*/
+static int member_read_at(void *ptr, uint32_t offset, void *buff, size_t size)
+{
+	member_ctx_t *ctx = ptr;
+	if (offset > ctx->entry->size || size > ctx->entry->size - offset)
+		return 0;
+
+	return pack_read(ctx->pack, (long)ctx->entry->offset + offset, buff, size);
+}
+
+static long member_size(void *ptr)
+{
+	return (long)((member_ctx_t*)ptr)->entry->size;
+}
+
+static void member_close(void *ptr)
+{
+	member_ctx_t *ctx = ptr;
+	pack_release(ctx->pack);
+	free(ctx);
+}
+
+static const dl_io_ops_t member_ops = { member_read_at, member_size, NULL, member_close };
+
+int pack_member_io(dl_pack_t *pack, const char *name, dl_io_t *io, char **error)
+{
+	const pack_entry_t *entry = pack_find(pack, name);
+	if (!entry)
+	{
+		*error = "Module not in pack";
+		return 1;
+	}
+
+	//Once per pack, a module rewritten since it was packed is refused rather than loaded half old
+	size_t idx = entry - pack->entries;
+	if (!pack->verified[idx])
+	{
+		if (!pack_verify(pack, entry))
+		{
+			*error = "Module does not match its pack fingerprint";
+			return 1;
+		}
+		pack->verified[idx] = 1;
+	}
+
+	member_ctx_t *ctx = malloc(sizeof(member_ctx_t));
+	if (!ctx)
+	{
+		*error = "Failed to allocate pack member";
+		return 1;
+	}
+
+	__atomic_add_fetch(&pack->refs, 1, __ATOMIC_RELAXED);
+	ctx->pack = pack;
+	ctx->entry = entry;
+	io->ops = &member_ops;
+	io->ctx = ctx;
+	return 0;
+}
@@ -0,0 +1,16 @@
+#ifndef PACK_H_
+#define PACK_H_
+
+#include "dlfcn.h"
+#include "dlfcn_io.h"
+
+//Reads the header, index and names of a pack, the file stays open for its modules
+dl_pack_t *pack_open(const char *path, char **error);
+//Drops the caller's reference, the file is closed once no module reads from it either
+void pack_release(dl_pack_t *pack);
+//Opens a backend over one module of the pack, reads go straight to its offset
+//The first open of a module checks its fingerprint, call with the writer lock held
+//Returns 0 on success, 1 on error
+int pack_member_io(dl_pack_t *pack, const char *name, dl_io_t *io, char **error);
+
+#endif
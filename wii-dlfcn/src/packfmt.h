@@ -0,0 +1,64 @@
+#ifndef PACKFMT_H_
+#define PACKFMT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+//Module pack, written by tools/dlpack and read by dlpackopen
+//Layout: header, entries, names, then every module starting on a block boundary
+//Every field is a big-endian 32-bit word, like the modules themselves
+
+#define PACK_MAGIC 0x444C504Bu //"DLPK"
+#define PACK_VERSION 1
+//Sector size of SD cards and USB drives
+#define PACK_DEFAULT_BLOCK 512
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	//Alignment of every module in the file
+	uint32_t block_size;
+	uint32_t entry_count;
+	//Names of every module, NUL terminated, shared by the whole pack
+	uint32_t names_offset;
+	uint32_t names_size;
+} pack_header_t;
+
+//Entries follow the header, sorted by name_hash
+typedef struct {
+	//sym_hash(name, 0)
+	uint32_t name_hash;
+	//Offset of the name in the names
+	uint32_t name;
+	uint32_t offset;
+	uint32_t size;
+	//Hash of the module's bytes, tells revisions of a module apart
+	uint32_t fingerprint;
+} pack_entry_t;
+
+#define PACK_HEADER_WORDS (sizeof(pack_header_t) / sizeof(uint32_t))
+#define PACK_ENTRY_WORDS (sizeof(pack_entry_t) / sizeof(uint32_t))
+
+#define PACK_FINGERPRINT_SEED 0x811C9DC5u
+
+//FNV-1a, carried from chunk to chunk starting from PACK_FINGERPRINT_SEED
+static inline uint32_t pack_fingerprint_update(uint32_t h, const void *data, size_t size)
+{
+	const unsigned char *bytes = data;
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		h ^= bytes[i];
+		h *= 0x01000193u;
+	}
+
+	return h;
+}
+
+//FNV-1a over the module's bytes
+static inline uint32_t pack_fingerprint(const void *data, size_t size)
+{
+	return pack_fingerprint_update(PACK_FINGERPRINT_SEED, data, size);
+}
+
+#endif
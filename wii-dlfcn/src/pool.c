@@ -0,0 +1,252 @@
+#include "pool.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mergepool.h"
+
+//Free lists by power of two size class, class c holds blocks of [32 << c, 64 << c) bytes
+#define POOL_CLASSES 20
+
+//Boundary tag in front of every block, one granule so payloads stay aligned
+typedef struct pool_block {
+	//Block size including this header, a multiple of POOL_GRANULE
+	uint32_t size;
+	//Size of the block right below, 0 for the first one
+	uint32_t prev_size;
+	int free;
+	//Free list links, only meaningful while free
+	struct pool_block *next;
+	struct pool_block *prev;
+} pool_block_t;
+
+typedef char pool_header_fits[sizeof(pool_block_t) <= POOL_GRANULE ? 1 : -1];
+
+static unsigned char *pool_mem = NULL;
+static size_t pool_size = 0;
+static int pool_owned = 0;
+static pool_block_t *free_lists[POOL_CLASSES];
+static size_t pool_used = 0;
+static size_t heap_fallbacks = 0;
+
+static int size_class(size_t size)
+{
+	int c = 0;
+	size /= POOL_GRANULE;
+	while (size > 1 && c < POOL_CLASSES - 1)
+	{
+		size >>= 1;
+		++c;
+	}
+	return c;
+}
+
+static pool_block_t *block_at(unsigned char *ptr)
+{
+	return ptr < pool_mem + pool_size ? (pool_block_t*)ptr : NULL;
+}
+
+static pool_block_t *next_block(pool_block_t *block)
+{
+	return block_at((unsigned char*)block + block->size);
+}
+
+static pool_block_t *prev_block(pool_block_t *block)
+{
+	return block->prev_size ? (pool_block_t*)((unsigned char*)block - block->prev_size) : NULL;
+}
+
+static void list_insert(pool_block_t *block)
+{
+	pool_block_t **head = &free_lists[size_class(block->size)];
+	block->free = 1;
+	block->prev = NULL;
+	block->next = *head;
+	if (*head) (*head)->prev = block;
+	*head = block;
+}
+
+static void list_remove(pool_block_t *block)
+{
+	if (block->prev) block->prev->next = block->next;
+	else free_lists[size_class(block->size)] = block->next;
+	if (block->next) block->next->prev = block->prev;
+	block->free = 0;
+}
+
+static void set_size(pool_block_t *block, uint32_t size)
+{
+	block->size = size;
+	pool_block_t *next = next_block(block);
+	if (next) next->prev_size = size;
+}
+
+int pool_init(void *mem, size_t size)
+{
+	if (pool_used)
+		return 1;
+
+	//Trim to whole granules at an aligned start
+	uintptr_t start = ((uintptr_t)mem + POOL_GRANULE - 1) & ~(uintptr_t)(POOL_GRANULE - 1);
+	size_t lost = start - (uintptr_t)mem;
+	if (!mem || size < lost + 2 * POOL_GRANULE)
+		return 1;
+
+	if (pool_owned) free(pool_mem);
+	pool_mem = (unsigned char*)start;
+	pool_size = (size - lost) & ~(size_t)(POOL_GRANULE - 1);
+	pool_owned = 0;
+	memset(free_lists, 0, sizeof(free_lists));
+
+	pool_block_t *block = (pool_block_t*)pool_mem;
+	block->size = pool_size;
+	block->prev_size = 0;
+	list_insert(block);
+	return 0;
+}
+
+static pool_block_t *take_block(size_t size)
+{
+	//First fit within the class of size, any block of a higher class is big enough
+	for (int c = size_class(size); c < POOL_CLASSES; ++c)
+	{
+		for (pool_block_t *block = free_lists[c]; block; block = block->next)
+		{
+			if (block->size >= size)
+				return block;
+		}
+	}
+
+	return NULL;
+}
+
+void *pool_alloc(size_t size)
+{
+	if (!pool_mem && !pool_init(aligned_alloc(POOL_GRANULE, DL_POOL_SIZE), DL_POOL_SIZE))
+		pool_owned = 1;
+
+	size_t need = POOL_GRANULE + ((size + POOL_GRANULE - 1) & ~(size_t)(POOL_GRANULE - 1));
+	pool_block_t *block = pool_mem ? take_block(need) : NULL;
+	if (!block)
+	{
+		++heap_fallbacks;
+		return aligned_alloc(POOL_GRANULE, need - POOL_GRANULE);
+	}
+
+	list_remove(block);
+
+	//Split off the tail when it can hold at least one granule
+	if (block->size - need >= 2 * POOL_GRANULE)
+	{
+		size_t rest_size = block->size - need;
+		set_size(block, need);
+
+		pool_block_t *rest = next_block(block);
+		set_size(rest, rest_size);
+		list_insert(rest);
+	}
+
+	pool_used += block->size;
+	return (unsigned char*)block + POOL_GRANULE;
+}
+
+void pool_free(void *ptr)
+{
+	unsigned char *mem = ptr;
+	if (!mem) return;
+
+	if (!pool_owns(mem))
+	{
+		free(ptr);
+		return;
+	}
+
+	pool_block_t *block = (pool_block_t*)(mem - POOL_GRANULE);
+	pool_used -= block->size;
+
+	//Coalesce with free neighbours so freed images merge back into large blocks
+	pool_block_t *next = next_block(block);
+	if (next && next->free)
+	{
+		list_remove(next);
+		set_size(block, block->size + next->size);
+	}
+
+	pool_block_t *prev = prev_block(block);
+	if (prev && prev->free)
+	{
+		list_remove(prev);
+		set_size(prev, prev->size + block->size);
+		block = prev;
+	}
+
+	list_insert(block);
+}
+
+int pool_owns(void *ptr)
+{
+	return (unsigned char*)ptr >= pool_mem && (unsigned char*)ptr < pool_mem + pool_size;
+}
+
+void *pool_slide(void *ptr, size_t align)
+{
+	if (!ptr || !pool_owns(ptr))
+		return ptr;
+
+	pool_block_t *block = (pool_block_t*)((unsigned char*)ptr - POOL_GRANULE);
+	pool_block_t *prev = prev_block(block);
+	if (!prev || !prev->free || prev->size % align)
+		return ptr;
+
+	uint32_t size = block->size;
+	uint32_t gap = prev->size;
+	uint32_t prev_size = prev->prev_size;
+	pool_block_t *next = next_block(block);
+
+	list_remove(prev);
+	memmove(prev, block, size);
+
+	pool_block_t *moved = prev;
+	moved->size = size;
+	moved->prev_size = prev_size;
+	moved->free = 0;
+
+	//The gap now sits above, merged with the free block after it if any
+	if (next && next->free)
+	{
+		list_remove(next);
+		gap += next->size;
+	}
+
+	pool_block_t *rest = (pool_block_t*)((unsigned char*)moved + size);
+	rest->prev_size = size;
+	set_size(rest, gap);
+	list_insert(rest);
+
+	return (unsigned char*)moved + POOL_GRANULE;
+}
+
+void pool_stats(dlpoolstats_t *stats)
+{
+	memset(stats, 0, sizeof(dlpoolstats_t));
+	stats->size = pool_size;
+	stats->used = pool_used;
+	stats->heap_fallbacks = heap_fallbacks;
+	merge_stats(&stats->merge_pooled, &stats->merge_saved);
+
+	for (int c = 0; c < POOL_CLASSES; ++c)
+	{
+		for (pool_block_t *block = free_lists[c]; block; block = block->next)
+		{
+			size_t usable = block->size - POOL_GRANULE;
+			stats->free += usable;
+			++stats->free_blocks;
+			if (usable > stats->largest_free) stats->largest_free = usable;
+		}
+	}
+
+	//Share of free memory unusable for a single allocation, in thousandths
+	if (stats->free)
+		stats->fragmentation = 1000 - (unsigned)((unsigned long long)stats->largest_free * 1000 / stats->free);
+}
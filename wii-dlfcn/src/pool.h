@@ -0,0 +1,28 @@
+#ifndef POOL_H_
+#define POOL_H_
+
+#include <stddef.h>
+
+#include "dlfcn.h"
+
+//Allocation unit and alignment of module images, one cache line
+#define POOL_GRANULE 32
+
+//Size of the pool reserved from the heap on first use, when dlpoolinit was not called
+#ifndef DL_POOL_SIZE
+#define DL_POOL_SIZE (2 * 1024 * 1024)
+#endif
+
+//Hands mem to the pool, only valid while the pool is empty
+int pool_init(void *mem, size_t size);
+
+//Returns POOL_GRANULE aligned memory, falling back to the heap once the pool is full
+void *pool_alloc(size_t size);
+void pool_free(void *ptr);
+int pool_owns(void *ptr);
+//Moves the block of ptr down over the free block right below it, when that keeps it aligned to align
+//Returns the new address of the contents, ptr if the block did not move
+void *pool_slide(void *ptr, size_t align);
+void pool_stats(dlpoolstats_t *stats);
+
+#endif
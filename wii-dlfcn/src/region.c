@@ -0,0 +1,61 @@
+#include "region.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+void region_init(region_t *region, void *mem, size_t size)
+{
+	region->base = mem;
+	region->size = size;
+	region->used = 0;
+	region->taken = 0;
+}
+
+void *region_aligned(region_t *region, size_t align, size_t size)
+{
+	if (!region)
+		return aligned_alloc(align, (size + align - 1) & ~(align - 1));
+
+	uintptr_t start = ((uintptr_t)region->base + region->used + align - 1) & ~(uintptr_t)(align - 1);
+	size_t offset = start - (uintptr_t)region->base;
+	if (offset > region->size || size > region->size - offset)
+		return NULL;
+
+	region->used = offset + size;
+	return (void*)start;
+}
+
+void *region_alloc(region_t *region, size_t size)
+{
+	if (!region)
+		return malloc(size ? size : 1);
+
+	return region_aligned(region, REGION_ALIGN, size);
+}
+
+void *region_calloc(region_t *region, size_t count, size_t size)
+{
+	if (!region)
+		return calloc(count ? count : 1, size ? size : 1);
+
+	if (size && count > SIZE_MAX / size)
+		return NULL;
+
+	void *ptr = region_alloc(region, count * size);
+	if (ptr) memset(ptr, 0, count * size);
+	return ptr;
+}
+
+void region_free(region_t *region, void *ptr)
+{
+	if (!region) free(ptr);
+}
+
+void region_release(region_t *region)
+{
+	if (!region) return;
+
+	region->used = 0;
+	region->taken = 0;
+}
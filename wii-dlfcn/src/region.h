@@ -0,0 +1,29 @@
+#ifndef REGION_H_
+#define REGION_H_
+
+#include <stddef.h>
+
+//Alignment of every region allocation, enough for any table the loader keeps
+#define REGION_ALIGN 8
+
+//Fixed memory one module allocates from in real-time mode (see dlinit_rt), bumped and never freed piecemeal
+//Every function also takes NULL for the heap, which is what loads outside real-time mode use
+typedef struct {
+	unsigned char *base;
+	size_t size;
+	size_t used;
+	//Held by a module, from elf_rel_create until elf_rel_destroy
+	int taken;
+} region_t;
+
+void region_init(region_t *region, void *mem, size_t size);
+//Same as malloc, calloc and aligned_alloc, NULL once the region is exhausted
+void *region_alloc(region_t *region, size_t size);
+void *region_calloc(region_t *region, size_t count, size_t size);
+void *region_aligned(region_t *region, size_t align, size_t size);
+//Same as free, memory of a region only comes back with region_release
+void region_free(region_t *region, void *ptr);
+//Empties the region and hands it back for the next module
+void region_release(region_t *region);
+
+#endif
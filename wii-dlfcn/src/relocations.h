@@ -6,10 +6,11 @@
 #define RELOCATE_LOW24(buff, addr)  do { *(buff) = (((addr) & 0xFFFFFF) << 2) | (*(buff) & 0xF8000003); } while(0);
 #define RELOCATE_LOW14(buff, addr)  do { *(buff) = (((addr) & 0x3FF) << 2) | (*(buff) & 0xFFFF0003); } while(0);
 #define RELOCATE_HALF16(buff, addr) do { *(buff) = (addr) & 0xFFFF; } while(0);
+#define RELOCATE_LOW21(buff, reg, off) do { *(buff) = (*(buff) & 0xFFE00000) | (((reg) & 0x1F) << 16) | ((off) & 0xFFFF); } while(0);
 
 #define ADDR_LO(addr) ((addr) & 0xFFFF)
 #define ADDR_HI(addr) (((addr) >> 16) & 0xFFFF)
-#define ADDR_HA(addr) ((((addr) >> 16) + ((addr) & 0x8000) ? 1 : 0) & 0xFFFF)
+#define ADDR_HA(addr) ((((addr) >> 16) + (((addr) & 0x8000) ? 1 : 0)) & 0xFFFF)
 
 #define RELOCATE_ADDR32(buff, sym, addend)           do { RELOCATE_WORD32(buff, (sym) + (addend)); } while (0)
 #define RELOCATE_ADDR24(buff, sym, addend)           do { RELOCATE_LOW24(buff, ((sym) + (addend)) >> 2); } while (0)
@@ -48,5 +49,6 @@
 #define RELOCATE_SECTOFF_HI(buff, sectoff, addend)   do { RELOCATE_HALF16(buff, ADDR_HI((sectoff) + (addend))); } while (0)
 #define RELOCATE_SECTOFF_HA(buff, sectoff, addend)   do { RELOCATE_HALF16(buff, ADDR_HA((sectoff) + (addend))); } while (0)
 #define RELOCATE_ADDR30(buff, sym, plt, addend)      do { RELOCATE_WORD30(buff, ((sym) + (addend) - (plt)) >> 2); } while (0)
+#define RELOCATE_EMB_SDA21(buff, sym, addend, reg, base) do { RELOCATE_LOW21(buff, reg, (sym) + (addend) - (base)); } while (0)
 
 #endif
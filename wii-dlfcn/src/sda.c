@@ -0,0 +1,213 @@
+#include "sda.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "relocations.h"
+
+//Room reserved in the host's .sbss/.sbss2 for module small data, in bytes
+#ifndef DL_SDA_ARENA_SIZE
+#define DL_SDA_ARENA_SIZE 4096
+#endif
+#ifndef DL_SDA2_ARENA_SIZE
+#define DL_SDA2_ARENA_SIZE 1024
+#endif
+
+#define SDA_GRANULE 8
+#define SDA_REACH 0x8000
+
+#define SDA_GRANULES (DL_SDA_ARENA_SIZE / SDA_GRANULE)
+#define SDA2_GRANULES (DL_SDA2_ARENA_SIZE / SDA_GRANULE)
+
+//D-form instruction encodings
+#define PPC_OP(insn) ((insn) >> 26)
+#define PPC_RD(insn) (((insn) >> 21) & 0x1F)
+#define PPC_DFORM(op, rd, ra, d) (((uint32_t)(op) << 26) | ((uint32_t)(rd) << 21) | ((uint32_t)(ra) << 16) | ((uint32_t)(d) & 0xFFFF))
+#define PPC_ADDI(rd, ra, d) PPC_DFORM(14, rd, ra, d)
+#define PPC_LIS(rd, d) PPC_DFORM(15, rd, 0, d)
+#define PPC_LWZ(rd, ra, d) PPC_DFORM(32, rd, ra, d)
+#define PPC_STW(rs, ra, d) PPC_DFORM(36, rs, ra, d)
+#define PPC_STWU(rs, ra, d) PPC_DFORM(37, rs, ra, d)
+#define PPC_NOP 0x60000000
+
+typedef struct {
+	unsigned char *mem;
+	uint32_t *bitmap;
+	size_t granules;
+} sda_arena_t;
+
+#ifdef GEKKO
+extern char _SDA_BASE_[];
+extern char _SDA2_BASE_[];
+
+static unsigned char sda_mem[DL_SDA_ARENA_SIZE] __attribute__((section(".sbss"), aligned(32)));
+static unsigned char sda2_mem[DL_SDA2_ARENA_SIZE] __attribute__((section(".sbss2"), aligned(32)));
+static uint32_t sda_bitmap[(SDA_GRANULES + 31) / 32];
+static uint32_t sda2_bitmap[(SDA2_GRANULES + 31) / 32];
+
+static sda_arena_t arenas[2] = {
+	{ sda_mem, sda_bitmap, SDA_GRANULES },
+	{ sda2_mem, sda2_bitmap, SDA2_GRANULES },
+};
+#else
+//Host builds have no small data area to share
+static sda_arena_t arenas[2] = { { NULL, NULL, 0 }, { NULL, NULL, 0 } };
+#endif
+
+static sda_arena_t *arena_of(int reg)
+{
+	if (reg == 13) return &arenas[0];
+	if (reg == 2) return &arenas[1];
+	return NULL;
+}
+
+static int granule_used(sda_arena_t *arena, size_t g)
+{
+	return (arena->bitmap[g / 32] >> (g % 32)) & 1;
+}
+
+static void granules_set(sda_arena_t *arena, size_t first, size_t count, int used)
+{
+	for (size_t g = first; g < first + count; ++g)
+	{
+		if (used) arena->bitmap[g / 32] |= 1u << (g % 32);
+		else arena->bitmap[g / 32] &= ~(1u << (g % 32));
+	}
+}
+
+int sda_section_reg(const char *name)
+{
+	if (!strncmp(name, ".sdata2", 7) || !strncmp(name, ".sbss2", 6))
+		return 2;
+	if (!strncmp(name, ".sdata", 6) || !strncmp(name, ".sbss", 5))
+		return 13;
+	return 0;
+}
+
+uint32_t sda_base(int reg)
+{
+#ifdef GEKKO
+	if (reg == 13) return (uint32_t)(uintptr_t)_SDA_BASE_;
+	if (reg == 2) return (uint32_t)(uintptr_t)_SDA2_BASE_;
+#else
+	(void)reg;
+#endif
+	return 0;
+}
+
+int sda_reachable(uint32_t addr, int reg)
+{
+	int32_t off = (int32_t)(addr - sda_base(reg));
+	return off >= -SDA_REACH && off < SDA_REACH;
+}
+
+int sda_pick_reg(uint32_t addr)
+{
+	if (sda_reachable(addr, 13)) return 13;
+	if (sda_reachable(addr, 2)) return 2;
+	if (sda_reachable(addr, 0)) return 0;
+	return -1;
+}
+
+void *sda_alloc(int reg, size_t size, size_t align)
+{
+	sda_arena_t *arena = arena_of(reg);
+	if (!arena || !arena->granules || !size) return NULL;
+
+	size_t need = (size + SDA_GRANULE - 1) / SDA_GRANULE;
+	size_t step = align > SDA_GRANULE ? align / SDA_GRANULE : 1;
+
+	//First fit over aligned granules
+	for (size_t first = 0; first + need <= arena->granules; first += step)
+	{
+		size_t g = first;
+		while (g < first + need && !granule_used(arena, g)) ++g;
+		if (g != first + need) continue;
+
+		unsigned char *ptr = arena->mem + first * SDA_GRANULE;
+		uint32_t start = (uint32_t)(uintptr_t)ptr;
+		if (!sda_reachable(start, reg) || !sda_reachable(start + size - 1, reg))
+			continue;
+
+		granules_set(arena, first, need, 1);
+		return ptr;
+	}
+
+	return NULL;
+}
+
+int sda_owns(void *ptr)
+{
+	for (int i = 0; i < 2; ++i)
+	{
+		unsigned char *mem = arenas[i].mem;
+		if (mem && (unsigned char*)ptr >= mem && (unsigned char*)ptr < mem + arenas[i].granules * SDA_GRANULE)
+			return 1;
+	}
+	return 0;
+}
+
+void sda_free(void *ptr, size_t size)
+{
+	for (int i = 0; i < 2; ++i)
+	{
+		sda_arena_t *arena = &arenas[i];
+		unsigned char *mem = arena->mem;
+		if (!mem || (unsigned char*)ptr < mem || (unsigned char*)ptr >= mem + arena->granules * SDA_GRANULE)
+			continue;
+
+		size_t first = ((unsigned char*)ptr - mem) / SDA_GRANULE;
+		granules_set(arena, first, (size + SDA_GRANULE - 1) / SDA_GRANULE, 0);
+		return;
+	}
+}
+
+static int ppc_branch(uint32_t *from, uint32_t *to, uint32_t *out)
+{
+	int32_t delta = (int32_t)((uintptr_t)to - (uintptr_t)from);
+	if (delta < -0x2000000 || delta >= 0x2000000)
+		return 0;
+
+	*out = (18u << 26) | ((uint32_t)delta & 0x03FFFFFC);
+	return 1;
+}
+
+int sda_build_trampoline(uint32_t *stub, uint32_t *insn, uint32_t addr)
+{
+	uint32_t op = PPC_OP(*insn);
+	uint32_t rd = PPC_RD(*insn);
+	uint32_t lo = ADDR_LO(addr);
+	uint32_t ha = ADDR_HA(addr);
+	uint32_t branch_to, branch_back;
+	int n = 0;
+
+	//Only D-form loads, stores and addi can be rebased (no update or multiple forms)
+	if (op != 14 && (op < 32 || op > 54 || (op & 1) || op == 46))
+		return 0;
+
+	//GPR loads and addi can use their own target as the base register
+	if ((op == 14 || op == 32 || op == 34 || op == 40 || op == 42) && rd != 0)
+	{
+		stub[n++] = PPC_LIS(rd, ha);
+		stub[n++] = (*insn & 0xFFE00000) | (rd << 16) | lo;
+	}
+	else //Otherwise borrow a scratch register from the stack
+	{
+		uint32_t rt = rd == 12 ? 11 : 12;
+		stub[n++] = PPC_STWU(1, 1, -16);
+		stub[n++] = PPC_STW(rt, 1, 8);
+		stub[n++] = PPC_LIS(rt, ha);
+		stub[n++] = (*insn & 0xFFE00000) | (rt << 16) | lo;
+		stub[n++] = PPC_LWZ(rt, 1, 8);
+		stub[n++] = PPC_ADDI(1, 1, 16);
+	}
+
+	if (!ppc_branch(&stub[n], insn + 1, &branch_back) || !ppc_branch(insn, stub, &branch_to))
+		return 0;
+
+	stub[n++] = branch_back;
+	while (n < SDA_TRAMPOLINE_WORDS) stub[n++] = PPC_NOP;
+	*insn = branch_to;
+
+	return 1;
+}
@@ -0,0 +1,26 @@
+#ifndef SDA_H_
+#define SDA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+//Words per far access stub, one cache line
+#define SDA_TRAMPOLINE_WORDS 8
+
+//Returns the base register (13 or 2) a section is addressed from, 0 if not small data
+int sda_section_reg(const char *name);
+//Returns the value held by the base register reg (13, 2 or 0)
+uint32_t sda_base(int reg);
+//Returns the base register that can reach addr with a signed 16-bit offset, -1 if none
+int sda_pick_reg(uint32_t addr);
+int sda_reachable(uint32_t addr, int reg);
+
+//Allocates from the arena reserved in the host's small data area for base register reg
+void *sda_alloc(int reg, size_t size, size_t align);
+int sda_owns(void *ptr);
+void sda_free(void *ptr, size_t size);
+
+//Redirects the small data access at insn through stub so it can reach addr
+int sda_build_trampoline(uint32_t *stub, uint32_t *insn, uint32_t addr);
+
+#endif
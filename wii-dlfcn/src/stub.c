@@ -0,0 +1,80 @@
+#include "stub.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "relocations.h"
+
+#ifdef GEKKO
+#include <ogc/cache.h>
+#endif
+
+//D-form and branch encodings used by the stub code
+#define PPC_DFORM(op, rd, ra, d) (((uint32_t)(op) << 26) | ((uint32_t)(rd) << 21) | ((uint32_t)(ra) << 16) | ((uint32_t)(d) & 0xFFFF))
+#define PPC_ADDI(rd, ra, d) PPC_DFORM(14, rd, ra, d)
+#define PPC_LIS(rd, d) PPC_DFORM(15, rd, 0, d)
+#define PPC_LWZ(rd, ra, d) PPC_DFORM(32, rd, ra, d)
+#define PPC_STW(rs, ra, d) PPC_DFORM(36, rs, ra, d)
+#define PPC_B(offset) (0x48000000 | ((uint32_t)(offset) & 0x03FFFFFC))
+#define PPC_MTCTR(rs) (0x7C0903A6 | ((uint32_t)(rs) << 21))
+#define PPC_BCTR 0x4E800420
+
+void counter_stub_write(uint32_t *stub, void *target)
+{
+	uint32_t counter = (uint32_t)(uintptr_t)&stub[COUNTER_STUB_WORDS - 1];
+	uint32_t branch = (uint32_t)(uintptr_t)&stub[4];
+
+	stub[0] = PPC_LIS(11, ADDR_HA(counter));
+	stub[1] = PPC_LWZ(12, 11, ADDR_LO(counter));
+	stub[2] = PPC_ADDI(12, 12, 1);
+	stub[3] = PPC_STW(12, 11, ADDR_LO(counter));
+	stub[4] = PPC_B((uint32_t)(uintptr_t)target - branch);
+	stub[5] = 0;
+}
+
+#if STUB_SUPPORTED
+
+stub_t *stub_create(void *owner, const char *name)
+{
+	stub_t *stub = malloc(sizeof(stub_t));
+	if (!stub) return NULL;
+
+	stub->name = strdup(name);
+	if (!stub->name)
+	{
+		free(stub);
+		return NULL;
+	}
+
+	stub->owner = owner;
+	stub->next = NULL;
+	stub->target = (void*)stub_reload;
+
+	//r11 keeps the stub for stub_reload, the target is data so rebinding needs no cache maintenance
+	uint32_t addr = (uint32_t)(uintptr_t)stub;
+	stub->code[0] = PPC_LIS(11, ADDR_HA(addr));
+	stub->code[1] = PPC_ADDI(11, 11, ADDR_LO(addr));
+	stub->code[2] = PPC_LWZ(12, 11, offsetof(stub_t, target));
+	stub->code[3] = PPC_MTCTR(12);
+	stub->code[4] = PPC_BCTR;
+
+#ifdef GEKKO
+	DCFlushRange(stub->code, sizeof(stub->code));
+	ICInvalidateRange(stub->code, sizeof(stub->code));
+#endif
+	return stub;
+}
+
+void stub_destroy(stub_t *stub)
+{
+	free(stub->name);
+	free(stub);
+}
+
+void stub_bind(stub_t *stub, void *target)
+{
+	__atomic_store_n(&stub->target, target ? target : (void*)stub_reload, __ATOMIC_RELEASE);
+}
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef STUB_H_
+#define STUB_H_
+
+#include <stdint.h>
+
+//Words of code at the start of every stub
+#define STUB_CODE_WORDS 5
+
+//Stubs need PowerPC code, host builds bind straight to functions instead
+#ifdef GEKKO
+#define STUB_SUPPORTED 1
+#else
+#define STUB_SUPPORTED 0
+#endif
+
+//Stable entry point of a function in a module that may be evicted
+//Calls jump through target, the function while its module is resident, stub_reload otherwise
+typedef struct stub {
+	uint32_t code[STUB_CODE_WORDS];
+	void *target;
+	void *owner;
+	char *name;
+	struct stub *next;
+} stub_t;
+
+//Returns a stub for name in owner, unbound (calls reach stub_resolve), NULL on error
+stub_t *stub_create(void *owner, const char *name);
+void stub_destroy(stub_t *stub);
+//Sends calls to target, or back to stub_resolve when target is NULL
+void stub_bind(stub_t *stub, void *target);
+
+//Words of a call counting stub (dlcountcalls), the last one holds the count
+#define COUNTER_STUB_WORDS 6
+
+//Writes a stub counting its calls then branching on to target, which must be in reach of a relative branch
+//Uses r11 and r12, free at calls, callers flush the caches
+void counter_stub_write(uint32_t *stub, void *target);
+static inline uint32_t counter_stub_count(const uint32_t *stub)
+{
+	return __atomic_load_n(&stub[COUNTER_STUB_WORDS - 1], __ATOMIC_RELAXED);
+}
+
+//Entry of unbound stubs (stub_entry.s), keeps the arguments while stub_resolve runs
+//r11 <= stub
+extern void stub_reload(void);
+//Provided by the loader, makes the stub's module resident and returns the function to go on into
+void *stub_resolve(stub_t *stub);
+
+#endif
@@ -0,0 +1,62 @@
+	.global stub_reload
+	.text
+
+# Frame: back chain, callee LR slot, r3-r10, cr, f1-f8
+	.set FRAME, 112
+	.set GPRS, 8
+	.set CR, 40
+	.set FPRS, 48
+
+# void stub_reload(...)
+# r11 <= stub
+# Arguments are kept aside while stub_resolve loads the module again, then the
+# call goes on into the function as if the stub had jumped there directly
+stub_reload:
+	stwu 1, -FRAME(1)    # new frame
+	mflr 0
+	stw 0, FRAME+4(1)    # caller's return address
+	mfcr 0
+	stw 0, CR(1)         # cr1 tells varargs functions about fp arguments
+	stw 3, GPRS+0(1)     # integer arguments
+	stw 4, GPRS+4(1)
+	stw 5, GPRS+8(1)
+	stw 6, GPRS+12(1)
+	stw 7, GPRS+16(1)
+	stw 8, GPRS+20(1)
+	stw 9, GPRS+24(1)
+	stw 10, GPRS+28(1)
+	stfd 1, FPRS+0(1)    # floating point arguments
+	stfd 2, FPRS+8(1)
+	stfd 3, FPRS+16(1)
+	stfd 4, FPRS+24(1)
+	stfd 5, FPRS+32(1)
+	stfd 6, FPRS+40(1)
+	stfd 7, FPRS+48(1)
+	stfd 8, FPRS+56(1)
+
+	mr 3, 11             # r3 <- stub
+	bl stub_resolve      # r3 <- function
+	mtctr 3
+
+	lfd 1, FPRS+0(1)
+	lfd 2, FPRS+8(1)
+	lfd 3, FPRS+16(1)
+	lfd 4, FPRS+24(1)
+	lfd 5, FPRS+32(1)
+	lfd 6, FPRS+40(1)
+	lfd 7, FPRS+48(1)
+	lfd 8, FPRS+56(1)
+	lwz 3, GPRS+0(1)
+	lwz 4, GPRS+4(1)
+	lwz 5, GPRS+8(1)
+	lwz 6, GPRS+12(1)
+	lwz 7, GPRS+16(1)
+	lwz 8, GPRS+20(1)
+	lwz 9, GPRS+24(1)
+	lwz 10, GPRS+28(1)
+	lwz 0, CR(1)
+	mtcrf 0xff, 0
+	lwz 0, FRAME+4(1)
+	mtlr 0
+	addi 1, 1, FRAME     # drop frame
+	bctr                 # into the function, returning straight to the caller
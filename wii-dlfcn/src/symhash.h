@@ -0,0 +1,23 @@
+#ifndef SYMHASH_H_
+#define SYMHASH_H_
+
+#include <stdint.h>
+
+//Seeded FNV-1a with a final avalanche, shared by the loader and host tools
+static inline uint32_t sym_hash(const char *name, uint32_t seed)
+{
+	uint32_t h = 0x811C9DC5u ^ (seed * 0x9E3779B9u);
+
+	while (*name)
+	{
+		h ^= (unsigned char)*name++;
+		h *= 0x01000193u;
+	}
+
+	h ^= h >> 16;
+	h *= 0x85EBCA6Bu;
+	h ^= h >> 13;
+	return h;
+}
+
+#endif
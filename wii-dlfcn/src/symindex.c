@@ -0,0 +1,60 @@
+#include "symindex.h"
+
+#include <string.h>
+
+#include "symhash.h"
+
+size_t symindex_slots(size_t count)
+{
+	size_t slots = 8;
+	while (slots < 2 * count)
+		slots *= 2;
+	return slots;
+}
+
+int symindex_init(symindex_t *index, const symtab_t *tab, region_t *region)
+{
+	size_t slots = symindex_slots(tab->count);
+	index->tab = tab;
+	index->slots = region_calloc(region, slots, sizeof(uint32_t));
+	index->mask = index->slots ? slots - 1 : 0;
+	return index->slots != NULL;
+}
+
+void symindex_free(symindex_t *index, region_t *region)
+{
+	region_free(region, index->slots);
+	index->slots = NULL;
+	index->mask = 0;
+}
+
+//Slot holding name, or the empty slot it would go in
+static uint32_t symindex_probe(const symindex_t *index, const char *name, uint32_t hash)
+{
+	const symtab_t *tab = index->tab;
+	uint32_t i = hash & index->mask;
+	for (; index->slots[i]; i = (i + 1) & index->mask)
+	{
+		size_t row = index->slots[i] - 1;
+		if (tab->hashes[row] == hash && !strcmp(symtab_name(tab, row), name))
+			break;
+	}
+
+	return i;
+}
+
+size_t symindex_get(const symindex_t *index, const char *name)
+{
+	if (!index->slots) return SYMTAB_NONE;
+
+	uint32_t slot = index->slots[symindex_probe(index, name, sym_hash(name, 0))];
+	return slot ? slot - 1 : SYMTAB_NONE;
+}
+
+void symindex_add(symindex_t *index, size_t row)
+{
+	const symtab_t *tab = index->tab;
+	uint32_t i = symindex_probe(index, symtab_name(tab, row), tab->hashes[row]);
+	if (!index->slots[i])
+		index->slots[i] = row + 1;
+}
@@ -0,0 +1,29 @@
+#ifndef SYMINDEX_H_
+#define SYMINDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "region.h"
+#include "symtab.h"
+
+//Rows of a symbol table by name, open addressing sized once for the table's count
+//Kept at most half full so a lookup probes a few slots whatever the names, names are only compared on equal hashes
+typedef struct {
+	const symtab_t *tab;
+	//Row + 1, 0 for an empty slot
+	uint32_t *slots;
+	uint32_t mask;
+} symindex_t;
+
+//Slots symindex_init takes for count symbols, for sizing fixed memory
+size_t symindex_slots(size_t count);
+int symindex_init(symindex_t *index, const symtab_t *tab, region_t *region);
+void symindex_free(symindex_t *index, region_t *region);
+
+//Row of the symbol, SYMTAB_NONE if there is none
+size_t symindex_get(const symindex_t *index, const char *name);
+//Adds the row unless a symbol of the same name is there
+void symindex_add(symindex_t *index, size_t row);
+
+#endif
@@ -0,0 +1,111 @@
+#include "symtab.h"
+
+#include <string.h>
+
+#include "data.h"
+
+//Columns are laid out widest first, so each one is aligned after the previous
+#define SYMTAB_ROW (sizeof(Elf32_Addr) + sizeof(void*) + 2 * sizeof(uint32_t) + sizeof(Elf32_Half) + 1)
+#define RELTAB_ROW (sizeof(void*) + sizeof(Elf32_Off) + sizeof(Elf32_Sword) + sizeof(uint32_t) + sizeof(Elf32_Half) + 1)
+
+size_t symtab_bytes(size_t count)
+{
+	return count * SYMTAB_ROW;
+}
+
+size_t reltab_bytes(size_t count)
+{
+	return count * RELTAB_ROW;
+}
+
+int symtab_init(symtab_t *tab, region_t *region, size_t count, const char *strs, const char *sect_strs)
+{
+	memset(tab, 0, sizeof(symtab_t));
+	char *column = region_alloc(region, symtab_bytes(count));
+	if (!column) return 0;
+
+	tab->addresses = (void**)column;
+	column += count * sizeof(void*);
+	tab->values = (Elf32_Addr*)column;
+	column += count * sizeof(Elf32_Addr);
+	tab->hashes = (uint32_t*)column;
+	column += count * sizeof(uint32_t);
+	tab->names = (uint32_t*)column;
+	column += count * sizeof(uint32_t);
+	tab->sections = (Elf32_Half*)column;
+	column += count * sizeof(Elf32_Half);
+	tab->info = (unsigned char*)column;
+
+	tab->strs = strs;
+	tab->sect_strs = sect_strs;
+	return 1;
+}
+
+void symtab_free(symtab_t *tab, region_t *region)
+{
+	//Every column is part of the first one's allocation
+	region_free(region, tab->addresses);
+	memset(tab, 0, sizeof(symtab_t));
+}
+
+size_t symtab_next(const symtab_t *tab, const char *name, uint32_t hash, size_t from)
+{
+	for (size_t i = from; i < tab->count; ++i)
+	{
+		if (tab->hashes[i] == hash && !strcmp(symtab_name(tab, i), name))
+			return i;
+	}
+
+	return SYMTAB_NONE;
+}
+
+int reltab_init(reltab_t *tab, region_t *region, size_t count, const char *strs, const char *sect_strs)
+{
+	memset(tab, 0, sizeof(reltab_t));
+	char *column = region_alloc(region, reltab_bytes(count));
+	if (!column) return 0;
+
+	tab->resolved = (void**)column;
+	column += count * sizeof(void*);
+	tab->offsets = (Elf32_Off*)column;
+	column += count * sizeof(Elf32_Off);
+	tab->addends = (Elf32_Sword*)column;
+	column += count * sizeof(Elf32_Sword);
+	tab->names = (uint32_t*)column;
+	column += count * sizeof(uint32_t);
+	tab->sections = (Elf32_Half*)column;
+	column += count * sizeof(Elf32_Half);
+	tab->types = (unsigned char*)column;
+
+	tab->strs = strs;
+	tab->sect_strs = sect_strs;
+	return 1;
+}
+
+void reltab_free(reltab_t *tab, region_t *region)
+{
+	region_free(region, tab->resolved);
+	memset(tab, 0, sizeof(reltab_t));
+}
+
+void reltab_store(reltab_t *tab, const rel_symbol_t *rel)
+{
+	size_t i = tab->count++;
+	tab->resolved[i] = rel->resolved;
+	tab->offsets[i] = rel->offset;
+	tab->addends[i] = rel->addend;
+	tab->names[i] = rel->name_ref;
+	tab->sections[i] = rel->section;
+	tab->types[i] = rel->rel_type;
+}
+
+void reltab_load(const reltab_t *tab, size_t i, rel_symbol_t *rel)
+{
+	rel->name_ref = tab->names[i];
+	rel->name = (char*)symtab_string(tab->strs, tab->sect_strs, tab->names[i]);
+	rel->offset = tab->offsets[i];
+	rel->addend = tab->addends[i];
+	rel->section = tab->sections[i];
+	rel->rel_type = tab->types[i];
+	rel->resolved = tab->resolved[i];
+}
@@ -0,0 +1,73 @@
+#ifndef SYMTAB_H_
+#define SYMTAB_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "elf.h"
+#include "region.h"
+
+//Names are kept as offsets into the symbol strings, or into the section name strings with this bit set
+#define SYMTAB_SECT_NAME 0x80000000u
+//Row returned by lookups finding nothing
+#define SYMTAB_NONE ((size_t)-1)
+
+struct rel_symbol;
+
+//Symbols of a module or the host as columns, row i of each being symbol i
+//Sized once from the symbol table, scans read the hash column and only compare names on a match
+typedef struct {
+	size_t count;
+	//st_value as read, and where the symbol is once placed (NULL when not loaded or unresolved)
+	Elf32_Addr *values;
+	void **addresses;
+	//sym_hash(name, 0)
+	uint32_t *hashes;
+	uint32_t *names;
+	Elf32_Half *sections;
+	//st_info as read, see ELF32_ST_BIND and ELF32_ST_TYPE
+	unsigned char *info;
+	const char *strs;
+	const char *sect_strs;
+} symtab_t;
+
+//Relocations retained for re-applying them (see dlretainrelocs), names as in symtab_t
+typedef struct {
+	size_t count;
+	void **resolved;
+	Elf32_Off *offsets;
+	Elf32_Sword *addends;
+	uint32_t *names;
+	Elf32_Half *sections;
+	unsigned char *types;
+	const char *strs;
+	const char *sect_strs;
+} reltab_t;
+
+static inline const char *symtab_string(const char *strs, const char *sect_strs, uint32_t name)
+{
+	return name & SYMTAB_SECT_NAME ? &sect_strs[name & ~SYMTAB_SECT_NAME] : &strs[name];
+}
+
+static inline const char *symtab_name(const symtab_t *tab, size_t i)
+{
+	return symtab_string(tab->strs, tab->sect_strs, tab->names[i]);
+}
+
+//Bytes symtab_init and reltab_init take for count rows, for sizing fixed memory
+size_t symtab_bytes(size_t count);
+size_t reltab_bytes(size_t count);
+
+//Both take a single allocation for every column, the rows are left for the caller to fill
+int symtab_init(symtab_t *tab, region_t *region, size_t count, const char *strs, const char *sect_strs);
+void symtab_free(symtab_t *tab, region_t *region);
+//Next row from row from on named name (hashed with sym_hash), SYMTAB_NONE past the last one
+size_t symtab_next(const symtab_t *tab, const char *name, uint32_t hash, size_t from);
+
+//Rows are appended by reltab_store, up to count
+int reltab_init(reltab_t *tab, region_t *region, size_t count, const char *strs, const char *sect_strs);
+void reltab_free(reltab_t *tab, region_t *region);
+void reltab_store(reltab_t *tab, const struct rel_symbol *rel);
+void reltab_load(const reltab_t *tab, size_t i, struct rel_symbol *rel);
+
+#endif
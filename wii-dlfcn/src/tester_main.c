@@ -1,4 +1,5 @@
 #include "dlfcn.h"
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,17 +9,242 @@
 #include <wiiuse/wpad.h>
 #include <fat.h>
 #include <debug.h>
+#include <ogc/lwp_watchdog.h>
+
+#include "memops.h"
+
+//Large enough to stand for a big .bss or .rodata, well past the 32KiB data cache
+#define BENCH_SIZE (1024 * 1024)
 
 static void dbg_wait(int frames)
 {
 	while (frames--) VIDEO_WaitVSync();
 }
 
+static unsigned bench_us(uint64_t start)
+{
+	return (unsigned)ticks_to_microsecs(gettime() - start);
+}
+
+//Section loading kernels against the libc routines, on line aligned buffers like the module pool hands out
+static void bench_memops()
+{
+	unsigned char *dest = aligned_alloc(32, BENCH_SIZE);
+	unsigned char *src = aligned_alloc(32, BENCH_SIZE);
+	if (!dest || !src)
+	{
+		printf("bench: out of memory\n");
+		free(dest); free(src);
+		return;
+	}
+	memset(src, 0xA5, BENCH_SIZE);
+
+	uint64_t start = gettime();
+	memset(dest, 0, BENCH_SIZE);
+	unsigned memset_us = bench_us(start);
+
+	start = gettime();
+	dl_zero(dest, BENCH_SIZE);
+	unsigned zero_us = bench_us(start);
+
+	start = gettime();
+	memcpy(dest, src, BENCH_SIZE);
+	unsigned memcpy_us = bench_us(start);
+
+	start = gettime();
+	dl_copy(dest, src, BENCH_SIZE);
+	unsigned copy_us = bench_us(start);
+
+	printf("bench %u KiB: memset %uus dl_zero %uus, memcpy %uus dl_copy %uus%s\n", BENCH_SIZE / 1024,
+		memset_us, zero_us, memcpy_us, copy_us, memcmp(dest, src, BENCH_SIZE) ? " (copy MISMATCH)" : "");
+
+	free(dest);
+	free(src);
+}
+
+//30 modules loaded one file each, then from one pack of the same files
+//Build with: dlpack -o bench.pack bench/mod00.o ... bench/mod29.o
+#define BENCH_MODULES 30
+#define BENCH_DIR "/apps/wii-dlfcn-test/bench"
+
+static void bench_pack()
+{
+	void *handles[BENCH_MODULES];
+	char path[64];
+
+	dl_pack_t *pack = dlpackopen(BENCH_DIR ".pack");
+	if (!pack)
+	{
+		printf("bench: no pack (%s), skipped\n", dlerror());
+		return;
+	}
+
+	uint64_t start = gettime();
+	int loaded = 0;
+	for (; loaded < BENCH_MODULES; ++loaded)
+	{
+		snprintf(path, sizeof(path), BENCH_DIR "/mod%02d.o", loaded);
+		if (!(handles[loaded] = dlopen(path, 0))) break;
+	}
+	unsigned loose_us = bench_us(start);
+	while (loaded) dlclose(handles[--loaded]);
+
+	start = gettime();
+	for (; loaded < BENCH_MODULES; ++loaded)
+	{
+		snprintf(path, sizeof(path), "mod%02d.o", loaded);
+		if (!(handles[loaded] = dlopen_pack(pack, path, 0))) break;
+	}
+	unsigned pack_us = bench_us(start);
+	int packed = loaded;
+	while (loaded) dlclose(handles[--loaded]);
+	dlpackclose(pack);
+
+	if (packed < BENCH_MODULES)
+		printf("bench: module %d failed: %s\n", packed, dlerror());
+	printf("bench %d modules: loose files %uus, pack %uus\n", BENCH_MODULES, loose_us, pack_us);
+}
+
+//The same 30 modules loaded one dlopen at a time, then as one batch
+static void bench_many()
+{
+	void *handles[BENCH_MODULES];
+	char paths[BENCH_MODULES][64];
+	const char *files[BENCH_MODULES];
+
+	for (int i = 0; i < BENCH_MODULES; ++i)
+	{
+		snprintf(paths[i], sizeof(paths[i]), BENCH_DIR "/mod%02d.o", i);
+		files[i] = paths[i];
+	}
+
+	uint64_t start = gettime();
+	int loaded = 0;
+	for (; loaded < BENCH_MODULES; ++loaded)
+	{
+		if (!(handles[loaded] = dlopen(files[loaded], 0))) break;
+	}
+	unsigned sequential_us = bench_us(start);
+	int failed = loaded;
+	while (loaded) dlclose(handles[--loaded]);
+
+	if (failed < BENCH_MODULES)
+	{
+		printf("bench: no %s (%s), skipped\n", files[failed], dlerror());
+		return;
+	}
+
+	start = gettime();
+	if (dlopen_many(files, BENCH_MODULES, 0, handles))
+	{
+		printf("bench: dlopen_many failed: %s\n", dlerror());
+		return;
+	}
+	unsigned many_us = bench_us(start);
+	for (int i = 0; i < BENCH_MODULES; ++i) dlclose(handles[i]);
+
+	printf("bench %d modules: sequential dlopen %uus, dlopen_many %uus\n", BENCH_MODULES, sequential_us, many_us);
+}
+
+//The same module with and without small data, see bench/sda_bench.c
+#define SDA_PASSES 1000
+//Longest sda_step is expected to be, the scan stops at its blr
+#define SDA_MAX_WORDS 256
+
+typedef struct {
+	//Instructions of sda_step up to and including its blr
+	unsigned insns;
+	//Loads and stores of globals, with the lis setting up their base
+	unsigned accesses;
+	unsigned lis;
+	//Accesses rebased through a trampoline, a branch there and back
+	unsigned stubbed;
+} sda_count_t;
+
+//Counts the instructions sda_step was relocated to, reading the words the loader wrote
+static int count_sda_step(const uint32_t *code, sda_count_t *count)
+{
+	//Registers last written by a lis, their D-form uses reach a global through a lis pair
+	uint32_t lis_regs = 0;
+	memset(count, 0, sizeof(sda_count_t));
+
+	for (int i = 0; i < SDA_MAX_WORDS; ++i)
+	{
+		uint32_t insn = code[i], op = insn >> 26, rd = (insn >> 21) & 0x1F, ra = (insn >> 16) & 0x1F;
+		++count->insns;
+		if (insn == 0x4E800020)
+			return 1;
+
+		if (op == 15 && ra == 0)
+		{
+			++count->lis;
+			lis_regs |= 1u << rd;
+			continue;
+		}
+
+		//Small data is addressed from r13 or r2, the rest from a lis
+		int dform = op == 14 || (op >= 32 && op <= 55);
+		if (dform && (ra == 13 || ra == 2 || (lis_regs & (1u << ra))))
+			++count->accesses;
+		else if (op == 18 && !(insn & 1))
+			++count->stubbed;
+
+		//Stores and floating point loads leave the GPRs alone, anything else may overwrite rd
+		if (!(op >= 36 && op <= 47) && !(op >= 48 && op <= 55))
+			lis_regs &= ~(1u << rd);
+	}
+
+	return 0;
+}
+
+static void bench_sda()
+{
+	static const char *const files[2] = { BENCH_DIR "/sda_on.o", BENCH_DIR "/sda_off.o" };
+	sda_count_t counts[2];
+	int results[2];
+
+	for (int i = 0; i < 2; ++i)
+	{
+		void *handle = dlopen(files[i], 0);
+		void *func = handle ? dlsym(handle, "sda_bench") : NULL;
+		void *step = handle ? dlsym(handle, "sda_step") : NULL;
+		if (!func || !step)
+		{
+			printf("bench: no %s (%s), skipped\n", files[i], dlerror());
+			if (handle) dlclose(handle);
+			return;
+		}
+
+		int counted = count_sda_step(step, &counts[i]);
+		results[i] = ((int (*)(int))func)(SDA_PASSES);
+		dlclose(handle);
+		if (!counted)
+		{
+			printf("bench: sda_step of %s has no blr in %d words, skipped\n", files[i], SDA_MAX_WORDS);
+			return;
+		}
+	}
+
+	for (int i = 0; i < 2; ++i)
+	{
+		//Hundredths of an instruction each access takes, its lis shared out
+		const sda_count_t *c = &counts[i];
+		unsigned per_access = c->accesses ? (c->accesses + c->lis) * 100 / c->accesses : 0;
+		printf("bench sda %s: sda_step %u instructions, %u global accesses, %u lis, %u through stubs, %u.%02u instructions per access\n",
+			i ? "lis pairs" : "r13 relative", c->insns, c->accesses, c->lis, c->stubbed, per_access / 100, per_access % 100);
+	}
+
+	printf("bench sda: %d instructions saved per call%s\n", (int)counts[1].insns - (int)counts[0].insns,
+		results[0] != results[1] ? " (result MISMATCH)" : "");
+}
+
 void test()
 {
 	int result;
 
-	result = dlinit("/apps/wii-dlfcn-test/boot.elf");
+	result = dlinit_static();
+	if (result)
+		result = dlinit("/apps/wii-dlfcn-test/boot.elf");
 	if (result)
 	{
 		printf("dlinit failed: %s\n", dlerror());
@@ -26,6 +252,10 @@ void test()
 	}
 	printf("dlinit success\n");
 
+	bench_pack();
+	bench_many();
+	bench_sda();
+
 	dbg_wait(30);
 
 	void *handle = dlopen("/apps/wii-dlfcn-test/main.o", 0);
@@ -36,6 +266,10 @@ void test()
 	}
 	printf("dlopen success\n");
 
+	dlstats_t stats;
+	if (!dlstats(handle, &stats))
+		printf("resident %u bytes, %u collected\n", (unsigned)stats.bytes_resident, (unsigned)stats.bytes_collected);
+
 	dbg_wait(30);
 
 	void *func = dlsym(handle, "print_ptr");
@@ -96,6 +330,7 @@ int main()
 		return 1;
 	}
 
+	bench_memops();
 	test();
 
 	while(++frames < 300)
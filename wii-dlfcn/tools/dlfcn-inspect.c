@@ -0,0 +1,548 @@
+//Reports whether a module will load against a host executable, and what loading it costs
+//Parses the module with the loader's own code, so the figures follow the loader as it changes
+//Usage: dlfcn-inspect [options] module.o
+//  --host boot.elf   resolve imports and branch distances against the host executable
+//  --roots a,b,c     load only what these symbols reach, as dlopen_roots does
+//  --base 0xADDR     address the module is expected at (default: end of the host image)
+//  --model file      load time model, one "name value" per line (see model_t)
+//  --json            machine readable output
+//Exits with 0 if the module loads, 2 if it would not, 1 on error
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <sus/ivector.h>
+
+#include "data.h"
+#include "elf.h"
+#include "elfparse.h"
+#include "ioplan.h"
+#include "sda.h"
+
+#define MAX_LINE 256
+//Reach of branches patched by R_PPC_REL24 and R_PPC_REL14*
+#define REL24_REACH 0x2000000
+#define REL14_REACH 0x8000
+#define REL_TYPES 256
+
+//Time taken by each step of a load, in microseconds
+//Defaults are rough figures for libfat on the front SD slot: calibrate them against
+//dlstats and a timer around dlopen on the target, for a few modules of different sizes
+typedef struct {
+	//Every read call issued
+	double read_us;
+	//Reads not continuing where the previous one ended
+	double seek_us;
+	//Every KiB read
+	double kib_us;
+	//Every relocation matched and applied
+	double reloc_us;
+	//Every symbol parsed
+	double symbol_us;
+} model_t;
+
+//Resident bytes by kind of section
+enum { CLASS_TEXT, CLASS_RODATA, CLASS_DATA, CLASS_BSS, CLASS_SDATA, CLASS_MERGED, CLASS_COUNT };
+static const char *class_names[CLASS_COUNT] = { "text", "rodata", "data", "bss", "sdata", "merged" };
+
+typedef struct {
+	size_t resident[CLASS_COUNT];
+	size_t resident_total;
+	size_t collected;
+	size_t collected_sects;
+	size_t imports;
+	size_t unresolved;
+	ivector_t *unresolved_names;
+	size_t relocs;
+	size_t rel_counts[REL_TYPES];
+	size_t unsupported;
+	//-1 without a host to measure against
+	long far_branches;
+	size_t symbols;
+	double io_ms;
+	double cpu_ms;
+} report_t;
+
+static char *error = NULL;
+
+static const char *rel_type_name(int type)
+{
+	switch (type)
+	{
+		case R_PPC_ADDR32: return "R_PPC_ADDR32";
+		case R_PPC_ADDR16_LO: return "R_PPC_ADDR16_LO";
+		case R_PPC_ADDR16_HI: return "R_PPC_ADDR16_HI";
+		case R_PPC_ADDR16_HA: return "R_PPC_ADDR16_HA";
+		case R_PPC_REL24: return "R_PPC_REL24";
+		case R_PPC_REL14: return "R_PPC_REL14";
+		case R_PPC_REL14_BRTAKEN: return "R_PPC_REL14_BRTAKEN";
+		case R_PPC_REL14_BRNTAKEN: return "R_PPC_REL14_BRNTAKEN";
+		case R_PPC_REL32: return "R_PPC_REL32";
+		case R_PPC_SDAREL16: return "R_PPC_SDAREL16";
+		case R_PPC_EMB_SDA21: return "R_PPC_EMB_SDA21";
+		default: return NULL;
+	}
+}
+
+//Kept in step with apply_relocation
+static int rel_type_supported(int type)
+{
+	return type == R_PPC_REL24 || type == R_PPC_ADDR16_HA || type == R_PPC_ADDR16_LO
+		|| type == R_PPC_SDAREL16 || type == R_PPC_EMB_SDA21;
+}
+
+static int load_model(const char *path, model_t *model)
+{
+	FILE *file = fopen(path, "r");
+	if (!file)
+	{
+		error = "Could not open model file";
+		return 0;
+	}
+
+	char line[MAX_LINE];
+	while (fgets(line, sizeof(line), file))
+	{
+		char name[MAX_LINE];
+		double value;
+		if (line[0] == '#' || 2 != sscanf(line, "%255s %lf", name, &value))
+			continue;
+
+		if (!strcmp(name, "read_us")) model->read_us = value;
+		else if (!strcmp(name, "seek_us")) model->seek_us = value;
+		else if (!strcmp(name, "kib_us")) model->kib_us = value;
+		else if (!strcmp(name, "reloc_us")) model->reloc_us = value;
+		else if (!strcmp(name, "symbol_us")) model->symbol_us = value;
+		else fprintf(stderr, "dlfcn-inspect: unknown model parameter '%s'\n", name);
+	}
+
+	fclose(file);
+	return 1;
+}
+
+//Splits a comma separated list in place into a NULL terminated array
+static const char **split_roots(char *list)
+{
+	size_t count = 1;
+	for (char *c = list; *c; ++c)
+		count += *c == ',';
+
+	const char **roots = calloc(count + 1, sizeof(char*));
+	if (!roots) return NULL;
+
+	size_t i = 0;
+	for (char *name = strtok(list, ","); name; name = strtok(NULL, ","))
+		roots[i++] = name;
+
+	return roots;
+}
+
+static elf_exec_t *open_host(const char *path)
+{
+	dl_io_t io;
+	if (dl_io_open_stdio(path, &io))
+	{
+		error = "Could not open host executable";
+		return NULL;
+	}
+
+	elf_exec_t *exec = elf_exec_create(&io, &error);
+	if (!exec) return NULL;
+
+	if (!elf_exec_valid(exec, &error) || !elf_load_sects(&exec->elf, &error) || !elf_load_shstrings(&exec->elf, &error)
+		|| !elf_find_defined_symbols(exec, &error) || !compute_own_symbols(exec) || !index_own_symbols(exec, &error))
+	{
+		elf_exec_destroy(exec);
+		return NULL;
+	}
+
+	return exec;
+}
+
+//Where the heap, and so the module pool, starts: right after the host's last allocated section
+static uint32_t host_end(elf_exec_t *exec)
+{
+	uint32_t end = 0;
+	for (int i = 1; i < exec->elf.header.e_shnum; ++i)
+	{
+		Elf32_Shdr *sect = &exec->elf.sects[i];
+		if ((sect->sh_flags & SHF_ALLOC) && sect->sh_addr + sect->sh_size > end)
+			end = sect->sh_addr + sect->sh_size;
+	}
+
+	return end;
+}
+
+//Follows the loader up to the point sections are read: selection, tables and collection
+static elf_rel_t *open_module(const char *path, const char **roots)
+{
+	dl_io_t io;
+	if (dl_io_open_stdio(path, &io))
+	{
+		error = "Could not open module";
+		return NULL;
+	}
+
+	elf_rel_t *obj = elf_rel_create(&io, NULL, &error);
+	if (!obj) return NULL;
+
+	if (!elf_rel_valid(obj, &error) || !elf_rel_alloc_tables(obj, &error) || !elf_load_sects(&obj->elf, &error) || !elf_load_shstrings(&obj->elf, &error))
+		goto _open_module_error;
+
+	//COMDAT groups are counted as loaded, whether they would be shared depends on what is resident
+	select_sections(obj, NULL);
+	if (!elf_read_tables(obj, &error) || !collect_sections(obj, roots, &error))
+		goto _open_module_error;
+
+	return obj;
+
+_open_module_error:
+	elf_rel_destroy(obj);
+	return NULL;
+}
+
+//Issues the section reads the loader would, to count them, into scratch buffers
+static int read_sections(elf_rel_t *obj)
+{
+	void **buffs = calloc(obj->elf.header.e_shnum ? obj->elf.header.e_shnum : 1, sizeof(void*));
+	if (!buffs)
+	{
+		error = "Failed to allocate section buffers";
+		return 0;
+	}
+
+	io_plan_t plan;
+	io_plan_init(&plan, NULL);
+
+	int ok = 1;
+	for (int i = 1; ok && i < obj->elf.header.e_shnum; ++i)
+	{
+		Elf32_Shdr *sect = &obj->elf.sects[i];
+		if ((obj->wanted[i] != SECT_LOADED && obj->wanted[i] != SECT_MERGED) || sect->sh_type == SHT_NOBITS)
+			continue;
+
+		buffs[i] = malloc(sect->sh_size ? sect->sh_size : 1);
+		ok = buffs[i] && io_plan_add(&plan, sect->sh_offset, sect->sh_size, buffs[i]);
+	}
+
+	if (!ok || !io_plan_execute(&plan, &obj->elf))
+	{
+		error = "Failed to read sections";
+		ok = 0;
+	}
+
+	for (int i = 0; i < obj->elf.header.e_shnum; ++i)
+		free(buffs[i]);
+	free(buffs);
+	io_plan_free(&plan);
+	return ok;
+}
+
+static int section_class(elf_rel_t *obj, Elf32_Shdr *sect)
+{
+	if (sda_section_reg(&obj->elf.sh_strings[sect->sh_name])) return CLASS_SDATA;
+	if (sect->sh_flags & SHF_EXECINSTR) return CLASS_TEXT;
+	if (sect->sh_type == SHT_NOBITS) return CLASS_BSS;
+	if (sect->sh_flags & SHF_WRITE) return CLASS_DATA;
+	return CLASS_RODATA;
+}
+
+static void measure_sections(elf_rel_t *obj, report_t *report)
+{
+	for (int i = 1; i < obj->elf.header.e_shnum; ++i)
+	{
+		Elf32_Shdr *sect = &obj->elf.sects[i];
+
+		if (obj->wanted[i] == SECT_COLLECTED)
+		{
+			report->collected += sect->sh_size;
+			++report->collected_sects;
+			continue;
+		}
+
+		if (obj->wanted[i] != SECT_LOADED && obj->wanted[i] != SECT_MERGED)
+			continue;
+
+		//Merged sections are an upper bound, pieces other modules hold are not loaded twice
+		int class = obj->wanted[i] == SECT_MERGED ? CLASS_MERGED : section_class(obj, sect);
+
+		report->resident[class] += sect->sh_size;
+		report->resident_total += sect->sh_size;
+	}
+}
+
+static void check_imports(elf_rel_t *obj, elf_exec_t *host, report_t *report)
+{
+	for (size_t i = 1; i < obj->raw_sym_count; ++i)
+	{
+		Elf32_Sym *sym = &obj->raw_syms[i];
+		char *name = &obj->raw_strs[sym->st_name];
+
+		//Same rules as preflight_undefined, unresolved weak references stay NULL
+		if (sym->st_shndx != SHN_UNDEF || ELF32_ST_BIND(sym->st_info) != STB_GLOBAL || !*name)
+			continue;
+
+		++report->imports;
+		if (host && symindex_get(&host->index, name) != SYMTAB_NONE)
+			continue;
+
+		++report->unresolved;
+		ivector_append(report->unresolved_names, &name);
+	}
+}
+
+static int branch_far(int type, int64_t distance)
+{
+	if (type == R_PPC_REL24)
+		return distance < -REL24_REACH || distance >= REL24_REACH;
+	if (type == R_PPC_REL14 || type == R_PPC_REL14_BRTAKEN || type == R_PPC_REL14_BRNTAKEN)
+		return distance < -REL14_REACH || distance >= REL14_REACH;
+	return 0;
+}
+
+//Branches from the module to host code further than the instruction can reach
+static int count_relocations(elf_rel_t *obj, elf_exec_t *host, uint32_t base, report_t *report)
+{
+	symtab_t *tab = &obj->symbols;
+	symindex_t defined;
+	if (!symindex_init(&defined, tab, NULL))
+	{
+		error = "Failed to allocate symbol index";
+		return 0;
+	}
+
+	for (size_t i = 0; i < tab->count; ++i)
+	{
+		if (tab->sections[i] != SHN_UNDEF)
+			symindex_add(&defined, i);
+	}
+
+	reltab_t *rels = &obj->relocations;
+	report->symbols = tab->count;
+	report->relocs = rels->count;
+	report->far_branches = host ? 0 : -1;
+
+	for (size_t i = 0; i < report->relocs; ++i)
+	{
+		int type = rels->types[i];
+		++report->rel_counts[type];
+		if (!rel_type_supported(type))
+			++report->unsupported;
+
+		//Targets within the module are always in reach, modules are nowhere near 32 MiB
+		const char *name = symtab_string(rels->strs, rels->sect_strs, rels->names[i]);
+		if (!host || symindex_get(&defined, name) != SYMTAB_NONE)
+			continue;
+
+		size_t target = symindex_get(&host->index, name);
+		if (target != SYMTAB_NONE && branch_far(type, (int64_t)(uintptr_t)host->symbols.addresses[target] + rels->addends[i] - base))
+			++report->far_branches;
+	}
+
+	symindex_free(&defined, NULL);
+	return 1;
+}
+
+static void estimate_time(elf_rel_t *obj, model_t *model, report_t *report)
+{
+	report->io_ms = (obj->elf.reads * model->read_us + obj->elf.seeks * model->seek_us
+		+ obj->elf.bytes_read / 1024.0 * model->kib_us) / 1000.0;
+	report->cpu_ms = (report->relocs * model->reloc_us + report->symbols * model->symbol_us) / 1000.0;
+}
+
+static int module_loads(report_t *report)
+{
+	return !report->unresolved && !report->unsupported && report->far_branches <= 0;
+}
+
+static void print_text(const char *path, elf_rel_t *obj, report_t *report)
+{
+	printf("%s: %s\n", path, module_loads(report) ? "loads" : "would not load");
+
+	printf("resident: %zu bytes\n", report->resident_total);
+	for (int c = 0; c < CLASS_COUNT; ++c)
+	{
+		if (report->resident[c]) printf("  %-8s %zu\n", class_names[c], report->resident[c]);
+	}
+	printf("collected: %zu bytes in %zu sections\n", report->collected, report->collected_sects);
+
+	printf("imports: %zu, %zu unresolved\n", report->imports, report->unresolved);
+	for (size_t i = 0; i < ivector_get_count(report->unresolved_names); ++i)
+		printf("  %s\n", *(char**)ivector_get(report->unresolved_names, i));
+
+	printf("relocations: %zu, %zu unsupported\n", report->relocs, report->unsupported);
+	for (int t = 0; t < REL_TYPES; ++t)
+	{
+		if (!report->rel_counts[t]) continue;
+
+		const char *name = rel_type_name(t);
+		if (name) printf("  %-22s %zu\n", name, report->rel_counts[t]);
+		else printf("  type %-17d %zu\n", t, report->rel_counts[t]);
+	}
+
+	if (report->far_branches < 0) printf("far branches: unknown (no host)\n");
+	else printf("far branches: %ld\n", report->far_branches);
+
+	printf("io: %zu bytes, %zu reads, %zu seeks\n", obj->elf.bytes_read, obj->elf.reads, obj->elf.seeks);
+	printf("estimated load: %.2f ms (io %.2f ms, cpu %.2f ms)\n", report->io_ms + report->cpu_ms, report->io_ms, report->cpu_ms);
+}
+
+static void print_json_string(const char *str)
+{
+	putchar('"');
+	for (; *str; ++str)
+	{
+		if (*str == '"' || *str == '\\') printf("\\%c", *str);
+		else if ((unsigned char)*str < 0x20) printf("\\u%04x", *str);
+		else putchar(*str);
+	}
+	putchar('"');
+}
+
+static void print_json(const char *path, elf_rel_t *obj, report_t *report)
+{
+	printf("{\n\t\"module\": ");
+	print_json_string(path);
+	printf(",\n\t\"loads\": %s,\n", module_loads(report) ? "true" : "false");
+
+	printf("\t\"resident\": { \"total\": %zu", report->resident_total);
+	for (int c = 0; c < CLASS_COUNT; ++c)
+		printf(", \"%s\": %zu", class_names[c], report->resident[c]);
+	printf(" },\n");
+	printf("\t\"collected\": { \"bytes\": %zu, \"sections\": %zu },\n", report->collected, report->collected_sects);
+
+	printf("\t\"imports\": %zu,\n\t\"unresolved\": [", report->imports);
+	for (size_t i = 0; i < ivector_get_count(report->unresolved_names); ++i)
+	{
+		if (i) fputs(", ", stdout);
+		print_json_string(*(char**)ivector_get(report->unresolved_names, i));
+	}
+	printf("],\n");
+
+	printf("\t\"relocations\": { \"total\": %zu, \"unsupported\": %zu, \"by_type\": {", report->relocs, report->unsupported);
+	int first = 1;
+	for (int t = 0; t < REL_TYPES; ++t)
+	{
+		if (!report->rel_counts[t]) continue;
+
+		const char *name = rel_type_name(t);
+		if (name) printf("%s \"%s\": %zu", first ? "" : ",", name, report->rel_counts[t]);
+		else printf("%s \"%d\": %zu", first ? "" : ",", t, report->rel_counts[t]);
+		first = 0;
+	}
+	printf(" } },\n");
+
+	if (report->far_branches < 0) printf("\t\"far_branches\": null,\n");
+	else printf("\t\"far_branches\": %ld,\n", report->far_branches);
+
+	printf("\t\"io\": { \"bytes_read\": %zu, \"reads\": %zu, \"seeks\": %zu },\n", obj->elf.bytes_read, obj->elf.reads, obj->elf.seeks);
+	printf("\t\"estimated_ms\": { \"total\": %.3f, \"io\": %.3f, \"cpu\": %.3f }\n}\n", report->io_ms + report->cpu_ms, report->io_ms, report->cpu_ms);
+}
+
+static int inspect(const char *path, elf_exec_t *host, const char **roots, uint32_t base, model_t *model, int json)
+{
+	report_t report = { 0 };
+	report.unresolved_names = ivector_create(sizeof(char*));
+	if (!report.unresolved_names)
+	{
+		error = "Failed to allocate report";
+		return 1;
+	}
+
+	elf_rel_t *obj = open_module(path, roots);
+	if (!obj)
+	{
+		ivector_destroy(report.unresolved_names);
+		return 1;
+	}
+
+	int ok = read_sections(obj) && elf_find_local_symbols(obj) && elf_find_relocations(obj, &error);
+	if (ok)
+	{
+		measure_sections(obj, &report);
+		check_imports(obj, host, &report);
+		ok = count_relocations(obj, host, base, &report);
+	}
+
+	if (ok)
+	{
+		estimate_time(obj, model, &report);
+		if (json) print_json(path, obj, &report);
+		else print_text(path, obj, &report);
+	}
+
+	int ret = !ok ? 1 : module_loads(&report) ? 0 : 2;
+	elf_rel_destroy(obj);
+	ivector_destroy(report.unresolved_names);
+	return ret;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: dlfcn-inspect [--host boot.elf] [--roots a,b,c] [--base 0xADDR] [--model file] [--json] module.o\n");
+}
+
+int main(int argc, char **argv)
+{
+	model_t model = { 150.0, 400.0, 250.0, 20.0, 2.0 };
+	const char *host_path = NULL, *module_path = NULL;
+	char *root_list = NULL;
+	uint32_t base = 0;
+	int json = 0;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "--json")) json = 1;
+		else if (!strcmp(argv[i], "--host") && i + 1 < argc) host_path = argv[++i];
+		else if (!strcmp(argv[i], "--roots") && i + 1 < argc) root_list = argv[++i];
+		else if (!strcmp(argv[i], "--base") && i + 1 < argc) base = (uint32_t)strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "--model") && i + 1 < argc)
+		{
+			if (!load_model(argv[++i], &model))
+			{
+				fprintf(stderr, "dlfcn-inspect: %s\n", error);
+				return 1;
+			}
+		}
+		else if (argv[i][0] != '-' && !module_path) module_path = argv[i];
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+
+	if (!module_path)
+	{
+		usage();
+		return 1;
+	}
+
+	const char **roots = NULL;
+	if (root_list && !(roots = split_roots(root_list)))
+	{
+		fprintf(stderr, "dlfcn-inspect: failed to allocate roots\n");
+		return 1;
+	}
+
+	elf_exec_t *host = NULL;
+	if (host_path && !(host = open_host(host_path)))
+	{
+		fprintf(stderr, "dlfcn-inspect: %s: %s\n", host_path, error);
+		free(roots);
+		return 1;
+	}
+
+	if (host && !base)
+		base = host_end(host);
+
+	int ret = inspect(module_path, host, roots, base, &model, json);
+	if (ret == 1)
+		fprintf(stderr, "dlfcn-inspect: %s: %s\n", module_path, error);
+
+	if (host) elf_exec_destroy(host);
+	free(roots);
+	return ret;
+}
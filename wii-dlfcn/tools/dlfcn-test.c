@@ -0,0 +1,1886 @@
+//Host tests and benchmarks of the loader, run by `make check`
+//Modules are written as the big-endian relocatables devkitPPC emits, and loaded into memory
+//below 4 GiB since relocations are applied as 32-bit words. Nothing loaded is ever run,
+//tests read back the words relocations wrote.
+#include <dirent.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dlfcn.h"
+#include "elf.h"
+#include "elfparse.h"
+#include "elfswap.h"
+#include "packfmt.h"
+#include "symhash.h"
+#include "symindex.h"
+
+#define POOL_SIZE (8 * 1024 * 1024)
+//Address of host_fn in the host executable
+#define HOST_FN 0x80004000u
+
+static int failures = 0;
+static char dir[64];
+
+#define CHECK(cond) do { if (!(cond)) { printf("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+static double now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static const char *fixture_path(const char *name)
+{
+	static char path[sizeof(dir) + 256];
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	return path;
+}
+
+/*=== ELF writer ===*/
+typedef struct {
+	unsigned char *data;
+	size_t size, cap;
+} buf_t;
+
+static void *buf_grow(buf_t *buf, size_t size)
+{
+	if (buf->size + size > buf->cap)
+	{
+		size_t cap = buf->cap ? buf->cap : 256;
+		while (cap < buf->size + size) cap *= 2;
+		if (!(buf->data = realloc(buf->data, cap)))
+		{
+			perror("realloc");
+			exit(1);
+		}
+		buf->cap = cap;
+	}
+
+	void *ptr = buf->data + buf->size;
+	buf->size += size;
+	return memset(ptr, 0, size);
+}
+
+static void put16(buf_t *buf, uint16_t value)
+{
+	unsigned char *ptr = buf_grow(buf, 2);
+	ptr[0] = value >> 8;
+	ptr[1] = value;
+}
+
+static void put32(buf_t *buf, uint32_t value)
+{
+	unsigned char *ptr = buf_grow(buf, 4);
+	ptr[0] = value >> 24;
+	ptr[1] = value >> 16;
+	ptr[2] = value >> 8;
+	ptr[3] = value;
+}
+
+static uint32_t put_str(buf_t *buf, const char *str)
+{
+	uint32_t offset = buf->size;
+	memcpy(buf_grow(buf, strlen(str) + 1), str, strlen(str));
+	return offset;
+}
+
+#define FIX_SECTS 16
+
+//An ELF file being written, section contents are big-endian and laid out by fix_write
+typedef struct {
+	Elf32_Half type;
+	buf_t strs, shstrs, syms;
+	buf_t contents[FIX_SECTS];
+	buf_t relas[FIX_SECTS];
+	Elf32_Shdr sects[FIX_SECTS];
+	Elf32_Half sect_count;
+	Elf32_Word sym_count;
+} fixture_t;
+
+static void fix_init(fixture_t *fix, Elf32_Half type)
+{
+	memset(fix, 0, sizeof(fixture_t));
+	fix->type = type;
+	put_str(&fix->strs, "");
+	put_str(&fix->shstrs, "");
+	buf_grow(&fix->syms, sizeof(Elf32_Sym));
+	fix->sym_count = 1;
+	fix->sect_count = 1;
+}
+
+//Contents may be appended to fix->contents[index] until fix_write, size is only used for SHT_NOBITS
+static Elf32_Half fix_section(fixture_t *fix, const char *name, Elf32_Word type, Elf32_Word flags, Elf32_Addr addr, const void *data, size_t size)
+{
+	Elf32_Half index = fix->sect_count++;
+	Elf32_Shdr *sect = &fix->sects[index];
+	memset(sect, 0, sizeof(Elf32_Shdr));
+	sect->sh_name = put_str(&fix->shstrs, name);
+	sect->sh_type = type;
+	sect->sh_flags = flags;
+	sect->sh_addr = addr;
+	sect->sh_addralign = 4;
+
+	if (type == SHT_NOBITS)
+		sect->sh_size = size;
+	else if (size)
+		memcpy(buf_grow(&fix->contents[index], size), data, size);
+	return index;
+}
+
+static Elf32_Word fix_symbol(fixture_t *fix, const char *name, Elf32_Addr value, Elf32_Word size, int bind, int type, Elf32_Half shndx)
+{
+	put32(&fix->syms, put_str(&fix->strs, name));
+	put32(&fix->syms, value);
+	put32(&fix->syms, size);
+	*(unsigned char*)buf_grow(&fix->syms, 1) = ELF32_ST_INFO(bind, type);
+	buf_grow(&fix->syms, 1);
+	put16(&fix->syms, shndx);
+	return fix->sym_count++;
+}
+
+static void fix_rela(fixture_t *fix, Elf32_Half sect, Elf32_Addr offset, Elf32_Word sym, int type, Elf32_Sword addend)
+{
+	put32(&fix->relas[sect], offset);
+	put32(&fix->relas[sect], sym << 8 | type);
+	put32(&fix->relas[sect], addend);
+}
+
+static void fix_table(fixture_t *fix, const char *name, Elf32_Word type, buf_t *contents, Elf32_Word link, Elf32_Word info, Elf32_Word entsize)
+{
+	Elf32_Half index = fix_section(fix, name, type, 0, 0, NULL, 0);
+	fix->contents[index] = *contents;
+	*contents = (buf_t){ 0 };
+	fix->sects[index].sh_link = link;
+	fix->sects[index].sh_info = info;
+	fix->sects[index].sh_entsize = entsize;
+}
+
+//Appends the symbol table, its strings and relocations, writes the file and frees the fixture
+static int fix_write(fixture_t *fix, const char *name)
+{
+	Elf32_Half count = fix->sect_count;
+	Elf32_Half symtab = count;
+
+	//Every symbol is global
+	fix_table(fix, ".symtab", SHT_SYMTAB, &fix->syms, symtab + 1, 1, sizeof(Elf32_Sym));
+	fix_table(fix, ".strtab", SHT_STRTAB, &fix->strs, 0, 0, 0);
+	for (Elf32_Half i = 1; i < count; ++i)
+	{
+		if (fix->sects[i].sh_type == SHT_GROUP)
+			fix->sects[i].sh_link = symtab;
+		if (!fix->relas[i].size) continue;
+
+		char rela_name[64];
+		snprintf(rela_name, sizeof(rela_name), ".rela%s", (char*)fix->shstrs.data + fix->sects[i].sh_name);
+		fix_table(fix, rela_name, SHT_RELA, &fix->relas[i], symtab, i, sizeof(Elf32_Rela));
+	}
+	Elf32_Half shstrtab = fix_section(fix, ".shstrtab", SHT_STRTAB, 0, 0, NULL, 0);
+	fix->contents[shstrtab] = fix->shstrs;
+	fix->shstrs = (buf_t){ 0 };
+
+	buf_t out = { 0 };
+	buf_grow(&out, sizeof(Elf32_Ehdr));
+	for (Elf32_Half i = 1; i < fix->sect_count; ++i)
+	{
+		Elf32_Shdr *sect = &fix->sects[i];
+		buf_grow(&out, (4 - out.size % 4) % 4);
+		sect->sh_offset = out.size;
+		if (sect->sh_type == SHT_NOBITS) continue;
+
+		sect->sh_size = fix->contents[i].size;
+		if (sect->sh_size) memcpy(buf_grow(&out, sect->sh_size), fix->contents[i].data, sect->sh_size);
+	}
+	buf_grow(&out, (4 - out.size % 4) % 4);
+	Elf32_Off shoff = out.size;
+
+	buf_grow(&out, sizeof(Elf32_Shdr));
+	for (Elf32_Half i = 1; i < fix->sect_count; ++i)
+	{
+		Elf32_Shdr *sect = &fix->sects[i];
+		put32(&out, sect->sh_name);
+		put32(&out, sect->sh_type);
+		put32(&out, sect->sh_flags);
+		put32(&out, sect->sh_addr);
+		put32(&out, sect->sh_offset);
+		put32(&out, sect->sh_size);
+		put32(&out, sect->sh_link);
+		put32(&out, sect->sh_info);
+		put32(&out, sect->sh_addralign);
+		put32(&out, sect->sh_entsize);
+	}
+
+	//The header goes in last, once the section table's place is known
+	buf_t header = { 0 };
+	static const unsigned char ident[EI_NIDENT] = { 0x7F, 'E', 'L', 'F', ELFCLASS32, ELFDATA2MSB, EV_CURRENT };
+	memcpy(buf_grow(&header, EI_NIDENT), ident, EI_NIDENT);
+	put16(&header, fix->type);
+	put16(&header, EM_PPC);
+	put32(&header, EV_CURRENT);
+	put32(&header, 0);
+	put32(&header, 0);
+	put32(&header, shoff);
+	put32(&header, 0);
+	put16(&header, sizeof(Elf32_Ehdr));
+	put16(&header, 0);
+	put16(&header, 0);
+	put16(&header, sizeof(Elf32_Shdr));
+	put16(&header, fix->sect_count);
+	put16(&header, shstrtab);
+	memcpy(out.data, header.data, header.size);
+
+	FILE *file = fopen(fixture_path(name), "wb");
+	int ok = file && fwrite(out.data, 1, out.size, file) == out.size;
+	if (file) fclose(file);
+
+	free(out.data);
+	free(header.data);
+	for (int i = 0; i < FIX_SECTS; ++i)
+	{
+		free(fix->contents[i].data);
+		free(fix->relas[i].data);
+	}
+	return ok;
+}
+
+/*=== Fixtures ===*/
+#define INSN_LIS 0x3C600000u
+#define INSN_ADDI 0x38630000u
+#define INSN_BLR 0x4E800020u
+
+//A module exporting <name>_fn, <name>_data and <name>_buf
+typedef struct {
+	const char *name;
+	//Symbols its text takes the address of, after <name>_data and host_fn, NULL terminated
+	const char *const *imports;
+	//COMDAT group it carries, defining a function named after the group, referenced last
+	const char *group;
+	size_t bss;
+	//Exported <name>_fnN functions, each taking the address of <name>_data
+	size_t extra;
+} module_t;
+
+//Address pair k of a module's text, as written by ADDR16_HA/ADDR16_LO relocations
+static uint32_t ref_at(const void *text, size_t k)
+{
+	const uint16_t *half = (const uint16_t*)((const char*)text + 8 * k);
+	return ((uint32_t)half[1] << 16) + (int16_t)half[3];
+}
+
+static uint32_t addr_of(void *handle, const char *name)
+{
+	return (uint32_t)(uintptr_t)dlsym(handle, name);
+}
+
+static void fix_ref(fixture_t *fix, Elf32_Half text, Elf32_Word sym, Elf32_Sword addend)
+{
+	buf_t *code = &fix->contents[text];
+	fix_rela(fix, text, code->size + 2, sym, R_PPC_ADDR16_HA, addend);
+	fix_rela(fix, text, code->size + 6, sym, R_PPC_ADDR16_LO, addend);
+	put32(code, INSN_LIS);
+	put32(code, INSN_ADDI);
+}
+
+static int write_module(const char *file, const module_t *mod)
+{
+	fixture_t fix;
+	fix_init(&fix, ET_REL);
+	char name[64];
+
+	size_t imports = 0;
+	while (mod->imports && mod->imports[imports]) ++imports;
+	size_t refs = 2 + imports + (mod->group ? 1 : 0);
+
+	Elf32_Half text = fix_section(&fix, ".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 0, NULL, 0);
+	static const unsigned char data[16] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+	Elf32_Half data_sect = fix_section(&fix, ".data", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, 0, data, sizeof(data));
+	Elf32_Half bss = mod->bss ? fix_section(&fix, ".bss", SHT_NOBITS, SHF_ALLOC | SHF_WRITE, 0, NULL, mod->bss) : 0;
+
+	snprintf(name, sizeof(name), "%s_fn", mod->name);
+	fix_symbol(&fix, name, 0, (refs + mod->extra) * 8 + 4, STB_GLOBAL, STT_FUNC, text);
+	snprintf(name, sizeof(name), "%s_data", mod->name);
+	Elf32_Word data_sym = fix_symbol(&fix, name, 0, sizeof(data), STB_GLOBAL, STT_OBJECT, data_sect);
+	if (bss)
+	{
+		snprintf(name, sizeof(name), "%s_buf", mod->name);
+		fix_symbol(&fix, name, 0, mod->bss, STB_GLOBAL, STT_OBJECT, bss);
+	}
+	for (size_t i = 0; i < mod->extra; ++i)
+	{
+		snprintf(name, sizeof(name), "%s_fn%zu", mod->name, i);
+		fix_symbol(&fix, name, (refs + i) * 8, 8, STB_GLOBAL, STT_FUNC, text);
+	}
+
+	fix_ref(&fix, text, data_sym, 0);
+	fix_ref(&fix, text, fix_symbol(&fix, "host_fn", 0, 0, STB_GLOBAL, STT_NOTYPE, SHN_UNDEF), 0);
+	for (size_t i = 0; i < imports; ++i)
+		fix_ref(&fix, text, fix_symbol(&fix, mod->imports[i], 0, 0, STB_GLOBAL, STT_NOTYPE, SHN_UNDEF), 0);
+
+	if (mod->group)
+	{
+		static const unsigned char body[8] = { 0x60, 0, 0, 0, 0x4E, 0x80, 0, 0x20 };
+		snprintf(name, sizeof(name), ".text.%s", mod->group);
+		Elf32_Half member = fix_section(&fix, name, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR | SHF_GROUP, 0, body, sizeof(body));
+		Elf32_Word group_sym = fix_symbol(&fix, mod->group, 0, sizeof(body), STB_GLOBAL, STT_FUNC, member);
+
+		Elf32_Half group = fix_section(&fix, ".group", SHT_GROUP, 0, 0, NULL, 0);
+		put32(&fix.contents[group], GRP_COMDAT);
+		put32(&fix.contents[group], member);
+		fix.sects[group].sh_info = group_sym;
+		fix.sects[group].sh_entsize = sizeof(Elf32_Word);
+
+		fix_ref(&fix, text, group_sym, 0);
+	}
+
+	for (size_t i = 0; i < mod->extra; ++i)
+		fix_ref(&fix, text, data_sym, (i % 4) * 4);
+	put32(&fix.contents[text], INSN_BLR);
+
+	return fix_write(&fix, file);
+}
+
+//The executable modules link against, defining host_fn
+static int write_host(const char *file)
+{
+	fixture_t fix;
+	fix_init(&fix, ET_EXEC);
+
+	static const unsigned char text[64] = { 0 };
+	Elf32_Half sect = fix_section(&fix, ".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, HOST_FN, text, sizeof(text));
+	fix_symbol(&fix, "host_fn", HOST_FN, 4, STB_GLOBAL, STT_FUNC, sect);
+	return fix_write(&fix, file);
+}
+
+static void remove_fixtures(void)
+{
+	DIR *fixtures = opendir(dir);
+	if (!fixtures) return;
+
+	struct dirent *entry;
+	while ((entry = readdir(fixtures)))
+	{
+		if (entry->d_name[0] != '.') unlink(fixture_path(entry->d_name));
+	}
+	closedir(fixtures);
+	rmdir(dir);
+}
+
+//Module memory must be addressable by the 32-bit words relocations write
+static void *map_low(size_t size)
+{
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_32BIT
+	flags |= MAP_32BIT;
+#endif
+	void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+	if (mem == MAP_FAILED) return NULL;
+	if ((uintptr_t)mem + size <= UINT32_MAX) return mem;
+
+	munmap(mem, size);
+	return NULL;
+}
+
+static int setup(void)
+{
+	strcpy(dir, "/tmp/dlfcn-test-XXXXXX");
+	if (!mkdtemp(dir))
+	{
+		perror("mkdtemp");
+		return 0;
+	}
+	atexit(remove_fixtures);
+
+	if (!write_host("boot.elf") || dlinit((char*)fixture_path("boot.elf")))
+	{
+		printf("dlinit failed: %s\n", dlerror());
+		return 0;
+	}
+
+	void *pool = map_low(POOL_SIZE);
+	if (!pool || dlpoolinit(pool, POOL_SIZE))
+	{
+		printf("no module pool below 4 GiB\n");
+		return 0;
+	}
+
+	return 1;
+}
+
+/*=== Parser ===*/
+static size_t row_of(const symtab_t *tab, const char *name)
+{
+	return symtab_next(tab, name, sym_hash(name, 0), 0);
+}
+
+//Parses a module the way dlfcn-inspect does, up to its symbols and relocation records
+static elf_rel_t *parse_module(const char *file, char **error)
+{
+	dl_io_t io;
+	if (dl_io_open_stdio(fixture_path(file), &io))
+	{
+		*error = "Could not open module";
+		return NULL;
+	}
+
+	elf_rel_t *obj = elf_rel_create(&io, NULL, error);
+	if (!obj) return NULL;
+
+	if (!elf_rel_valid(obj, error) || !elf_rel_alloc_tables(obj, error) || !elf_load_sects(&obj->elf, error) || !elf_load_shstrings(&obj->elf, error))
+		goto _parse_module_error;
+
+	select_sections(obj, NULL);
+	if (!elf_read_tables(obj, error) || !collect_sections(obj, NULL, error) || !elf_find_local_symbols(obj) || !elf_find_relocations(obj, error))
+		goto _parse_module_error;
+
+	return obj;
+
+_parse_module_error:
+	elf_rel_destroy(obj);
+	return NULL;
+}
+
+//Copies a fixture, patching bytes at offset, or cutting it there when patch is NULL
+static int copy_fixture(const char *from, const char *to, long offset, const void *patch, size_t size)
+{
+	unsigned char data[4096];
+	FILE *file = fopen(fixture_path(from), "rb");
+	size_t len = file ? fread(data, 1, sizeof(data), file) : 0;
+	if (file) fclose(file);
+	if (!len || (size_t)offset + size > len) return 0;
+
+	if (patch) memcpy(&data[offset], patch, size);
+	else len = offset;
+
+	file = fopen(fixture_path(to), "wb");
+	int ok = file && fwrite(data, 1, len, file) == len;
+	if (file) fclose(file);
+	return ok;
+}
+
+//Headers, symbols and relocation records of a module and the host, and malformed files rejected
+static void test_parser(void)
+{
+	static const char *const imports[] = { "ext_a", "ext_b", NULL };
+	module_t mod = { "parse", imports, "grp", 64, 3 };
+	if (!write_module("parse.o", &mod))
+	{
+		printf("parser: could not write parse.o\n");
+		++failures;
+		return;
+	}
+
+	char *error = NULL;
+	dl_io_t io;
+	elf_exec_t *exec = dl_io_open_stdio(fixture_path("boot.elf"), &io) ? NULL : elf_exec_create(&io, &error);
+	CHECK(exec != NULL);
+	if (exec)
+	{
+		int ok = elf_exec_valid(exec, &error) && elf_load_sects(&exec->elf, &error) && elf_load_shstrings(&exec->elf, &error)
+			&& elf_find_defined_symbols(exec, &error) && compute_own_symbols(exec) && index_own_symbols(exec, &error);
+		CHECK(ok);
+
+		size_t row = ok ? symindex_get(&exec->index, "host_fn") : SYMTAB_NONE;
+		CHECK(row != SYMTAB_NONE);
+		if (row != SYMTAB_NONE) CHECK((uintptr_t)exec->symbols.addresses[row] == HOST_FN);
+		if (ok) CHECK(symindex_get(&exec->index, "parse_fn") == SYMTAB_NONE);
+		elf_exec_destroy(exec);
+	}
+
+	elf_rel_t *obj = parse_module("parse.o", &error);
+	CHECK(obj != NULL);
+	if (!obj)
+	{
+		printf("parser: %s\n", error);
+		return;
+	}
+
+	//.text .data .bss .text.grp .group, then .symtab .strtab .rela.text .shstrtab
+	CHECK(obj->elf.header.e_shnum == 10);
+	CHECK(!strcmp(&obj->elf.sh_strings[obj->elf.sects[4].sh_name], ".text.grp"));
+	CHECK(obj->elf.sects[3].sh_type == SHT_NOBITS && obj->elf.sects[3].sh_size == 64);
+	CHECK(count_groups(obj) == 1);
+	CHECK(obj->wanted[1] == SECT_LOADED && obj->wanted[2] == SECT_LOADED && obj->wanted[3] == SECT_LOADED);
+
+	//Five address pairs, then one per extra function
+	size_t refs = 5 + mod.extra;
+	CHECK(elf_count_relocations(obj) == 2 * refs);
+
+	symtab_t *tab = &obj->symbols;
+	size_t row = row_of(tab, "parse_fn2");
+	CHECK(row != SYMTAB_NONE);
+	if (row != SYMTAB_NONE)
+	{
+		CHECK(tab->values[row] == (5 + 2) * 8);
+		CHECK(tab->sections[row] == 1);
+		CHECK(ELF32_ST_BIND(tab->info[row]) == STB_GLOBAL && ELF32_ST_TYPE(tab->info[row]) == STT_FUNC);
+	}
+	//Imports are untyped and left out, their relocations name them
+	CHECK(obj->raw_sym_count == 11 && tab->count == 7);
+	CHECK(row_of(tab, "ext_b") == SYMTAB_NONE);
+	CHECK(row_of(tab, "missing") == SYMTAB_NONE);
+
+	reltab_t *rels = &obj->relocations;
+	CHECK(rels->count == 2 * refs);
+	int pairs = rels->count == 2 * refs;
+	for (size_t i = 0; pairs && i < rels->count; i += 2)
+	{
+		pairs = rels->types[i] == R_PPC_ADDR16_HA && rels->types[i + 1] == R_PPC_ADDR16_LO
+			&& rels->offsets[i] == i * 4 + 2 && rels->offsets[i + 1] == i * 4 + 6 && rels->sections[i] == 1
+			&& !strcmp(symtab_string(rels->strs, rels->sect_strs, rels->names[i]), symtab_string(rels->strs, rels->sect_strs, rels->names[i + 1]));
+	}
+	CHECK(pairs);
+	if (pairs)
+	{
+		CHECK(!strcmp(symtab_string(rels->strs, rels->sect_strs, rels->names[0]), "parse_data"));
+		CHECK(!strcmp(symtab_string(rels->strs, rels->sect_strs, rels->names[4]), "ext_a"));
+		CHECK(!strcmp(symtab_string(rels->strs, rels->sect_strs, rels->names[8]), "grp"));
+		CHECK(rels->addends[2 * refs - 1] == 8);
+	}
+	size_t symbols = tab->count;
+	elf_rel_destroy(obj);
+
+	//Another machine, and a file cut inside its header
+	static const unsigned char x86[2] = { 0, 3 };
+	CHECK(copy_fixture("parse.o", "machine.o", 18, x86, sizeof(x86)));
+	error = NULL;
+	CHECK(parse_module("machine.o", &error) == NULL && error != NULL);
+	CHECK(copy_fixture("parse.o", "cut.o", 40, NULL, 0));
+	error = NULL;
+	CHECK(parse_module("cut.o", &error) == NULL && error != NULL);
+	CHECK(dlopen(fixture_path("cut.o"), RTLD_NOW) == NULL && dlerror() != NULL);
+
+	printf("parser: %zu symbols, %zu relocations checked\n", symbols, 2 * refs);
+}
+
+/*=== Preflight ===*/
+//dlcheck names a missing import and counts them all, and neither it nor the refused load takes pool memory
+static void test_check(void)
+{
+	static const char *const missing[] = { "check_missing", "check_absent", NULL };
+	module_t good = { "check_good", NULL, NULL, 64, 2 };
+	module_t bad = { "check_bad", missing, NULL, 64, 2 };
+	if (!write_module("check_good.o", &good) || !write_module("check_bad.o", &bad))
+	{
+		printf("check: could not write modules\n");
+		++failures;
+		return;
+	}
+
+	dlpoolstats_t before, after;
+	dlpoolstats(&before);
+	CHECK(!dlcheck(fixture_path("check_good.o")));
+	CHECK(dlerror() == NULL);
+
+	CHECK(dlcheck(fixture_path("check_bad.o")));
+	const char *message = dlerror();
+	CHECK(message && strstr(message, "check_missing") && strstr(message, "2 undefined"));
+	CHECK(!dlopen(fixture_path("check_bad.o"), RTLD_NOW));
+	message = dlerror();
+	CHECK(message && strstr(message, "check_missing"));
+	dlpoolstats(&after);
+	CHECK(after.used == before.used);
+
+	CHECK(dlcheck(fixture_path("check_none.o")));
+	CHECK(dlerror() != NULL);
+	printf("check: missing imports reported without loading\n");
+}
+
+/*=== Collection ===*/
+//A function per section, the dead one importing a symbol the host does not have
+static int write_split_module(const char *file)
+{
+	fixture_t fix;
+	fix_init(&fix, ET_REL);
+
+	Elf32_Half used = fix_section(&fix, ".text.gc_used", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 0, NULL, 0);
+	Elf32_Half dead = fix_section(&fix, ".text.gc_dead", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 0, NULL, 0);
+	fix_symbol(&fix, "gc_used", 0, 12, STB_GLOBAL, STT_FUNC, used);
+	fix_symbol(&fix, "gc_dead", 0, 12, STB_GLOBAL, STT_FUNC, dead);
+
+	fix_ref(&fix, used, fix_symbol(&fix, "host_fn", 0, 0, STB_GLOBAL, STT_NOTYPE, SHN_UNDEF), 0);
+	fix_ref(&fix, dead, fix_symbol(&fix, "gc_missing", 0, 0, STB_GLOBAL, STT_NOTYPE, SHN_UNDEF), 0);
+	put32(&fix.contents[used], INSN_BLR);
+	put32(&fix.contents[dead], INSN_BLR);
+
+	return fix_write(&fix, file);
+}
+
+//Imports only collected code uses must not fail a load from roots that leave it out
+static void test_collect(void)
+{
+	if (!write_split_module("split.o"))
+	{
+		printf("collect: could not write split.o\n");
+		++failures;
+		return;
+	}
+
+	//Every global is a root by default, and the dead function is one
+	CHECK(dlcheck(fixture_path("split.o")));
+	const char *message = dlerror();
+	CHECK(message && strstr(message, "gc_missing"));
+	CHECK(!dlopen(fixture_path("split.o"), RTLD_NOW));
+
+	static const char *roots[] = { "gc_used", NULL };
+	void *handle = dlopen_roots(fixture_path("split.o"), RTLD_NOW, roots);
+	CHECK(handle);
+	if (!handle) return;
+
+	dlstats_t stats;
+	CHECK(!dlstats(handle, &stats));
+	CHECK(stats.bytes_collected == 12);
+	CHECK(ref_at(dlsym(handle, "gc_used"), 0) == HOST_FN);
+	CHECK(!dlsym(handle, "gc_dead"));
+	CHECK(!dlclose(handle));
+	printf("collect: %zu bytes collected, their missing import ignored\n", stats.bytes_collected);
+}
+
+/*=== Batches ===*/
+//A function whose only relocation is of a type the loader does not apply
+static int write_unlinkable_module(const char *file)
+{
+	fixture_t fix;
+	fix_init(&fix, ET_REL);
+
+	Elf32_Half text = fix_section(&fix, ".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 0, NULL, 0);
+	fix_symbol(&fix, "unlinkable_fn", 0, 8, STB_GLOBAL, STT_FUNC, text);
+	fix_rela(&fix, text, 0, fix_symbol(&fix, "host_fn", 0, 0, STB_GLOBAL, STT_NOTYPE, SHN_UNDEF), R_PPC_ADDR32, 0);
+	put32(&fix.contents[text], 0);
+	put32(&fix.contents[text], INSN_BLR);
+
+	return fix_write(&fix, file);
+}
+
+//Peers link against each other, and a batch failing before or after its sections are in leaves nothing behind
+static void test_batch(void)
+{
+	static const char *const peer_imports[] = { "batch_a_fn", NULL };
+	static const char *const lost_imports[] = { "batch_missing", NULL };
+	module_t peer_a = { "batch_a", NULL, NULL, 256, 0 };
+	module_t peer_b = { "batch_b", peer_imports, NULL, 0, 0 };
+	module_t lost = { "batch_lost", lost_imports, NULL, 0, 0 };
+	if (!write_module("batch_a.o", &peer_a) || !write_module("batch_b.o", &peer_b) || !write_module("batch_lost.o", &lost)
+		|| !write_unlinkable_module("unlinkable.o"))
+	{
+		printf("batch: could not write modules\n");
+		++failures;
+		return;
+	}
+
+	char paths[4][sizeof(dir) + 256];
+	static const char *const files[4] = { "batch_a.o", "batch_b.o", "batch_lost.o", "unlinkable.o" };
+	for (int i = 0; i < 4; ++i)
+		snprintf(paths[i], sizeof(paths[i]), "%s", fixture_path(files[i]));
+
+	//Loaded on its own, the second peer cannot find the first
+	CHECK(!dlopen(paths[1], RTLD_NOW));
+
+	dlpoolstats_t before, after;
+	dlpoolstats(&before);
+	void *handles[3] = { 0 };
+	const char *peers[2] = { paths[0], paths[1] };
+	CHECK(!dlopen_many(peers, 2, RTLD_NOW, handles));
+	if (!handles[0] || !handles[1]) return;
+
+	uint32_t peer_fn = addr_of(handles[0], "batch_a_fn");
+	CHECK(ref_at(dlsym(handles[1], "batch_b_fn"), 2) == peer_fn);
+	CHECK(ref_at(dlsym(handles[1], "batch_b_fn"), 1) == HOST_FN);
+	CHECK(!dlclose(handles[0]));
+	CHECK(!dlclose(handles[1]));
+
+	//Refused by the preflight, before any section is allocated
+	const char *lost_batch[3] = { paths[0], paths[1], paths[2] };
+	handles[0] = handles[1] = handles[2] = NULL;
+	CHECK(dlopen_many(lost_batch, 3, RTLD_NOW, handles));
+	const char *message = dlerror();
+	CHECK(message && strstr(message, "batch_missing"));
+	CHECK(!handles[0] && !handles[1] && !handles[2]);
+	dlpoolstats(&after);
+	CHECK(after.used == before.used);
+
+	//Refused while linking, once every module of the batch holds its sections
+	const char *unlinkable_batch[3] = { paths[0], paths[1], paths[3] };
+	CHECK(dlopen_many(unlinkable_batch, 3, RTLD_NOW, handles));
+	message = dlerror();
+	CHECK(message && strstr(message, "Unsupported relocation"));
+	CHECK(!handles[0] && !handles[1] && !handles[2]);
+	dlpoolstats(&after);
+	CHECK(after.used == before.used);
+
+	//The pool is as the rollbacks found it, so the peers land where they did the first time
+	CHECK(!dlopen_many(peers, 2, RTLD_NOW, handles));
+	if (!handles[0] || !handles[1]) return;
+
+	CHECK(addr_of(handles[0], "batch_a_fn") == peer_fn);
+	CHECK(!dlclose(handles[0]));
+	CHECK(!dlclose(handles[1]));
+	printf("batch: 2 peers linked, batches failing in preflight and in linking rolled back\n");
+}
+
+/*=== Section selection ===*/
+#define DEBUG_COMMENT 32
+#define DEBUG_INFO 200
+#define DEBUG_EH_FRAME 24
+
+//A function, with the sections a -g build adds around it
+static int write_debug_module(const char *file)
+{
+	fixture_t fix;
+	fix_init(&fix, ET_REL);
+
+	static const unsigned char filler[DEBUG_INFO] = { 0 };
+	Elf32_Half text = fix_section(&fix, ".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 0, NULL, 0);
+	fix_section(&fix, ".comment", SHT_PROGBITS, 0, 0, filler, DEBUG_COMMENT);
+	Elf32_Half info = fix_section(&fix, ".debug_info", SHT_PROGBITS, 0, 0, filler, DEBUG_INFO);
+	fix_section(&fix, ".eh_frame", SHT_PROGBITS, SHF_ALLOC, 0, filler, DEBUG_EH_FRAME);
+
+	Elf32_Word fn = fix_symbol(&fix, "debug_fn", 0, 12, STB_GLOBAL, STT_FUNC, text);
+	fix_ref(&fix, text, fix_symbol(&fix, "host_fn", 0, 0, STB_GLOBAL, STT_NOTYPE, SHN_UNDEF), 0);
+	put32(&fix.contents[text], INSN_BLR);
+	//Of a type the loader does not apply, so the load fails if it is ever read
+	fix_rela(&fix, info, 0, fn, R_PPC_ADDR32, 0);
+
+	return fix_write(&fix, file);
+}
+
+static size_t policy_size;
+
+static int keep_eh_frame(const char *name, size_t size)
+{
+	if (strcmp(name, ".eh_frame")) return 0;
+
+	policy_size = size;
+	return 1;
+}
+
+//Sections without SHF_ALLOC are never read, optional ones only when the policy asks for them
+static void test_sections(void)
+{
+	if (!write_debug_module("debug.o"))
+	{
+		printf("sections: could not write debug.o\n");
+		++failures;
+		return;
+	}
+
+	dlstats_t plain, kept;
+	void *handle = dlopen(fixture_path("debug.o"), RTLD_NOW);
+	CHECK(handle != NULL);
+	if (!handle) return;
+
+	CHECK(!dlstats(handle, &plain));
+	CHECK(ref_at(dlsym(handle, "debug_fn"), 0) == HOST_FN);
+	CHECK(!dlclose(handle));
+	//.comment, .debug_info and its relocation, and .eh_frame
+	CHECK(plain.bytes_skipped == DEBUG_COMMENT + DEBUG_INFO + sizeof(Elf32_Rela) + DEBUG_EH_FRAME);
+	CHECK(plain.bytes_resident == 12);
+
+	dlsectionpolicy(keep_eh_frame);
+	handle = dlopen(fixture_path("debug.o"), RTLD_NOW);
+	dlsectionpolicy(NULL);
+	CHECK(handle != NULL);
+	if (!handle) return;
+
+	CHECK(!dlstats(handle, &kept));
+	CHECK(!dlclose(handle));
+	CHECK(policy_size == DEBUG_EH_FRAME);
+	CHECK(kept.bytes_skipped == plain.bytes_skipped - DEBUG_EH_FRAME);
+	CHECK(kept.bytes_resident == plain.bytes_resident + DEBUG_EH_FRAME);
+	CHECK(kept.bytes_read >= plain.bytes_read + DEBUG_EH_FRAME);
+	printf("sections: %zu bytes skipped, %zu with .eh_frame kept, %zu bytes read\n", plain.bytes_skipped, kept.bytes_skipped, plain.bytes_read);
+}
+
+/*=== Bulk lookups ===*/
+#define BULK_MISSING 40
+
+typedef struct {
+	void *fn;
+	void *missing;
+	void *data;
+} bulk_table_t;
+
+//Every name is looked up past a miss, and dlerror lists the missing ones with their total
+static void test_bulk(void)
+{
+	module_t mod = { "bulk", NULL, NULL, 0, 4 };
+	if (!write_module("bulk.o", &mod))
+	{
+		printf("bulk: could not write bulk.o\n");
+		++failures;
+		return;
+	}
+
+	void *handle = dlopen(fixture_path("bulk.o"), RTLD_NOW);
+	CHECK(handle != NULL);
+	if (!handle) return;
+
+	const char *names[5] = { "bulk_fn", "bulk_nope", "bulk_data", "bulk_gone", "bulk_fn3" };
+	void *out[5] = { names, names, names, names, names };
+	CHECK(dlsym_many(handle, names, 5, out));
+	const char *message = dlerror();
+	CHECK(message && strstr(message, "'bulk_nope', 'bulk_gone'") && strstr(message, "(2 missing)") && !strstr(message, "bulk_fn"));
+	CHECK(out[0] && out[2] && out[4] && !out[1] && !out[3]);
+	CHECK(out[0] == dlsym(handle, "bulk_fn") && out[2] == dlsym(handle, "bulk_data") && out[4] == dlsym(handle, "bulk_fn3"));
+
+	const char *found[2] = { "bulk_fn", "bulk_fn3" };
+	CHECK(!dlsym_many(handle, found, 2, out));
+	CHECK(dlerror() == NULL);
+
+	bulk_table_t table = { names, names, names };
+	const dlbind_entry_t entries[] = {
+		DLBIND_ENTRY("bulk_fn", &table, fn),
+		DLBIND_ENTRY("bulk_nope", &table, missing),
+		DLBIND_ENTRY("bulk_data", &table, data),
+		{ NULL, NULL },
+	};
+	CHECK(dlbind(handle, entries));
+	message = dlerror();
+	CHECK(message && strstr(message, "'bulk_nope'") && strstr(message, "(1 missing)"));
+	CHECK(table.fn == out[0] && !table.missing && table.data == dlsym(handle, "bulk_data"));
+
+	//More names than the message holds, the total still counts them all
+	char missing_names[BULK_MISSING][32];
+	const char *many[BULK_MISSING];
+	void *many_out[BULK_MISSING];
+	for (int i = 0; i < BULK_MISSING; ++i)
+	{
+		snprintf(missing_names[i], sizeof(missing_names[i]), "bulk_absent_symbol_%02d", i);
+		many[i] = missing_names[i];
+	}
+	CHECK(dlsym_many(handle, many, BULK_MISSING, many_out));
+	message = dlerror();
+	CHECK(message && strstr(message, "'bulk_absent_symbol_00'") && strstr(message, "(40 missing)"));
+
+	CHECK(!dlclose(handle));
+	CHECK(dlsym_many(handle, found, 2, out));
+	CHECK(dlerror() != NULL);
+	printf("bulk: missing symbols listed and counted\n");
+}
+
+/*=== Constant pool ===*/
+//Pieces both string modules carry, "shared one" and "shared two" with their NULs
+#define MERGE_COMMON 22
+#define MERGE_OWN 7
+
+//<name>_fn takes the address of the first two of "shared one", "shared two" and "only <x>", in .rodata.str1.1
+static int write_strings_module(const char *file, const char *name, char own)
+{
+	fixture_t fix;
+	fix_init(&fix, ET_REL);
+
+	char strs[MERGE_COMMON + MERGE_OWN];
+	memcpy(strs, "shared one\0shared two\0only ", MERGE_COMMON + 5);
+	strs[MERGE_COMMON + 5] = own;
+	strs[MERGE_COMMON + 6] = '\0';
+
+	char sym_name[64];
+	Elf32_Half text = fix_section(&fix, ".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 0, NULL, 0);
+	Elf32_Half rodata = fix_section(&fix, ".rodata.str1.1", SHT_PROGBITS, SHF_ALLOC | SHF_MERGE | SHF_STRINGS, 0, strs, sizeof(strs));
+	fix.sects[rodata].sh_addralign = 1;
+	fix.sects[rodata].sh_entsize = 1;
+
+	snprintf(sym_name, sizeof(sym_name), "%s_fn", name);
+	fix_symbol(&fix, sym_name, 0, 20, STB_GLOBAL, STT_FUNC, text);
+	snprintf(sym_name, sizeof(sym_name), "%s_strs", name);
+	Elf32_Word str_sym = fix_symbol(&fix, sym_name, 0, sizeof(strs), STB_GLOBAL, STT_OBJECT, rodata);
+	fix_ref(&fix, text, str_sym, 0);
+	fix_ref(&fix, text, str_sym, MERGE_COMMON / 2);
+	put32(&fix.contents[text], INSN_BLR);
+
+	return fix_write(&fix, file);
+}
+
+//Closes the string modules in the given order, the pool must give back what each held alone
+static void close_strings(void *first, void *second, const char *second_strs, const dlpoolstats_t *empty)
+{
+	dlpoolstats_t stats;
+	const char *strs = dlsym(second, second_strs);
+
+	CHECK(!dlclose(first));
+	dlpoolstats(&stats);
+	CHECK(stats.merge_saved == empty->merge_saved);
+	CHECK(stats.merge_pooled == empty->merge_pooled + MERGE_COMMON + MERGE_OWN);
+	//The pieces the closed module shared stay for the other one
+	CHECK(strs && !strcmp(strs, "shared one"));
+
+	CHECK(!dlclose(second));
+	dlpoolstats(&stats);
+	CHECK(stats.merge_pooled == empty->merge_pooled && stats.merge_saved == empty->merge_saved);
+}
+
+//Identical strings of two modules are held once, whichever of them is closed first
+static void test_merge(void)
+{
+	if (!write_strings_module("merge_a.o", "merge_a", 'a') || !write_strings_module("merge_b.o", "merge_b", 'b'))
+	{
+		printf("merge: could not write modules\n");
+		++failures;
+		return;
+	}
+
+	dlpoolstats_t empty, stats;
+	dlpoolstats(&empty);
+	for (int order = 0; order < 2; ++order)
+	{
+		void *a = dlopen(fixture_path("merge_a.o"), RTLD_NOW);
+		void *b = dlopen(fixture_path("merge_b.o"), RTLD_NOW);
+		CHECK(a && b);
+		if (!a || !b) return;
+
+		dlstats_t a_stats, b_stats;
+		CHECK(!dlstats(a, &a_stats) && !dlstats(b, &b_stats));
+		CHECK(a_stats.bytes_shared == 0 && b_stats.bytes_shared == MERGE_COMMON);
+		CHECK(a_stats.bytes_resident == 20 + MERGE_COMMON + MERGE_OWN && b_stats.bytes_resident == 20 + MERGE_OWN);
+		dlpoolstats(&stats);
+		CHECK(stats.merge_pooled == empty.merge_pooled + MERGE_COMMON + 2 * MERGE_OWN);
+		CHECK(stats.merge_saved == empty.merge_saved + MERGE_COMMON);
+
+		void *a_fn = dlsym(a, "merge_a_fn"), *b_fn = dlsym(b, "merge_b_fn");
+		CHECK(ref_at(a_fn, 0) == ref_at(b_fn, 0) && ref_at(a_fn, 1) == ref_at(b_fn, 1));
+		//The pool is on the heap, out of reach of the 32-bit words on a 64-bit host, so strings are read through dlsym
+		const char *strs = dlsym(b, "merge_b_strs");
+		CHECK(strs && strs == dlsym(a, "merge_a_strs") && !strcmp(strs, "shared one"));
+		CHECK(ref_at(b_fn, 0) == (uint32_t)(uintptr_t)strs);
+
+		if (order) close_strings(b, a, "merge_a_strs", &empty);
+		else close_strings(a, b, "merge_b_strs", &empty);
+	}
+	printf("merge: %d bytes held once for two modules, closed in either order\n", MERGE_COMMON);
+}
+
+/*=== Handles ===*/
+#define HANDLE_REUSES 4
+
+//A handle kept past its dlclose must be refused, also once another module sits in its slot
+static void test_handles(void)
+{
+	module_t mod = { "slot", NULL, NULL, 0, 0 };
+	if (!write_module("slot.o", &mod))
+	{
+		printf("handles: could not write slot.o\n");
+		++failures;
+		return;
+	}
+
+	//Each load takes the slot the previous one freed, kept in the low 8 bits of its handle, with a new generation
+	void *stale[HANDLE_REUSES];
+	for (int i = 0; i < HANDLE_REUSES; ++i)
+	{
+		stale[i] = dlopen(fixture_path("slot.o"), RTLD_NOW);
+		CHECK(stale[i] != NULL);
+		if (!stale[i]) return;
+
+		for (int j = 0; j < i; ++j)
+			CHECK(stale[j] != stale[i] && ((uintptr_t)stale[j] & 0xFF) == ((uintptr_t)stale[i] & 0xFF));
+		if (i < HANDLE_REUSES - 1) CHECK(!dlclose(stale[i]));
+	}
+
+	void *live = stale[HANDLE_REUSES - 1];
+	dlstats_t stats;
+	const char *names[1] = { "slot_fn" };
+	void *out[1];
+	for (int i = 0; i < HANDLE_REUSES - 1; ++i)
+	{
+		CHECK(!dlsym(stale[i], "slot_fn") && dlerror() != NULL);
+		CHECK(dlsym_many(stale[i], names, 1, out));
+		CHECK(dlstats(stale[i], &stats));
+		CHECK(dlclose(stale[i]));
+	}
+
+	//Refusing the stale handles left the module in the slot alone
+	CHECK(ref_at(dlsym(live, "slot_fn"), 1) == HOST_FN);
+	CHECK(!dlclose(live));
+	CHECK(dlclose(live));
+	CHECK(!dlsym((void*)(uintptr_t)0xFF, "slot_fn") && dlclose(NULL));
+	printf("handles: %d loads through one slot, stale handles refused\n", HANDLE_REUSES);
+}
+
+/*=== Module cache ===*/
+//Opening a cached path again is a hit, a module that does not fit evicts the least recently used one,
+//and using an evicted module reloads it behind the same handle
+static void test_cache(void)
+{
+	module_t mods[2] = { { "cache_a", NULL, NULL, 4096, 0 }, { "cache_b", NULL, NULL, 4096, 0 } };
+	if (!write_module("cache_a.o", &mods[0]) || !write_module("cache_b.o", &mods[1]))
+	{
+		printf("cache: could not write modules\n");
+		++failures;
+		return;
+	}
+
+	dlcachestats_t start, stats;
+	dlcachestats(&start);
+	CHECK(!dlcachebudget(1 << 20));
+	void *a = dlopen(fixture_path("cache_a.o"), RTLD_NOW);
+	CHECK(a != NULL && dlopen(fixture_path("cache_a.o"), RTLD_NOW) == a);
+	if (!a) return;
+
+	dlcachestats(&stats);
+	CHECK(stats.misses == start.misses + 1 && stats.hits == start.hits + 1);
+	CHECK(stats.modules == 1 && stats.resident == 1);
+	CHECK(!dlclose(a));
+
+	//Room for one of them, the second open evicts the first
+	size_t size = stats.used;
+	CHECK(!dlcachebudget(size + size / 2));
+	void *b = dlopen(fixture_path("cache_b.o"), RTLD_NOW);
+	CHECK(b != NULL);
+	if (!b) return;
+
+	dlcachestats(&stats);
+	CHECK(stats.evictions == start.evictions + 1 && stats.misses == start.misses + 2);
+	CHECK(stats.modules == 2 && stats.resident == 1 && stats.used <= stats.budget);
+
+	//Host builds hand out functions directly instead of reload stubs (stub.h), pinning and
+	//looking up go through the reload a stub call does
+	CHECK(!dlpin(a));
+	dlcachestats(&stats);
+	CHECK(stats.misses == start.misses + 3 && stats.evictions == start.evictions + 2 && stats.resident == 1);
+	CHECK(ref_at(dlsym(a, "cache_a_fn"), 1) == HOST_FN);
+	CHECK(!dlunpin(a) && dlunpin(a));
+
+	//The address handed out keeps the first module resident, so the cache goes over budget
+	CHECK(ref_at(dlsym(b, "cache_b_fn"), 0) == addr_of(b, "cache_b_data"));
+	dlcachestats(&stats);
+	CHECK(stats.misses == start.misses + 4 && stats.resident == 2 && stats.used > stats.budget);
+
+	CHECK(!dlclose(a));
+	CHECK(!dlclose(b));
+	CHECK(!dlcachebudget(0));
+	dlcachestats(&stats);
+	CHECK(stats.modules == 0 && stats.used == 0);
+	printf("cache: %zu hits, %zu misses, %zu evictions\n", stats.hits - start.hits, stats.misses - start.misses, stats.evictions - start.evictions);
+}
+
+/*=== Layout profiles ===*/
+//Each takes a section and its relocations, so the fixture keeps within FIX_SECTS
+#define LAYOUT_FUNCS 5
+
+//lay_f0..lay_f4, each in its own section as -ffunction-sections emits them, then lay_data
+static int write_sectioned_module(const char *file)
+{
+	fixture_t fix;
+	fix_init(&fix, ET_REL);
+
+	Elf32_Word host = fix_symbol(&fix, "host_fn", 0, 0, STB_GLOBAL, STT_NOTYPE, SHN_UNDEF);
+	for (int i = 0; i < LAYOUT_FUNCS; ++i)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), ".text.lay_f%d", i);
+		Elf32_Half text = fix_section(&fix, name, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 0, NULL, 0);
+		fix_symbol(&fix, name + 6, 0, 12, STB_GLOBAL, STT_FUNC, text);
+		fix_ref(&fix, text, host, 0);
+		put32(&fix.contents[text], INSN_BLR);
+	}
+
+	static const unsigned char data[16] = { 0 };
+	Elf32_Half data_sect = fix_section(&fix, ".data", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, 0, data, sizeof(data));
+	fix_symbol(&fix, "lay_data", 0, sizeof(data), STB_GLOBAL, STT_OBJECT, data_sect);
+	return fix_write(&fix, file);
+}
+
+//Profiled functions go first, each on its own cache line, the data next and the other functions last
+static void test_layout(void)
+{
+	FILE *profile = fopen(fixture_path("hot.txt"), "w");
+	int written = profile && fputs("# dlprofilewrite output\nlay_f4 120\nlay_f1 7\n\nlay_absent 3\n", profile) >= 0;
+	if (profile) fclose(profile);
+	if (!written || !write_sectioned_module("sectioned.o"))
+	{
+		printf("layout: could not write fixtures\n");
+		++failures;
+		return;
+	}
+
+	CHECK(dllayoutprofile(fixture_path("no_profile.txt")));
+	CHECK(!dllayoutprofile(fixture_path("hot.txt")));
+	void *handle = dlopen(fixture_path("sectioned.o"), RTLD_NOW);
+	CHECK(!dllayoutprofile(NULL));
+	CHECK(handle != NULL);
+	if (!handle) return;
+
+	uint32_t fn[LAYOUT_FUNCS];
+	for (int i = 0; i < LAYOUT_FUNCS; ++i)
+	{
+		char name[16];
+		snprintf(name, sizeof(name), "lay_f%d", i);
+		fn[i] = addr_of(handle, name);
+		CHECK(ref_at(dlsym(handle, name), 0) == HOST_FN);
+	}
+	uint32_t data = addr_of(handle, "lay_data");
+
+	//Hot ones in file order, one line apart, ahead of everything else
+	CHECK(fn[1] % 32 == 0 && fn[4] == fn[1] + 32);
+	CHECK(fn[4] < data);
+	int cold_last = 1;
+	for (int i = 0; i < LAYOUT_FUNCS; ++i)
+		cold_last &= i == 1 || i == 4 || fn[i] > data;
+	CHECK(cold_last);
+	CHECK(fn[0] < fn[2] && fn[2] < fn[3]);
+
+	dlstats_t stats;
+	CHECK(!dlstats(handle, &stats));
+	CHECK(stats.hot_lines == 2);
+	CHECK(!dlclose(handle));
+
+	//Without the profile, the file order is back
+	handle = dlopen(fixture_path("sectioned.o"), RTLD_NOW);
+	CHECK(handle != NULL);
+	if (!handle) return;
+
+	CHECK(addr_of(handle, "lay_f0") < addr_of(handle, "lay_f1") && addr_of(handle, "lay_f4") < addr_of(handle, "lay_data"));
+	CHECK(!dlstats(handle, &stats) && stats.hot_lines == 0);
+	CHECK(!dlclose(handle));
+	printf("layout: 2 hot functions of %d first, on 2 cache lines\n", LAYOUT_FUNCS);
+}
+
+/*=== Packs ===*/
+//A pack of one module, laid out as tools/dlpack writes it
+static int write_pack(const char *file, const char *module)
+{
+	unsigned char data[4096];
+	FILE *in = fopen(fixture_path(module), "rb");
+	size_t size = in ? fread(data, 1, sizeof(data), in) : 0;
+	if (in) fclose(in);
+	if (!size) return 0;
+
+	uint32_t names_offset = sizeof(pack_header_t) + sizeof(pack_entry_t);
+	uint32_t names_size = strlen(module) + 1;
+	uint32_t offset = (names_offset + names_size + PACK_DEFAULT_BLOCK - 1) / PACK_DEFAULT_BLOCK * PACK_DEFAULT_BLOCK;
+
+	buf_t out = { 0 };
+	put32(&out, PACK_MAGIC);
+	put32(&out, PACK_VERSION);
+	put32(&out, PACK_DEFAULT_BLOCK);
+	put32(&out, 1);
+	put32(&out, names_offset);
+	put32(&out, names_size);
+	put32(&out, sym_hash(module, 0));
+	put32(&out, 0);
+	put32(&out, offset);
+	put32(&out, size);
+	put32(&out, pack_fingerprint(data, size));
+	put_str(&out, module);
+	buf_grow(&out, offset - out.size);
+	memcpy(buf_grow(&out, size), data, size);
+
+	FILE *file_out = fopen(fixture_path(file), "wb");
+	int ok = file_out && fwrite(out.data, 1, out.size, file_out) == out.size;
+	if (file_out) fclose(file_out);
+	free(out.data);
+	return ok;
+}
+
+//Packed modules load, one changed after it was packed is refused
+static void test_pack(void)
+{
+	module_t mod = { "packed", NULL, NULL, 0, 4 };
+	if (!write_module("packed.o", &mod) || !write_pack("good.pack", "packed.o"))
+	{
+		printf("pack: could not write good.pack\n");
+		++failures;
+		return;
+	}
+
+	dl_pack_t *pack = dlpackopen(fixture_path("good.pack"));
+	CHECK(pack != NULL);
+	if (!pack) return;
+
+	//The second open finds the module already checked
+	for (int i = 0; i < 2; ++i)
+	{
+		void *handle = dlopen_pack(pack, "packed.o", RTLD_NOW);
+		CHECK(handle != NULL);
+		if (!handle) break;
+
+		CHECK(ref_at(dlsym(handle, "packed_fn"), 1) == HOST_FN);
+		CHECK(!dlclose(handle));
+	}
+	CHECK(!dlpackclose(pack));
+
+	//First byte of the module's .data, right after .text, still loads fine unless checked
+	static const unsigned char changed = 0xFF;
+	long data = PACK_DEFAULT_BLOCK + sizeof(Elf32_Ehdr) + (2 + mod.extra) * 8 + 4;
+	CHECK(copy_fixture("good.pack", "changed.pack", data, &changed, 1));
+	pack = dlpackopen(fixture_path("changed.pack"));
+	CHECK(pack != NULL);
+	if (!pack) return;
+
+	CHECK(dlopen_pack(pack, "packed.o", RTLD_NOW) == NULL && dlerror() != NULL);
+	CHECK(!dlpackclose(pack));
+	printf("pack: fingerprints checked\n");
+}
+
+/*=== I/O backends ===*/
+#define BACKEND_LOADS 50
+
+typedef int (*open_io_t)(const char *path, dl_io_t *io);
+
+static void *open_through(open_io_t open_io, const char *path)
+{
+	dl_io_t io;
+	if (open_io(path, &io))
+		return NULL;
+
+	return dlopen_io(&io, RTLD_NOW);
+}
+
+//Both backends must load the same image, then each loads the module repeatedly
+static void test_backends(void)
+{
+	static const char *const imports[] = { NULL };
+	module_t mod = { "big", imports, NULL, 4096, 4096 };
+	if (!write_module("big.o", &mod))
+	{
+		printf("backends: could not write big.o\n");
+		++failures;
+		return;
+	}
+
+	static const open_io_t backends[2] = { dl_io_open_stdio, dl_io_open_mmap };
+	static const char *const names[2] = { "stdio", "mmap" };
+	size_t text_size = (2 + mod.extra) * 8 + 4;
+	unsigned char *images[2] = { malloc(text_size), malloc(text_size) };
+	uint32_t bases[2];
+	double us[2];
+
+	for (int b = 0; b < 2; ++b)
+	{
+		void *handle = open_through(backends[b], fixture_path("big.o"));
+		CHECK(handle != NULL);
+		if (!handle)
+		{
+			printf("backends: %s failed: %s\n", names[b], dlerror());
+			free(images[0]); free(images[1]);
+			return;
+		}
+
+		bases[b] = addr_of(handle, "big_fn");
+		memcpy(images[b], dlsym(handle, "big_fn"), text_size);
+		CHECK(ref_at(images[b], 0) == addr_of(handle, "big_data"));
+		CHECK(ref_at(images[b], 1) == HOST_FN);
+		CHECK(ref_at(images[b], 2 + 4095) == addr_of(handle, "big_data") + 12);
+		CHECK(addr_of(handle, "big_fn4095") == bases[b] + (2 + 4095) * 8);
+		dlclose(handle);
+
+		double start = now_us();
+		for (int i = 0; i < BACKEND_LOADS; ++i)
+		{
+			handle = open_through(backends[b], fixture_path("big.o"));
+			if (handle) dlclose(handle);
+		}
+		us[b] = (now_us() - start) / BACKEND_LOADS;
+	}
+
+	//Released modules leave the pool as it was, so both land at the same place
+	CHECK(bases[0] == bases[1]);
+	CHECK(!memcmp(images[0], images[1], text_size));
+	printf("backends: %zu symbols, %zu relocations: stdio %.0fus, mmap %.0fus per load\n",
+		(size_t)mod.extra + 3, (size_t)(2 + mod.extra) * 2, us[0], us[1]);
+
+	free(images[0]);
+	free(images[1]);
+}
+
+/*=== Incremental loads ===*/
+//Steps a load to its end under a budget of 0, a single chunk each, timing the longest one
+static void *step_load(const char *file, int *steps, double *longest_us)
+{
+	dl_load_t *load = dlopen_begin(fixture_path(file), RTLD_NOW);
+	if (!load) return NULL;
+
+	int state = DL_STEP_MORE;
+	*steps = 0;
+	*longest_us = 0;
+	while (state == DL_STEP_MORE)
+	{
+		double start = now_us();
+		state = dlopen_step(load, 0);
+		double us = now_us() - start;
+		if (us > *longest_us) *longest_us = us;
+		++*steps;
+	}
+
+	return dlopen_finish(load);
+}
+
+//Every phase, table reads, collection and symbol parsing included, must go in chunks
+static void test_incremental(void)
+{
+	//big.o from the backends test, 4099 symbols and 8196 relocations
+	double start = now_us();
+	void *whole = dlopen(fixture_path("big.o"), RTLD_NOW);
+	double whole_us = now_us() - start;
+	CHECK(whole != NULL);
+	if (!whole) return;
+
+	uint32_t base = addr_of(whole, "big_fn");
+	CHECK(!dlclose(whole));
+
+	int steps;
+	double longest_us;
+	void *handle = step_load("big.o", &steps, &longest_us);
+	CHECK(handle != NULL);
+	if (!handle)
+	{
+		printf("incremental: load failed: %s\n", dlerror());
+		return;
+	}
+
+	//Relocations are read once to collect and once to apply, 64 a chunk, symbols go 256 a chunk
+	CHECK(steps > 2 * 8196 / 64 + 4 * 4100 / 256);
+	CHECK(addr_of(handle, "big_fn") == base);
+	CHECK(ref_at(dlsym(handle, "big_fn"), 1) == HOST_FN);
+	CHECK(ref_at(dlsym(handle, "big_fn"), 2 + 4095) == addr_of(handle, "big_data") + 12);
+	CHECK(!dlclose(handle));
+
+	//Cancelled while walking the relocation graph, the load gives everything back
+	dlpoolstats_t before, after;
+	dlpoolstats(&before);
+	dl_load_t *load = dlopen_begin(fixture_path("big.o"), RTLD_NOW);
+	CHECK(load != NULL);
+	for (int i = 0; load && i < 100; ++i)
+		CHECK(dlopen_step(load, 0) == DL_STEP_MORE);
+	CHECK(!load || !dlopen_finish(load));
+	dlpoolstats(&after);
+	CHECK(after.used == before.used);
+
+	printf("incremental: %d steps, longest %.0fus, whole load %.0fus\n", steps, longest_us, whole_us);
+}
+
+/*=== Threads ===*/
+#define STRESS_READERS 4
+#define STRESS_ROUNDS 2000
+
+typedef struct {
+	void *stable;
+	uint32_t stable_data;
+	void *churn;
+	int stop;
+} stress_t;
+
+typedef struct {
+	stress_t *stress;
+	unsigned long lookups, wrong, unreported;
+} reader_t;
+
+//Looks up a module that stays loaded and one loaded and closed under it
+static void *stress_reader(void *ptr)
+{
+	reader_t *reader = ptr;
+	stress_t *stress = reader->stress;
+
+	while (!__atomic_load_n(&stress->stop, __ATOMIC_ACQUIRE))
+	{
+		if (addr_of(stress->stable, "stable_data") != stress->stable_data)
+			++reader->wrong;
+
+		//The lookup fails when the module was closed first, and the error is this thread's own
+		void *churn = __atomic_load_n(&stress->churn, __ATOMIC_ACQUIRE);
+		if (!dlsym(churn, "churn_data") && !dlerror())
+			++reader->unreported;
+
+		++reader->lookups;
+	}
+
+	return NULL;
+}
+
+//dlsym from several threads while the main thread keeps loading and closing
+static void test_threads(void)
+{
+	module_t stable = { "stable", NULL, NULL, 0, 0 };
+	module_t churn = { "churn", NULL, NULL, 256, 64 };
+	if (!write_module("stable.o", &stable) || !write_module("churn.o", &churn))
+	{
+		printf("threads: could not write modules\n");
+		++failures;
+		return;
+	}
+
+	stress_t stress = { 0 };
+	stress.stable = dlopen(fixture_path("stable.o"), RTLD_NOW);
+	CHECK(stress.stable != NULL);
+	if (!stress.stable) return;
+	stress.stable_data = addr_of(stress.stable, "stable_data");
+
+	pthread_t threads[STRESS_READERS];
+	reader_t readers[STRESS_READERS];
+	int started = 0;
+	for (; started < STRESS_READERS; ++started)
+	{
+		readers[started] = (reader_t){ &stress, 0, 0, 0 };
+		if (pthread_create(&threads[started], NULL, stress_reader, &readers[started])) break;
+	}
+	CHECK(started == STRESS_READERS);
+
+	dlerror();
+	int failed = 0, unlinked = 0;
+	for (int round = 0; round < STRESS_ROUNDS; ++round)
+	{
+		void *handle = dlopen(fixture_path("churn.o"), RTLD_NOW);
+		if (!handle)
+		{
+			++failed;
+			continue;
+		}
+
+		__atomic_store_n(&stress.churn, handle, __ATOMIC_RELEASE);
+		if (ref_at(dlsym(handle, "churn_fn"), 1) != HOST_FN) ++unlinked;
+		dlclose(handle);
+	}
+
+	__atomic_store_n(&stress.stop, 1, __ATOMIC_RELEASE);
+	unsigned long lookups = 0;
+	for (int i = 0; i < started; ++i)
+	{
+		pthread_join(threads[i], NULL);
+		CHECK(readers[i].lookups > 0);
+		CHECK(!readers[i].wrong);
+		CHECK(!readers[i].unreported);
+		lookups += readers[i].lookups;
+	}
+
+	CHECK(!failed);
+	CHECK(!unlinked);
+	//Readers failing lookups leave the main thread's error alone
+	CHECK(dlerror() == NULL);
+	CHECK(!dlclose(stress.stable));
+	printf("threads: %d readers, %lu lookups during %d loads and closes\n", started, lookups, STRESS_ROUNDS);
+}
+
+/*=== Pool ===*/
+#define SOAK_MODULES 8
+#define SOAK_LIVE 12
+#define SOAK_ROUNDS 4000
+//Past the first rounds, most of the pool's free memory must stay in one block
+#define SOAK_MAX_FRAGMENTATION 500
+
+//Random loads and closes of modules of very different sizes must not leave the pool in pieces
+static void test_pool_soak(void)
+{
+	char files[SOAK_MODULES][16];
+	for (int i = 0; i < SOAK_MODULES; ++i)
+	{
+		char name[16];
+		snprintf(name, sizeof(name), "soak%d", i);
+		snprintf(files[i], sizeof(files[i]), "soak%d.o", i);
+		module_t mod = { name, NULL, NULL, (size_t)4096 << i, 8 * i };
+		if (!write_module(files[i], &mod))
+		{
+			printf("pool: could not write %s\n", files[i]);
+			++failures;
+			return;
+		}
+	}
+
+	void *live[SOAK_LIVE] = { 0 };
+	unsigned worst = 0;
+	int failed = 0;
+	srand(35);
+
+	for (int round = 0; round < SOAK_ROUNDS; ++round)
+	{
+		int k = rand() % SOAK_LIVE;
+		if (live[k])
+		{
+			CHECK(!dlclose(live[k]));
+			live[k] = NULL;
+		}
+		else if (!(live[k] = dlopen(fixture_path(files[rand() % SOAK_MODULES]), RTLD_NOW)))
+			++failed;
+
+		dlpoolstats_t stats;
+		dlpoolstats(&stats);
+		if (round > SOAK_ROUNDS / 10 && stats.fragmentation > worst) worst = stats.fragmentation;
+	}
+
+	for (int k = 0; k < SOAK_LIVE; ++k)
+	{
+		if (live[k]) dlclose(live[k]);
+	}
+
+	dlpoolstats_t stats;
+	dlpoolstats(&stats);
+	CHECK(!failed);
+	CHECK(!stats.heap_fallbacks);
+	CHECK(worst <= SOAK_MAX_FRAGMENTATION);
+	//Once everything is closed, the pool is back to a single free block
+	CHECK(stats.used == 0);
+	CHECK(stats.free_blocks == 1 && stats.largest_free == stats.free);
+	printf("pool: %d rounds, worst fragmentation %u/1000, %zu free blocks at the end\n", SOAK_ROUNDS, worst, stats.free_blocks);
+}
+
+/*=== Compaction ===*/
+//A module moves only if every module resolving into it can have its relocations re-applied
+static void test_compact(void)
+{
+	static const char *const peer_imports[] = { "peer_a_fn", NULL };
+	const module_t mods[] = {
+		{ "spacer", NULL, NULL, 4096, 0 },
+		{ "owner", NULL, "shared_grp", 0, 0 },
+		{ "user", NULL, "shared_grp", 0, 0 },
+		{ "peer_a", NULL, NULL, 0, 0 },
+		{ "peer_b", peer_imports, NULL, 0, 0 },
+	};
+	char paths[5][sizeof(dir) + 256];
+	for (int i = 0; i < 5; ++i)
+	{
+		char file[32];
+		snprintf(file, sizeof(file), "%s.o", mods[i].name);
+		snprintf(paths[i], sizeof(paths[i]), "%s", fixture_path(file));
+		if (!write_module(file, &mods[i]))
+		{
+			printf("compact: could not write %s\n", file);
+			++failures;
+			return;
+		}
+	}
+
+	//Holes below the owner and the batch, the owner retains its records and its user does not
+	void *spacer_low = dlopen(paths[0], RTLD_NOW);
+	dlretainrelocs(1);
+	void *owner = dlopen(paths[1], RTLD_NOW);
+	dlretainrelocs(0);
+	void *user = dlopen(paths[2], RTLD_NOW);
+	void *spacer_high = dlopen(paths[0], RTLD_NOW);
+	dlretainrelocs(1);
+	void *peers[2] = { 0 };
+	const char *batch[2] = { paths[3], paths[4] };
+	CHECK(!dlopen_many(batch, 2, RTLD_NOW, peers));
+	dlretainrelocs(0);
+	CHECK(spacer_low && owner && user && spacer_high && peers[0] && peers[1]);
+	if (!spacer_low || !owner || !user || !spacer_high || !peers[0] || !peers[1]) return;
+
+	uint32_t owner_fn = addr_of(owner, "owner_fn"), peer_fn = addr_of(peers[0], "peer_a_fn");
+	CHECK(ref_at(dlsym(user, "user_fn"), 2) == addr_of(owner, "shared_grp"));
+	CHECK(!dlclose(spacer_low));
+	CHECK(!dlclose(spacer_high));
+
+	CHECK(!dlcompact(NULL, NULL));
+	//The user could not follow the owner's group, so the owner stays
+	CHECK(addr_of(owner, "owner_fn") == owner_fn);
+	CHECK(ref_at(dlsym(user, "user_fn"), 2) == addr_of(owner, "shared_grp"));
+	//The batch retained its records as a whole and moves down together
+	long batch_delta = (long)addr_of(peers[0], "peer_a_fn") - (long)peer_fn;
+	CHECK(batch_delta < 0);
+	CHECK(ref_at(dlsym(peers[1], "peer_b_fn"), 2) == addr_of(peers[0], "peer_a_fn"));
+	CHECK(ref_at(dlsym(peers[0], "peer_a_fn"), 0) == addr_of(peers[0], "peer_a_data"));
+	CHECK(ref_at(dlsym(peers[1], "peer_b_fn"), 1) == HOST_FN);
+
+	//Without the user, the owner is free to move
+	CHECK(!dlclose(user));
+	CHECK(!dlcompact(NULL, NULL));
+	CHECK(addr_of(owner, "owner_fn") < owner_fn);
+	CHECK(ref_at(dlsym(owner, "owner_fn"), 2) == addr_of(owner, "shared_grp"));
+	CHECK(ref_at(dlsym(owner, "owner_fn"), 0) == addr_of(owner, "owner_data"));
+
+	CHECK(!dlclose(owner));
+	CHECK(!dlclose(peers[0]));
+	CHECK(!dlclose(peers[1]));
+	printf("compact: owner kept in place for its user, batch moved by %ld bytes\n", batch_delta);
+}
+
+/*=== Symbol tables ===*/
+#define LAYOUT_SYMS 4000
+#define LAYOUT_LOOKUPS 2000
+
+//Rows as symbols and retained relocations were kept before the column layout
+typedef struct {
+	char *name;
+	Elf32_Addr value;
+	unsigned char bind;
+	unsigned char type;
+	int section;
+	void *address;
+} row_symbol_t;
+
+typedef struct {
+	char *name;
+	Elf32_Off offset;
+	Elf32_Sword addend;
+	Elf32_Half section;
+	unsigned char rel_type;
+	void *resolved;
+} row_relocation_t;
+
+//Column scans and the index must find what a scan of the old rows finds, then both are timed
+static void test_symtab(void)
+{
+	//Names share a long prefix, as C++ and namespaced C symbols do
+	static const char prefix[] = "plugin_component_subsystem_symbol_";
+	size_t name_size = sizeof(prefix) + 8;
+	char *strs = malloc(LAYOUT_SYMS * name_size);
+	row_symbol_t *rows = malloc(LAYOUT_SYMS * sizeof(row_symbol_t));
+	for (size_t i = 0; strs && rows && i < LAYOUT_SYMS; ++i)
+	{
+		char *name = &strs[i * name_size];
+		snprintf(name, name_size, "%s%05zu", prefix, i);
+		rows[i] = (row_symbol_t){ name, i * 4, STB_GLOBAL, STT_FUNC, 1, NULL };
+	}
+
+	symtab_t tab;
+	symindex_t index = { 0 };
+	if (!strs || !rows || !symtab_init(&tab, NULL, LAYOUT_SYMS, strs, strs))
+	{
+		printf("symtab: out of memory\n");
+		++failures;
+		free(strs);
+		free(rows);
+		return;
+	}
+
+	for (size_t i = 0; i < LAYOUT_SYMS; ++i)
+	{
+		tab.names[i] = i * name_size;
+		tab.hashes[i] = sym_hash(rows[i].name, 0);
+		tab.values[i] = i * 4;
+		tab.sections[i] = 1;
+		tab.info[i] = ELF32_ST_INFO(STB_GLOBAL, STT_FUNC);
+		tab.addresses[i] = NULL;
+	}
+
+	//The index is sized from the count, as index_module_symbols does once the rows are in
+	tab.count = LAYOUT_SYMS;
+	CHECK(symindex_init(&index, &tab, NULL));
+	for (size_t i = 0; index.slots && i < LAYOUT_SYMS; ++i)
+		symindex_add(&index, i);
+
+	//Lookups spread over the table, as relocations reach symbols all over it
+	const char *names[LAYOUT_LOOKUPS];
+	for (size_t i = 0; i < LAYOUT_LOOKUPS; ++i)
+		names[i] = rows[(i * 7919) % LAYOUT_SYMS].name;
+
+	size_t found_rows = 0, found_cols = 0, found_index = 0;
+	double start = now_us();
+	for (size_t i = 0; i < LAYOUT_LOOKUPS; ++i)
+	{
+		for (size_t r = 0; r < LAYOUT_SYMS; ++r)
+		{
+			if (!strcmp(rows[r].name, names[i]))
+			{
+				found_rows += r;
+				break;
+			}
+		}
+	}
+	double rows_us = now_us() - start;
+
+	start = now_us();
+	for (size_t i = 0; i < LAYOUT_LOOKUPS; ++i)
+		found_cols += symtab_next(&tab, names[i], sym_hash(names[i], 0), 0);
+	double cols_us = now_us() - start;
+
+	start = now_us();
+	for (size_t i = 0; i < LAYOUT_LOOKUPS; ++i)
+		found_index += symindex_get(&index, names[i]);
+	double index_us = now_us() - start;
+
+	CHECK(found_cols == found_rows);
+	CHECK(found_index == found_rows);
+	CHECK(symtab_next(&tab, "plugin_component_subsystem_symbol_x", sym_hash("plugin_component_subsystem_symbol_x", 0), 0) == SYMTAB_NONE);
+	CHECK(symtab_bytes(1) < sizeof(row_symbol_t));
+	CHECK(reltab_bytes(1) < sizeof(row_relocation_t));
+
+	printf("symtab: %d symbols, bytes per symbol %zu -> %zu (+%zu -> %zu per index slot), per relocation %zu -> %zu\n",
+		LAYOUT_SYMS, sizeof(row_symbol_t), symtab_bytes(1), sizeof(void*), sizeof(uint32_t), sizeof(row_relocation_t), reltab_bytes(1));
+	printf("symtab: %d lookups, row scan %.0fus, hash column scan %.0fus, index %.0fus\n", LAYOUT_LOOKUPS, rows_us, cols_us, index_us);
+
+	symindex_free(&index, NULL);
+	symtab_free(&tab, NULL);
+	free(strs);
+	free(rows);
+}
+
+/*=== Byte swapping ===*/
+#define SWAP_SYMS 100000
+#define SWAP_REPS 200
+
+#if ELF_NEEDS_SWAP
+//Field by field, as the tables were swapped before the bulk kernels
+static void swap_syms_fields(Elf32_Sym *syms, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		syms[i].st_name = __builtin_bswap32(syms[i].st_name);
+		syms[i].st_value = __builtin_bswap32(syms[i].st_value);
+		syms[i].st_size = __builtin_bswap32(syms[i].st_size);
+		syms[i].st_shndx = __builtin_bswap16(syms[i].st_shndx);
+	}
+}
+
+static void swap_relas_fields(Elf32_Rela *relas, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		relas[i].r_offset = __builtin_bswap32(relas[i].r_offset);
+		relas[i].r_info = __builtin_bswap32(relas[i].r_info);
+		relas[i].r_addend = (Elf32_Sword)__builtin_bswap32((uint32_t)relas[i].r_addend);
+	}
+}
+
+//Bulk kernels must match the field by field swap, then the symbol table kernel is timed against it
+static void test_swap(void)
+{
+	//Odd counts, so the kernels' tails are covered too
+	size_t bytes = SWAP_SYMS * sizeof(Elf32_Sym);
+	Elf32_Sym *syms = malloc(bytes), *expected = malloc(bytes);
+	Elf32_Rela *relas = malloc((SWAP_SYMS - 1) * sizeof(Elf32_Rela)), *expected_relas = malloc((SWAP_SYMS - 1) * sizeof(Elf32_Rela));
+	if (!syms || !expected || !relas || !expected_relas)
+	{
+		printf("swap: out of memory\n");
+		++failures;
+		free(syms); free(expected); free(relas); free(expected_relas);
+		return;
+	}
+
+	srand(37);
+	for (size_t i = 0; i < bytes; ++i) ((unsigned char*)syms)[i] = rand();
+	for (size_t i = 0; i < (SWAP_SYMS - 1) * sizeof(Elf32_Rela); ++i) ((unsigned char*)relas)[i] = rand();
+
+	memcpy(expected, syms, bytes);
+	swap_syms_fields(expected, SWAP_SYMS - 1);
+	elf_swap_syms(syms, SWAP_SYMS - 1);
+	CHECK(!memcmp(syms, expected, bytes));
+
+	memcpy(expected_relas, relas, (SWAP_SYMS - 1) * sizeof(Elf32_Rela));
+	swap_relas_fields(expected_relas, SWAP_SYMS - 1);
+	elf_swap_relas(relas, SWAP_SYMS - 1);
+	CHECK(!memcmp(relas, expected_relas, (SWAP_SYMS - 1) * sizeof(Elf32_Rela)));
+
+	uint32_t *words = (uint32_t*)expected_relas;
+	size_t word_count = (SWAP_SYMS - 1) * sizeof(Elf32_Rela) / sizeof(uint32_t) - 1;
+	memcpy(words, relas, word_count * sizeof(uint32_t));
+	elf_swap_words(words, word_count);
+	int words_match = 1;
+	for (size_t i = 0; i < word_count; ++i)
+		words_match &= words[i] == __builtin_bswap32(((uint32_t*)relas)[i]);
+	CHECK(words_match);
+
+	double start = now_us();
+	for (int i = 0; i < SWAP_REPS; ++i) swap_syms_fields(expected, SWAP_SYMS);
+	double fields_us = (now_us() - start) / SWAP_REPS;
+
+	start = now_us();
+	for (int i = 0; i < SWAP_REPS; ++i) elf_swap_syms(syms, SWAP_SYMS);
+	double bulk_us = (now_us() - start) / SWAP_REPS;
+
+	//An even number of passes leaves both back in file order
+	CHECK(!memcmp(syms, expected, bytes));
+	printf("swap: %d symbols, field by field %.0fus, bulk %.0fus (%.2f GB/s)\n", SWAP_SYMS, fields_us, bulk_us, bytes / bulk_us / 1e3);
+
+	free(syms);
+	free(expected);
+	free(relas);
+	free(expected_relas);
+}
+#else
+static void test_swap(void)
+{
+	printf("swap: big-endian host, nothing to swap\n");
+}
+#endif
+
+/*=== Real-time mode ===*/
+static void *open_rt(const char *file)
+{
+	return open_through(dl_io_open_stdio, fixture_path(file));
+}
+
+//Modules over a limit are refused from their headers, loads that would need the heap are refused,
+//and those within the limits take neither the pool nor the heap. Switching is for good, so this runs last
+static void test_realtime(void)
+{
+	module_t small = { "rt_small", NULL, NULL, 64, 0 };
+	module_t wide = { "rt_wide", NULL, NULL, 4096, 0 };
+	if (!write_module("rt_small.o", &small) || !write_module("rt_wide.o", &wide))
+	{
+		printf("realtime: could not write modules\n");
+		++failures;
+		return;
+	}
+
+	//rt_small.o has 8 sections, 5 symbols and 4 relocations
+	dlrtlimits_t limits = { 2, 12, 16, 16, 256, 1024 };
+	size_t size = dlrtsize(&limits);
+	void *mem = map_low(size);
+	CHECK(mem != NULL);
+	if (!mem) return;
+
+	void *loaded = dlopen(fixture_path("rt_small.o"), RTLD_NOW);
+	CHECK(loaded && dlinit_rt(mem, size, &limits));
+	CHECK(!loaded || !dlclose(loaded));
+	CHECK(dlinit_rt(mem, size - 1, &limits));
+	CHECK(!dlinit_rt(mem, size, &limits));
+
+	dlpoolstats_t before, after;
+	dlpoolstats(&before);
+
+	static const char *roots[] = { "rt_small_fn", NULL };
+	const char *batch[1] = { fixture_path("rt_small.o") };
+	void *handles[1];
+	CHECK(!dlopen(fixture_path("rt_small.o"), RTLD_NOW) && strstr(dlerror(), "real-time"));
+	CHECK(!dlopen_roots(fixture_path("rt_small.o"), RTLD_NOW, roots) && dlerror() != NULL);
+	CHECK(!dlopen_begin(fixture_path("rt_small.o"), RTLD_NOW) && dlerror() != NULL);
+	CHECK(dlopen_many(batch, 1, RTLD_NOW, handles) && dlerror() != NULL);
+	CHECK(dlcachebudget(1 << 20));
+
+	//Each over a different limit: sections, symbols, image
+	CHECK(!open_rt("sectioned.o") && strstr(dlerror(), "sections"));
+	CHECK(!open_rt("big.o") && strstr(dlerror(), "symbols"));
+	CHECK(!open_rt("rt_wide.o") && strstr(dlerror(), "image"));
+
+	//The refused modules gave their regions back, both fit
+	void *first = open_rt("rt_small.o");
+	void *second = open_rt("rt_small.o");
+	CHECK(first && second);
+	if (!first || !second) return;
+
+	CHECK(ref_at(dlsym(first, "rt_small_fn"), 1) == HOST_FN);
+	CHECK(ref_at(dlsym(second, "rt_small_fn"), 0) == addr_of(second, "rt_small_data"));
+	uintptr_t fn = (uintptr_t)dlsym(first, "rt_small_fn");
+	CHECK(fn >= (uintptr_t)mem && fn < (uintptr_t)mem + size);
+	CHECK(!open_rt("rt_small.o") && strstr(dlerror(), "Too many"));
+
+	dlpoolstats(&after);
+	CHECK(after.used == before.used && after.heap_fallbacks == before.heap_fallbacks);
+	CHECK(!dlclose(first));
+	CHECK(!dlclose(second));
+	printf("realtime: %zu bytes for %d modules, heap loads and modules over the limits refused\n", size, limits.modules);
+}
+
+int main(void)
+{
+	setvbuf(stdout, NULL, _IONBF, 0);
+	if (!setup()) return 1;
+
+	test_parser();
+	test_check();
+	test_collect();
+	test_batch();
+	test_sections();
+	test_bulk();
+	test_merge();
+	test_handles();
+	test_cache();
+	test_layout();
+	test_pack();
+	test_backends();
+	test_incremental();
+	test_threads();
+	test_pool_soak();
+	test_compact();
+	test_symtab();
+	test_swap();
+	test_realtime();
+
+	if (failures) printf("%d checks failed\n", failures);
+	else printf("all checks passed\n");
+	return failures != 0;
+}
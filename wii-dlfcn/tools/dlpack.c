@@ -0,0 +1,176 @@
+//Packs modules into one file for dlpackopen/dlopen_pack, so a set of modules costs one open
+//Usage: dlpack [--block N] -o out.pack module.o...
+//  --block N   alignment of every module in the pack (default: 512, the device sector)
+//Modules are stored under their file name, without directories
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "packfmt.h"
+#include "symhash.h"
+
+typedef struct {
+	const char *name;
+	unsigned char *data;
+	uint32_t size;
+	uint32_t name_hash;
+	uint32_t name_offset;
+	uint32_t offset;
+} module_t;
+
+static int compare_modules(const void *a, const void *b)
+{
+	const module_t *ma = a, *mb = b;
+	if (ma->name_hash != mb->name_hash) return ma->name_hash < mb->name_hash ? -1 : 1;
+	return strcmp(ma->name, mb->name);
+}
+
+static const char *base_name(const char *path)
+{
+	const char *slash = strrchr(path, '/');
+	return slash ? slash + 1 : path;
+}
+
+static unsigned char *read_file(const char *path, uint32_t *size)
+{
+	FILE *file = fopen(path, "rb");
+	if (!file) return NULL;
+
+	unsigned char *data = NULL;
+	long len;
+	if (!fseek(file, 0, SEEK_END) && (len = ftell(file)) >= 0 && len <= UINT32_MAX && !fseek(file, 0, SEEK_SET))
+	{
+		data = malloc(len ? len : 1);
+		if (data && fread(data, 1, len, file) != (size_t)len)
+		{
+			free(data);
+			data = NULL;
+		}
+		*size = (uint32_t)len;
+	}
+
+	fclose(file);
+	return data;
+}
+
+static void put_word(unsigned char *out, uint32_t word)
+{
+	out[0] = word >> 24;
+	out[1] = word >> 16;
+	out[2] = word >> 8;
+	out[3] = word;
+}
+
+static uint32_t align_up(uint32_t value, uint32_t align)
+{
+	return (value + align - 1) / align * align;
+}
+
+static int write_pack(FILE *out, module_t *modules, uint32_t count, uint32_t block)
+{
+	//Names are laid out once for the whole pack
+	uint32_t names_size = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		modules[i].name_offset = names_size;
+		names_size += strlen(modules[i].name) + 1;
+	}
+
+	uint32_t names_offset = sizeof(pack_header_t) + count * sizeof(pack_entry_t);
+	uint32_t offset = align_up(names_offset + names_size, block);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		modules[i].offset = offset;
+		offset = align_up(offset + modules[i].size, block);
+	}
+
+	unsigned char *image = calloc(offset, 1);
+	if (!image) return 0;
+
+	uint32_t header[PACK_HEADER_WORDS] = { PACK_MAGIC, PACK_VERSION, block, count, names_offset, names_size };
+	for (size_t w = 0; w < PACK_HEADER_WORDS; ++w)
+		put_word(&image[w * 4], header[w]);
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		module_t *module = &modules[i];
+		uint32_t entry[PACK_ENTRY_WORDS] = { module->name_hash, module->name_offset, module->offset, module->size, pack_fingerprint(module->data, module->size) };
+		for (size_t w = 0; w < PACK_ENTRY_WORDS; ++w)
+			put_word(&image[sizeof(pack_header_t) + i * sizeof(pack_entry_t) + w * 4], entry[w]);
+
+		memcpy(&image[names_offset + module->name_offset], module->name, strlen(module->name) + 1);
+		memcpy(&image[module->offset], module->data, module->size);
+	}
+
+	int ok = fwrite(image, 1, offset, out) == offset;
+	free(image);
+	return ok;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: dlpack [--block N] -o out.pack module.o...\n");
+}
+
+int main(int argc, char **argv)
+{
+	const char *out_path = NULL;
+	uint32_t block = PACK_DEFAULT_BLOCK;
+	module_t *modules = calloc(argc, sizeof(module_t));
+	uint32_t count = 0;
+	if (!modules) return 1;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-o") && i + 1 < argc) out_path = argv[++i];
+		else if (!strcmp(argv[i], "--block") && i + 1 < argc) block = (uint32_t)strtoul(argv[++i], NULL, 0);
+		else if (argv[i][0] != '-') modules[count++].name = argv[i];
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+
+	if (!out_path || !count || !block)
+	{
+		usage();
+		return 1;
+	}
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const char *path = modules[i].name;
+		modules[i].data = read_file(path, &modules[i].size);
+		if (!modules[i].data)
+		{
+			fprintf(stderr, "dlpack: failed to read %s\n", path);
+			return 1;
+		}
+
+		modules[i].name = base_name(path);
+		modules[i].name_hash = sym_hash(modules[i].name, 0);
+	}
+
+	qsort(modules, count, sizeof(module_t), compare_modules);
+	for (uint32_t i = 1; i < count; ++i)
+	{
+		if (!strcmp(modules[i - 1].name, modules[i].name))
+		{
+			fprintf(stderr, "dlpack: %s given twice\n", modules[i].name);
+			return 1;
+		}
+	}
+
+	FILE *out = fopen(out_path, "wb");
+	if (!out || !write_pack(out, modules, count, block))
+	{
+		fprintf(stderr, "dlpack: failed to write %s\n", out_path);
+		return 1;
+	}
+
+	fclose(out);
+	return 0;
+}
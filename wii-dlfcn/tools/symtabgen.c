@@ -0,0 +1,213 @@
+//Generates the static host symbol table for dlinit_static from 'nm -g --defined-only' output
+//Usage: nm -g --defined-only boot.elf | symtabgen > dl_static_symtab.c
+//       symtabgen --empty > dl_static_symtab.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "symhash.h"
+
+#define MAX_LINE 1024
+#define MAX_DISPLACEMENT 0x1000000
+
+typedef struct {
+	char *name;
+	uint32_t address;
+} entry_t;
+
+typedef struct {
+	uint32_t index;
+	uint32_t size;
+	uint32_t *keys;
+} bucket_t;
+
+static int compare_entries(const void *a, const void *b)
+{
+	return strcmp(((const entry_t*)a)->name, ((const entry_t*)b)->name);
+}
+
+static int compare_buckets(const void *a, const void *b)
+{
+	const bucket_t *ba = a, *bb = b;
+	if (ba->size != bb->size) return ba->size < bb->size ? 1 : -1;
+	return ba->index < bb->index ? -1 : ba->index > bb->index;
+}
+
+static entry_t *read_symbols(FILE *in, uint32_t *count)
+{
+	char line[MAX_LINE];
+	size_t cap = 256;
+	entry_t *entries = malloc(cap * sizeof(entry_t));
+	*count = 0;
+
+	while (entries && fgets(line, sizeof(line), in))
+	{
+		char type, name[MAX_LINE];
+		unsigned long address;
+
+		if (3 != sscanf(line, "%lx %c %1023s", &address, &type, name))
+			continue;
+
+		//The table itself must not change the symbol set between links
+		if (!strncmp(name, "dl_static_", 10))
+			continue;
+
+		if (*count == cap)
+		{
+			cap *= 2;
+			entry_t *grown = realloc(entries, cap * sizeof(entry_t));
+			if (!grown) { free(entries); return NULL; }
+			entries = grown;
+		}
+
+		entries[*count].name = strdup(name);
+		entries[*count].address = (uint32_t)address;
+		++*count;
+	}
+
+	return entries;
+}
+
+static int build_hash(entry_t *entries, uint32_t count, int32_t *disp, uint32_t *order)
+{
+	bucket_t *buckets = calloc(count, sizeof(bucket_t));
+	uint32_t *bucket_keys = malloc(count * sizeof(uint32_t));
+	char *taken = calloc(count, 1);
+	uint32_t *slots = malloc(count * sizeof(uint32_t));
+	if (!buckets || !bucket_keys || !taken || !slots)
+		goto _build_hash_error;
+
+	//Distribute keys among buckets
+	for (uint32_t i = 0; i < count; ++i)
+		++buckets[sym_hash(entries[i].name, 0) % count].size;
+
+	uint32_t *next = bucket_keys;
+	for (uint32_t b = 0; b < count; ++b)
+	{
+		buckets[b].index = b;
+		buckets[b].keys = next;
+		next += buckets[b].size;
+		buckets[b].size = 0;
+	}
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		bucket_t *bucket = &buckets[sym_hash(entries[i].name, 0) % count];
+		bucket->keys[bucket->size++] = i;
+	}
+
+	//Place the largest buckets first, searching for a displacement that fits them
+	qsort(buckets, count, sizeof(bucket_t), compare_buckets);
+
+	uint32_t b = 0;
+	for (; b < count && buckets[b].size > 1; ++b)
+	{
+		bucket_t *bucket = &buckets[b];
+		uint32_t d = 1;
+
+		for (; d < MAX_DISPLACEMENT; ++d)
+		{
+			uint32_t k = 0;
+			for (; k < bucket->size; ++k)
+			{
+				slots[k] = sym_hash(entries[bucket->keys[k]].name, d) % count;
+				if (taken[slots[k]]) break;
+
+				uint32_t j = 0;
+				while (j < k && slots[j] != slots[k]) ++j;
+				if (j != k) break;
+			}
+			if (k == bucket->size) break;
+		}
+
+		if (d == MAX_DISPLACEMENT)
+			goto _build_hash_error;
+
+		disp[bucket->index] = (int32_t)d;
+		for (uint32_t k = 0; k < bucket->size; ++k)
+		{
+			taken[slots[k]] = 1;
+			order[slots[k]] = bucket->keys[k];
+		}
+	}
+
+	//Single key buckets take the remaining slots directly
+	uint32_t free_slot = 0;
+	for (; b < count && buckets[b].size == 1; ++b)
+	{
+		while (taken[free_slot]) ++free_slot;
+
+		disp[buckets[b].index] = -(int32_t)free_slot - 1;
+		taken[free_slot] = 1;
+		order[free_slot] = buckets[b].keys[0];
+	}
+
+	free(buckets); free(bucket_keys); free(taken); free(slots);
+	return 1;
+
+_build_hash_error:
+	free(buckets); free(bucket_keys); free(taken); free(slots);
+	return 0;
+}
+
+static void write_table(FILE *out, entry_t *entries, uint32_t count, int32_t *disp, uint32_t *order)
+{
+	fprintf(out, "//Generated by symtabgen, do not edit\n\n");
+	fprintf(out, "#include \"dlfcn_static.h\"\n\n");
+
+	if (!count)
+	{
+		fprintf(out, "const dl_static_symtab_t dl_static_symtab = { 0, 0, 0, 0 };\n");
+		return;
+	}
+
+	fprintf(out, "static const dl_static_sym_t syms[%u] = {\n", count);
+	for (uint32_t i = 0; i < count; ++i)
+		fprintf(out, "\t{ \"%s\", 0x%08X },\n", entries[i].name, entries[i].address);
+	fprintf(out, "};\n\n");
+
+	fprintf(out, "static const int32_t disp[%u] = {", count);
+	for (uint32_t i = 0; i < count; ++i)
+		fprintf(out, "%s%d,", i % 16 ? " " : "\n\t", disp[i]);
+	fprintf(out, "\n};\n\n");
+
+	fprintf(out, "static const uint32_t order[%u] = {", count);
+	for (uint32_t i = 0; i < count; ++i)
+		fprintf(out, "%s%u,", i % 16 ? " " : "\n\t", order[i]);
+	fprintf(out, "\n};\n\n");
+
+	fprintf(out, "const dl_static_symtab_t dl_static_symtab = { %u, disp, order, syms };\n", count);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t count = 0;
+	entry_t *entries = NULL;
+
+	if (argc > 1 && !strcmp(argv[1], "--empty"))
+	{
+		write_table(stdout, NULL, 0, NULL, NULL);
+		return 0;
+	}
+
+	entries = read_symbols(stdin, &count);
+	if (!entries)
+	{
+		fprintf(stderr, "symtabgen: failed to read symbols\n");
+		return 1;
+	}
+
+	qsort(entries, count, sizeof(entry_t), compare_entries);
+
+	int32_t *disp = calloc(count ? count : 1, sizeof(int32_t));
+	uint32_t *order = calloc(count ? count : 1, sizeof(uint32_t));
+	if (!disp || !order || (count && !build_hash(entries, count, disp, order)))
+	{
+		fprintf(stderr, "symtabgen: failed to build perfect hash for %u symbols\n", count);
+		return 1;
+	}
+
+	write_table(stdout, entries, count, disp, order);
+	return 0;
+}